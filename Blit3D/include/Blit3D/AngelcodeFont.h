@@ -2,8 +2,29 @@
 
 /*
 	Angelcode bitmap font class.
-	TODO: text format loading? Support for distance fields. Support for packed & non-32bit fonts?
+	TODO: text format loading? Support for packed & non-32bit fonts?
 
+	version 2.5 - Validate() parses a font file and checks the tables built from it, without loading anything; fuzzed by Tools/FontFuzz
+	version 2.4 - CommandList::AddText() records bitmap text from any thread, reading the font's glyphs without changing it
+	version 2.3 - can be made from an EmbeddedFont (see EmbeddedAssets.h), compiled into the program, without reading a file
+	version 2.2 - the file is memory mapped and parsed in place: every block is checked against the file size before it
+		is read, values are read as little-endian whatever the machine, and the glyph tables are built as the glyphs
+		are read. Damaged files are rejected instead of read out of bounds. Fixed glyph pages not being stored.
+	version 2.1 - distance field fonts: made with AngelcodeFontMode::SDF or MSDF, the pages are read as distance fields
+		(from msdfgen/msdf-atlas-gen, Hiero and the like) and drawn with Blit3D::shaderSDF in the colour set in textColour,
+		so one atlas can be drawn at any size and angle through scale. WidthText() and LineHeight() include scale.
+
+	version 2.0 - multi-page fonts: the pages are loaded as layers of a texture array and drawn with Blit3D::shader2dArray,
+		each glyph's vertices carry its page, so a string still draws in one call. Vertices are now TLVertex.
+	version 1.9 - added Layout() and a BlitText() taking TextLayoutParams: word or character wrapping, left/center/right/justify
+		alignment and line spacing, memoized per string. WidthText() results are memoized too.
+	version 1.8 - strings are decoded as UTF-8, so glyphs past 127 can be reached
+	version 1.7 - strings drawn again are kept as meshes in a cache VBO and drawn without laying them out again;
+		a string that only changed at the end (a score, a timer) keeps the unchanged part of its mesh
+	version 1.6 - glyphs are looked up in a direct-indexed table for codes below 256 and a sorted table above that,
+		and kerning pairs live in one sorted array (each glyph knows its range), instead of an unordered_map per glyph
+	version 1.5 - BlitText() lays the string out on the CPU and draws it with one call, instead of one draw call
+		and one modelMatrix update per glyph
 	version 1.4 - fixed character yoffset calculations for Blit3D coordinate system
 	version 1.3 - fixed incorrect verts array index if glyph code is stored more than once in the font file
 	version 1.2 - added kerning support
@@ -14,17 +35,63 @@
 #include <string>
 #include <vector>
 #include <stdint.h>
+#include <list>
+#include <map>
+
+//how the font's pages are drawn; ahead of Blit3D.h, whose font factory takes one
+enum class AngelcodeFontMode
+{
+	BITMAP = 0, //the glyphs as they are in the texture, best drawn at their own size
+	SDF, //single channel signed distance field
+	MSDF //multi-channel signed distance field, which keeps corners sharp
+};
 
 #include "Blit3D/Blit3D.h"
-#include <unordered_map>
+#include "Blit3D/UTF8.h"
+#include "Blit3D/EmbeddedAssets.h"
 
 class Blit3D;
 
 namespace B3D
 {
-	class TVertex;
+	class TLVertex;
 }
 
+enum class TextWrap { NONE = 0, WORD, CHARACTER };
+enum class TextAlign { LEFT = 0, CENTER, RIGHT, JUSTIFY };
+
+//how AngelcodeFont::Layout() arranges a string
+class TextLayoutParams
+{
+public:
+	float maxWidth; //wrap lines longer than this, in pixels; 0 for no limit
+	TextWrap wrap;
+	TextAlign align; //lines are aligned inside maxWidth, or inside the widest line if there is no limit
+	float lineSpacing; //multiplies the font's line height
+
+	TextLayoutParams() : maxWidth(0), wrap(TextWrap::WORD), align(TextAlign::LEFT), lineSpacing(1.f)
+	{ }
+};
+
+class TextLine
+{
+public:
+	size_t start, end; //byte range of the line in the string, without the spaces or newline it was broken at
+	size_t firstQuad, quads; //its glyphs in TextLayout::verts, 4 vertices per quad
+	float x, y; //where the line starts, relative to the text's origin
+	float width;
+};
+
+//a string laid out by AngelcodeFont::Layout(), ready to draw in one pass
+class TextLayout
+{
+public:
+	std::vector<B3D::TLVertex> verts; //4 per glyph, positioned relative to the top left of the text
+	std::vector<TextLine> lines;
+	float width; //of the widest line
+	float height; //from the top of the first line to the bottom of the last
+};
+
 class AngelcodeCharDescriptor
 {
 public:
@@ -33,50 +100,137 @@ public:
 	float xOffset, yOffset;
 	float xAdvance;
 	int lookupVerts;
-	std::unordered_map<int32_t, float> kerningTable;
+	int kernStart, kernCount; //this glyph's pairs in the font's kerning arrays, where it is the second glyph
+	int page; //which texture page the glyph is on
 
 	AngelcodeCharDescriptor() : x(0), y(0), width(0), height(0), xOffset(0), yOffset(0),
-		xAdvance(0), lookupVerts(0)
+		xAdvance(0), lookupVerts(0), kernStart(0), kernCount(0), page(0)
 	{ }
 };
 
 class AngelcodeFont
 {
+	friend class CommandList; //lays text out into its own vertices
+
 private:
-	char endian;
 	float lineHeight;
 	float base;
 	float scaleW, scaleH;
-	std::unordered_map<int32_t, AngelcodeCharDescriptor> Chars;
+	std::vector<AngelcodeCharDescriptor> glyphs; //every glyph, in the order they were read; lookupVerts indexes this too
+	int32_t lowGlyphs[256]; //index into glyphs for ASCII/Latin-1 codes, -1 for none
+	std::vector<int32_t> highCodes; //codes 256 and up, sorted...
+	std::vector<int32_t> highGlyphs; //...and their index into glyphs
+	std::vector<uint64_t> kernKeys; //(second << 32 | first) for every kerning pair, sorted...
+	std::vector<float> kernAmounts; //...and how far to move the second glyph
 
-	//TODO: make verts local to the constructer instead of a member var?
-	B3D::TVertex *verts;  // memory for vertice data
-	GLuint vboId;	// ID of VBO
+	const AngelcodeCharDescriptor *FindGlyph(int32_t code) const;
+	float Kerning(int32_t first, const AngelcodeCharDescriptor *second) const;
+
+	B3D::TLVertex *verts;  // each glyph's quad, relative to the pen position; copied into the batch by BlitText()
+	std::vector<B3D::TLVertex> batch; //the laid out string, reused between calls
+	GLuint vboId;	// ID of VBO, streamed every BlitText()
 	GLuint vaoId;	//ID of the VAO 		
+	size_t vboQuads; //how many quads the VBO has room for
+
+	std::vector<int32_t> codes; //the string being laid out, decoded
+	std::vector<uint32_t> codeOffsets; //where each code point starts in the string
+
+	//where the layout is, so it can be picked up again partway through a string
+	struct LayoutCursor
+	{
+		float pen;
+		size_t quads; //quads laid out so far
+		int32_t prevLetter; //for kerning the next glyph, -1 for none
+	};
+
+	//retained meshes for strings that are drawn again and again
+	struct TextMesh
+	{
+		std::string text;
+		size_t offset; //first quad in the cache VBO
+		size_t capacity; //quads set aside for it, a little more than it needs so it can grow in place
+		size_t quads; //quads in use
+		std::vector<LayoutCursor> cursors; //before each byte of text (and after the last), so a changed ending can be laid out on its own
+		bool laidOut; //made from a TextLayout, looked up in layoutMeshLookup
+	};
+	std::list<TextMesh> meshes; //most recently drawn first
+	std::unordered_map<std::string, std::list<TextMesh>::iterator> meshLookup;
+	std::unordered_map<std::string, std::list<TextMesh>::iterator> layoutMeshLookup; //by LayoutKey()
+	std::map<size_t, size_t> meshRanges; //offset -> capacity of every range in use in the cache VBO
+	std::unordered_map<uint64_t, std::string> lastDrawnAt; //the string last drawn at each position, to spot one that changed
+	GLuint cacheVboId, cacheVaoId;
+	size_t cacheQuads; //room in the cache VBO, 0 until it is made
+	size_t cacheBudget; //bytes
+
+	LayoutCursor LayoutText(const std::string &output, size_t start, LayoutCursor cursor, TextMesh *mesh);
+	std::list<TextMesh>::iterator CachedMesh(const std::string &output, float x, float y);
+	std::list<TextMesh>::iterator CachedLayoutMesh(const std::string &key, const TextLayout &layout);
+	std::list<TextMesh>::iterator StoreMesh(TextMesh &mesh, const std::vector<B3D::TLVertex> &quads);
+	bool AllocateMesh(size_t quads, size_t &offset);
+	void EvictMesh(std::list<TextMesh>::iterator mesh);
+	void MakeVAO(GLuint &vao, GLuint &vbo, size_t bytes, GLenum usage);
+	void StreamQuads(const std::vector<B3D::TLVertex> &quads);
+	void DrawQuads(GLint first, GLsizei count);
+
+	//memoized measurements, thrown away whole when they grow too big
+	std::unordered_map<std::string, TextLayout> layouts; //by LayoutKey()
+	std::unordered_map<std::string, float> widths;
+
+	std::string LayoutKey(const std::string &output, const TextLayoutParams &params);
+	void BuildLayout(const std::string &output, const TextLayoutParams &params, TextLayout &layout);
+	const TextLayout &Layout(const std::string &output, const TextLayoutParams &params, const std::string &key);
 
 	GLuint texId; //ID of texture
 	std::string textureName; //filename of the texture
+	TextureHandle texHandle; //handle to our texture in the texture manager, single page fonts only
+	int pages; //how many texture pages the font has
+	std::vector<std::string> pageNames;
+	GLuint arrayTexId; //all the pages as layers of a texture array, multi-page fonts only
+	Blit3D *b3d; //for the texture array shaders and the matrices they need, may be NULL for single page bitmap fonts
+	AngelcodeFontMode fontMode;
+	bool arrayPages; //the pages are in arrayTexId: multi-page and distance field fonts
+
+	bool LoadPages(void); //texture array fonts only
 	TextureManager *texManager; //pointer to the global texture manager
 	glm::mat4 modelMatrix; // Store the model matrix 
 	int modelMatrixLocation; // Store the location of our model matrix in the shader
 	int alphaLocation; //store the location of the alpha variable in the shader
 	GLSLProgram *prog; //our shader for 2d rendering
-	
-	int16_t ReadShort(int offset, char buffer[]);
-	int32_t ReadInt(int offset, char buffer[]);
-	int16_t ReadShortAndAdvance(int &offset, char buffer[]);
-	int32_t ReadIntAndAdvance(int &offset, char buffer[]);
-	uint32_t AngelcodeFont::ReadUIntAndAdvance(int &offset, char buffer[]);
+	GLWorkQueue *glWork; //batches our GL deletes, may be NULL
+
+	void Setup(TextureManager *TexManager, GLSLProgram *shader, GLWorkQueue *workQueue, Blit3D *blit3D, AngelcodeFontMode mode);
+	void Finish(const std::string &fontfile);
+	bool Parse(const uint8_t *data, size_t size); //reads the font file's blocks into the tables, false if it is malformed
+	bool LoadTables(const B3D::EmbeddedFont &font);
+	void AddGlyph(int32_t code, AngelcodeCharDescriptor &AD, std::vector<std::pair<int32_t, int32_t> > &high);
+	void BuildTables(std::vector<std::pair<int32_t, int32_t> > &high, std::vector<std::pair<uint64_t, float> > &kernPairs);
+	bool CheckTables(void) const;
+
+	AngelcodeFont(void); //tables only, for Validate(): no textures, shader or vertices
 
 public:
 	GLfloat dest_x; //window coordinates of the center of the sprite, in pixels
 	GLfloat dest_y;
 	GLfloat angle; //angle of the sprite, in degrees
 	GLfloat alpha;
+	GLfloat scale; //1 draws the font at the size it was made at; layouts are in unscaled pixels
+	glm::vec3 textColour; //distance field fonts only, bitmap fonts keep the colours of their texture
+	bool cacheText; //keep meshes of drawn strings to redraw them cheaply, on by default
 
+	void SetTextCacheBudget(size_t bytes); //GPU memory for cached meshes, 256KB by default; empties the cache
 	void BlitText(float x, float y, std::string output); //draws the string
-	float WidthText(std::string output);//returns the width of the text string, in pixels
+	void BlitText(float x, float y, const std::string &output, const TextLayoutParams &params); //draws the string laid out, x,y is its top left
+	float WidthText(std::string output);//returns the width of the text string, in pixels, including scale
+	//lays the string out, or returns the layout from last time; stays valid until the next call to Layout() or BlitText()
+	const TextLayout &Layout(const std::string &output, const TextLayoutParams &params);
+	float LineHeight(void) { return lineHeight * scale; }
 	~AngelcodeFont();
-	AngelcodeFont(std::string fontfile, TextureManager *TexManager, GLSLProgram *shader);
+	AngelcodeFont(std::string fontfile, TextureManager *TexManager, GLSLProgram *shader, GLWorkQueue *workQueue = NULL, Blit3D *blit3D = NULL,
+		AngelcodeFontMode mode = AngelcodeFontMode::BITMAP);
+	AngelcodeFont(const B3D::EmbeddedFont &font, TextureManager *TexManager, GLSLProgram *shader, GLWorkQueue *workQueue = NULL, Blit3D *blit3D = NULL,
+		AngelcodeFontMode mode = AngelcodeFontMode::BITMAP);
+
+	//true if the data is a binary Angelcode font that parses into sound tables; needs no GL context
+	static bool Validate(const uint8_t *data, size_t size);
 
 };
\ No newline at end of file
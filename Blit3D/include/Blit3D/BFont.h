@@ -1,4 +1,13 @@
 #pragma once
+
+/*
+	Original Blit3D bitmap font: a 16x16 grid of glyphs in one texture, with a file of glyph widths.
+	Depreciated in favour of AngelcodeFont, but kept for older titles.
+
+	BlitText() lays the string out on the CPU and streams it into the font's VBO, so a string is one draw call.
+*/
+
+#include <vector>
 #include "Blit3D/Blit3D.h"
 
 class Blit3D;
@@ -11,12 +20,15 @@ namespace B3D
 
 class BFont
 {
-	B3D::TVertex *verts;  // memory for vertice data
-	GLuint vboId;	// ID of VBO
+	B3D::TVertex *verts;  // each glyph's quad, relative to the pen position; copied into the batch by BlitText()
+	std::vector<B3D::TVertex> batch; //the laid out string, reused between calls
+	GLuint vboId;	// ID of VBO, streamed every BlitText()
 	GLuint vaoId;	//ID of the VAO 		
+	size_t vboQuads; //how many quads the VBO has room for
 
 	GLuint texId; //ID of texture
 	std::string textureName; //filename of the texture
+	TextureHandle texHandle; //handle to our texture in the texture manager
 	TextureManager *texManager; //pointer to the global texture manager
 	glm::mat4 modelMatrix; // Store the model matrix 
 	int modelMatrixLocation; // Store the location of our model matrix in the shader
@@ -24,13 +36,14 @@ class BFont
 	float fontSize;
 	int widths[256];
 	GLSLProgram *prog; //our shader for 2d rendering
+	GLWorkQueue *glWork; //batches our GL deletes, may be NULL
 
 public:
 	GLfloat dest_x; //window coordinates of the center of the sprite, in pixels
 	GLfloat dest_y;
 	GLfloat angle; //angle of the sprite, in degrees
 	GLfloat alpha;//-Frderic Duguay
-	BFont(std::string TextureFileName, std::string widths_file, float fontsize, TextureManager *TexManager, GLSLProgram *shader);
+	BFont(std::string TextureFileName, std::string widths_file, float fontsize, TextureManager *TexManager, GLSLProgram *shader, GLWorkQueue *workQueue = NULL);
 
 	void BlitText(bool whichFont, float x, float y, std::string output); //draws the string
 	float WidthText(bool whichFont, std::string output);//returns the width of the text string, in pixels
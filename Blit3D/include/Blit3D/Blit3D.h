@@ -1,5 +1,37 @@
 /* Blit3D cross-platform game graphics library, written by Darren Reid
 
+version 1.09 - QueueInput(): input events are timestamped and passed to the update thread through a lock-free ring
+	(InputQueue.h), and the input callbacks run there at the start of each tick, in order. WatchJoystick() queues
+	joystick snapshots too, and SetDoInputEvent() takes each event whole, with its time.
+version 1.08 - Blit3DThreadModel::RENDERTHREAD: drawing moves to a render thread that owns the GL context, and the main
+	thread sleeps in glfwWaitEvents(), handling input the moment it arrives rather than once per frame.
+version 1.07 - 2D draws can be recorded from any thread into CommandLists (CommandList.h), submitted with
+	SubmitCommandList() and drawn together on the GL thread, in the same order every frame, through the built-in
+	shaders shaderBatch and shaderBatchArray.
+version 1.06 - Blit3D owns a JobSystem (jobs), a work-stealing pool of worker threads for game code and the library:
+	TextureManager::LoadTextureHandles() decodes its images on it in parallel. SetWorkerCount() sizes it.
+version 1.05 - Draw() may take the interpolation between the last two update ticks (SetDraw(void(*)(double))), and
+	sprites draw from a SpriteTransform blended by it (Sprite::BlitInterpolated()), so a slow fixed update rate
+	still moves smoothly at a high frame rate.
+version 1.04 - SetUpdateRate(): Update() can run at a fixed rate, handed the same tick length every call. The update
+	thread sleeps between ticks instead of spinning, catches up on missed ticks to a limit, and counts overruns
+	(GetTickStats()).
+version 1.03 - added B3D::TripleBuffer (TripleBuffer.h), for handing state from Update() to Draw() without locks when
+	MULTITHREADED.
+version 1.02 - AddEmbeddedAssets() and MakeAngelcodeFont(EmbeddedFont): fonts, shaders and images compiled into the
+	program by B3DEmbed load without touching the disk.
+version 1.01 - AngelcodeFonts can be drawn from distance field atlases (AngelcodeFontMode::SDF/MSDF) with the built-in
+	shader shaderSDF, so one atlas serves every size.
+version 1.0 - AngelcodeFonts can have more than one texture page, drawn through shader2dArray.
+version 0.99 - added DynamicTexture (MakeDynamicTexture()), for textures updated while the game runs. Their changes
+	are uploaded once per frame, after the buffers are swapped.
+version 0.98 - added TiledImage (MakeTiledImage()), for background images too big to load as one texture,
+	and the built-in texture array shader shader2dArray.
+version 0.97 - DeleteSprite() no longer deletes right away: sprites, fonts (DeleteFont()) and RenderBuffers (DeleteRenderBuffer())
+	may be released from any thread, and are destroyed on the GL thread at the end of the frame, with their GL objects
+	deleted in one batch.
+version 0.96 - TextureManager and ShaderManager are thread-safe, and MakeSprite() may be called from the Update thread:
+	GL work requested off the GL thread is queued on glWork and run by the GL thread once per frame.
 version 0.95 - now on Github. Added Blit3DWindowModel::DECORATEDWINDOW_1080P for single-screen debugging; provides a floating window
 	that uses graphics scaled from 1080p. Added windowName string to constructor.
 version 0.9 - added #define GLEW_STATIC for new build methodology, sprite angles are now in radians (because GLM update required it),
@@ -34,6 +66,7 @@ version 0.11
 #ifdef _WIN32
 	#define WIN32_EXTRA_LEAN
 	#include <Windows.h>
+	#include <mmsystem.h> //timeBeginPeriod()
 #endif
 
 #define GLEW_STATIC
@@ -64,12 +97,20 @@ version 0.11
 #include <atomic>
 #include <mutex>
 
+#include "Blit3D/GLWorkQueue.h"
+#include "Blit3D/JobSystem.h"
 #include "Blit3D/TextureManager.h"
 #include "Blit3D/ShaderManager.h"
 #include "Blit3D/RenderBuffer.h"
 #include "Blit3D/Sprite.h"
 #include "Blit3D/BFont.h"
 #include "Blit3D/AngelcodeFont.h"
+#include "Blit3D/TiledImage.h"
+#include "Blit3D/DynamicTexture.h"
+#include "Blit3D/TripleBuffer.h"
+#include "Blit3D/TickScheduler.h"
+#include "Blit3D/InputQueue.h"
+#include "Blit3D/CommandList.h"
 
 //this macro helps calculate offsets for VBO stuff
 //Pass i as the number of bytes for the offset, so be sure to use sizeof() 
@@ -87,6 +128,15 @@ namespace B3D
 		GLfloat u, v; //texture coordinates
 	};
 
+	//vertex info for objects textured from a texture array
+	class TLVertex
+	{
+	public:
+		GLfloat x, y, z;//position
+		GLfloat u, v; //texture coordinates
+		GLfloat layer; //which layer of the array to sample
+	};
+
 	class JoystickState
 	{
 	public:
@@ -97,7 +147,10 @@ namespace B3D
 	};	
 }
 
-enum class Blit3DThreadModel { SINGLETHREADED = 1, SIMPLEMULTITHREADED, MULTITHREADED };
+//RENDERTHREAD: Update() runs on its own thread as in MULTITHREADED, and Init(), Draw() and DeInit() on a render
+//thread that owns the GL context. The main thread only waits on and dispatches input (DoInput() etc. and DoJoystick()),
+//so a swap blocked on vsync or a slow frame never holds input up.
+enum class Blit3DThreadModel { SINGLETHREADED = 1, SIMPLEMULTITHREADED, MULTITHREADED, RENDERTHREAD };
 
 enum class Blit3DWindowModel { DECORATEDWINDOW = 1, FULLSCREEN, BORDERLESSFULLSCREEN, BORDERLESSFULLSCREEN_1080P, DECORATEDWINDOW_1080P };
 
@@ -110,12 +163,18 @@ class Sprite;
 class BFont;
 class RenderBuffer;
 class AngelcodeFont;
+class TiledImage;
+class DynamicTexture;
+class CommandList;
+class CommandListRenderer;
 
 class Blit3D
 {
 public:
 	ShaderManager *sManager;
 	TextureManager *tManager;
+	GLWorkQueue *glWork; //GL work queued from other threads, flushed on the GL thread every frame
+	JobSystem *jobs; //worker threads for spreading work across cores, see JobSystem.h; made in Run()
 
 	GLFWwindow* window;
 
@@ -129,12 +188,16 @@ public:
 
 	float nearplane, farplane;
 	GLSLProgram *shader2d;
+	GLSLProgram *shader2dArray; //built-in 2D shader that samples a texture array, for batches of tiles/glyphs
+	GLSLProgram *shaderSDF; //built-in texture array shader for distance field glyphs
+	GLSLProgram *shaderBatch, *shaderBatchArray; //built-in shaders for CommandLists: coloured vertices, 2D texture or array
 
 	//function pointers
 private:
 	void (*Init)(void);
 	void (*Update)(double);
 	void (*Draw)(void);
+	void (*DrawInterpolated)(double);
 	void (*DeInit)(void);
 	void (*DoInput)(int , int, int, int);
 	void (*Sync)(void);
@@ -146,6 +209,17 @@ private:
 	std::mutex spriteMutex;
 	std::unordered_set<Sprite *> spriteSet;
 	std::string windowName;
+	B3D::TickScheduler updateTicks;
+	int workerCount; //for the JobSystem, 0 for one per spare core
+	CommandListRenderer *commandLists;
+	Blit3DThreadModel threadModel;
+	B3D::InputQueue *inputQueue; //made by QueueInput()
+
+	void DrawFrame(void); //calls whichever Draw() was set
+	bool StartGL(void);
+	void RunLoop(Blit3DThreadModel threadType);
+	void RenderThread(void);
+	int PumpEvents(void); //the main thread's loop under RENDERTHREAD
 
 public:	
 
@@ -161,12 +235,34 @@ public:
 
 	Sprite *MakeSprite(GLfloat startX, GLfloat startY, GLfloat width, GLfloat height, std::string TextureFileName);
 	Sprite *MakeSprite(RenderBuffer *rb);
+	//these may be called from any thread: the objects are destroyed on the GL thread at the end of the frame
 	void DeleteSprite(Sprite *sprite);
 	
 	RenderBuffer *MakeRenderBuffer(int width, int height, std::string name);
 	
 	BFont *MakeBFont(std::string TextureFileName, std::string widths_file, float fontsize);
-	AngelcodeFont *MakeAngelcodeFontFromBinary32(std::string filename);
+	AngelcodeFont *MakeAngelcodeFontFromBinary32(std::string filename, AngelcodeFontMode fontMode = AngelcodeFontMode::BITMAP);
+	AngelcodeFont *MakeAngelcodeFont(const B3D::EmbeddedFont &font, AngelcodeFontMode fontMode = AngelcodeFontMode::BITMAP);
+	void DeleteFont(AngelcodeFont *font);
+	void DeleteFont(BFont *font);
+	void DeleteRenderBuffer(RenderBuffer *rb);
+
+	//registers embedded images and shaders with the managers, so loads of those names use them...see EmbeddedAssets.h.
+	//Call it from Init(), before loading anything it holds.
+	void AddEmbeddedAssets(const B3D::EmbeddedAssets &assets);
+
+	//very large images, streamed in as tiles...see TiledImage.h
+	TiledImage *MakeTiledImage(std::string filename, int tileSize = 512, int poolLayers = 0);
+	void DeleteTiledImage(TiledImage *image);
+
+	//textures whose pixels change while running, see DynamicTexture.h
+	DynamicTexture *MakeDynamicTexture(int width, int height, std::string name, bool pixelate = true);
+	void DeleteDynamicTexture(DynamicTexture *texture);
+
+	//queues a recorded CommandList to be drawn, from any thread...see CommandList.h
+	void SubmitCommandList(CommandList *list);
+	//draws the lists submitted so far, GL thread only. Lists still waiting when Draw() returns are drawn then, on top.
+	void DrawCommandLists(void);
 	
 	void Reshape(GLSLProgram *shader);
 	void ReshapFBO(int FBOwidth, int FBOheight, GLSLProgram *shader);
@@ -178,14 +274,35 @@ public:
 	void SetInit(void(*func)(void));
 	void SetUpdate(void(*func)(double));
 	void SetDraw(void(*func)(void));
+	//a Draw() that is handed how far (0 to 1) the present is between the last two fixed rate update ticks, see SetUpdateRate().
+	//Draw what Update() moved that far from its previous tick's place to its latest.
+	//When Update() runs on another thread, blend what it hands over by its own tick instead, see B3D::DrawInterpolation().
+	void SetDraw(void(*func)(double));
 	void SetDeInit(void(*func)(void));
 	void SetDoInput(void(*func)(int, int, int, int));
 	void SetSync(void(*func)(void));
+
+	//how many worker threads the JobSystem gets, 0 (the default) for one per core less one. Call before Run().
+	void SetWorkerCount(int workers);
+
+	//run Update() at hz ticks per second, each call handed 1/hz seconds, instead of as often as possible.
+	//Up to maxCatchUpTicks missed ticks are run back to back; beyond that they are dropped and counted. Call before Run().
+	void SetUpdateRate(double hz, int maxCatchUpTicks = 5);
+	B3D::TickStats GetTickStats(void);
 	void SetDoCursor(void(*func)(double, double));
 	void SetDoMouseButton(void(*func)(int, int, int));
 	void SetDoScrollwheel(void(*func)(double, double)); 
 	void SetDoJoystick(void(*func)(void));
 
+	//from now on input callbacks run on the update thread at the start of each tick, for the events before that tick,
+	//in the order they came, instead of on the main thread as they arrive...see InputQueue.h. Call before Run().
+	void QueueInput(size_t capacity = 1024);
+	//with QueueInput(), every event goes here, with the time it came, in place of DoInput() and the rest
+	void SetDoInputEvent(void(*func)(const B3D::InputEvent &));
+	//with QueueInput(), snapshots of the joystick are queued whenever it changes; from any thread
+	void WatchJoystick(int joystickNumber, bool watch = true);
+	uint64_t DroppedInputEvents(void); //events lost to a full queue
+
 	//joystick polling, fills out the state struct if it returns true, returns false if the joystick isn't plugged in.
 	bool PollJoystick(int joystickNumber, B3D::JoystickState &joystickState);
 	//poll joystick to see if it is still plugged in
@@ -0,0 +1,117 @@
+/*
+	CommandList: 2D draws recorded on any thread, and drawn later on the GL thread.
+
+	GL calls can only be made on one thread, but working out what to draw can be spread over many:
+	each thread (or job) records sprites, text and rectangles into a CommandList of its own. Recording
+	computes the final vertices on the CPU, into the list's own vertex arena, and never changes the
+	Sprite or font it reads, so any number of lists may record from the same Sprite at once.
+
+	Submit the lists with Blit3D::SubmitCommandList(). They are drawn by Blit3D::DrawCommandLists(), or
+	after Draw() returns if that wasn't called, in order of their order value, then the order they were
+	made in, so the result is the same however the threads were scheduled. Draws in a row that use the
+	same texture are drawn together, across lists too. A list is emptied once it has been drawn, ready
+	to record the next frame, and must not be recorded into between being submitted and being drawn.
+
+		std::vector<CommandList *> lists; //one per range of enemies, made once
+		...
+		blit3D->jobs->ParallelFor(lists.size(), [&](size_t begin, size_t end)
+		{
+			for(size_t i = begin; i < end; ++i) RecordEnemies(lists[i], i);
+		}, 1);
+		for(size_t i = 0; i < lists.size(); ++i) blit3D->SubmitCommandList(lists[i]);
+
+	Bitmap fonts only; distance field fonts are drawn with BlitText().
+
+	Version 1.0
+*/
+
+#pragma once
+
+#include "Blit3D/Blit3D.h"
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <stdint.h>
+
+class Blit3D;
+class Sprite;
+class SpriteTransform;
+class AngelcodeFont;
+
+namespace B3D
+{
+	//vertex with its own colour, which the texel is multiplied by
+	class CVertex
+	{
+	public:
+		GLfloat x, y, z; //position
+		GLfloat u, v, layer; //texture coordinates, and the layer for texture arrays
+		GLfloat r, g, b, a;
+	};
+}
+
+class CommandList
+{
+	friend class CommandListRenderer;
+
+private:
+	//quads in a row drawn with the same texture
+	struct DrawRun
+	{
+		TextureHandle handle; //the texture, or null for the texture in texId
+		GLuint texId; //0 with a null handle for plain colour
+		GLuint sampler; //0 for the texture's own
+		bool array; //texId is a texture array
+		uint32_t firstQuad, quads;
+	};
+
+	std::vector<B3D::CVertex> verts; //4 per quad, kept between frames so recording rarely allocates
+	std::vector<DrawRun> runs;
+	std::vector<int32_t> codes; //text being recorded, decoded
+	uint64_t sequence; //when the list was made, for ordering lists with the same order value
+
+	B3D::CVertex *AddQuad(const TextureHandle &handle, GLuint texId, GLuint sampler, bool array);
+
+public:
+	int order; //lists with lower values are drawn first
+
+	CommandList(int drawOrder = 0);
+
+	//the sprite's image, centered at x,y, angle in radians
+	void AddSprite(const Sprite &sprite, float x, float y, float angle = 0.f, float scaleX = 1.f, float scaleY = 1.f, float alpha = 1.f);
+	//the sprite where t puts it, blend of the way from its previous transform to its current one, like Sprite::BlitInterpolated()
+	void AddSprite(const Sprite &sprite, const SpriteTransform &t, float blend, float alpha = 1.f);
+	//one line of text, starting at x,y like AngelcodeFont::BlitText(), drawn at the font's scale and angle
+	void AddText(const AngelcodeFont &font, float x, float y, const std::string &text, float alpha = 1.f);
+	//solid rectangle, from its bottom left corner
+	void AddRect(float x, float y, float width, float height, const glm::vec4 &colour);
+	void AddLine(float x1, float y1, float x2, float y2, float thickness, const glm::vec4 &colour);
+
+	size_t QuadCount(void) const { return verts.size() / 4; }
+	uint64_t Sequence(void) const { return sequence; }
+	void Reset(void); //forgets everything recorded, keeping the memory
+};
+
+//draws submitted CommandLists, owned by Blit3D; GL thread only, apart from Submit()
+class CommandListRenderer
+{
+private:
+	Blit3D *b3d;
+	std::mutex submitMutex;
+	std::vector<CommandList *> submitted; //guarded by submitMutex
+	std::vector<CommandList *> drawing;
+
+	GLuint vaoId, vboId, iboId;
+	size_t vboQuads, iboQuads; //room in the buffers
+	GLuint whiteTexId; //1x1 white texture for untextured quads
+
+	bool BindRun(const CommandList::DrawRun &run); //false if the texture isn't ready yet
+
+public:
+	CommandListRenderer(Blit3D *blit3D);
+	~CommandListRenderer();
+
+	void Submit(CommandList *list); //any thread
+	void Draw(void); //draws and resets every list submitted so far
+};
@@ -0,0 +1,71 @@
+/*
+	DynamicTexture: a texture whose contents change while the game runs (minimaps, fog of war masks,
+	procedurally generated tiles...), without deleting and re-creating it.
+
+	Update() copies new pixels into a CPU-side copy of the texture and marks that rectangle dirty; it
+	may be called from any thread. Once per frame, after the buffers are swapped, the TextureManager
+	uploads the dirty rectangles: they are packed into one of two pixel buffer objects, used in turn,
+	and copied into the texture with glTexSubImage2D from the PBO, so the copy runs asynchronously and
+	the GL thread never waits for last frame's upload.
+
+	The texture is registered with the TextureManager under its name, so Sprites can be made from it
+	with MakeSprite(0, 0, width, height, name). Pixels are RGBA, rows bottom-up (y = 0 is the bottom row).
+	Create it with Blit3D::MakeDynamicTexture() and release it with Blit3D::DeleteDynamicTexture().
+
+	Version 1.0
+*/
+
+#pragma once
+#include "Blit3D/Blit3D.h"
+
+#include <vector>
+#include <mutex>
+
+class DynamicTexture
+{
+private:
+	//a dirty rectangle, in pixels
+	struct DirtyRect
+	{
+		int x, y, width, height;
+	};
+
+	TextureManager *texManager;
+	GLWorkQueue *glWork;
+
+	int width, height;
+	std::string name;
+	bool pixelate;
+	TextureHandle texHandle; //our texture, as registered with the TextureManager
+
+	std::mutex pixelMutex; //guards pixels and dirty
+	std::vector<uint8_t> pixels; //CPU copy of the whole texture
+	std::vector<DirtyRect> dirty; //waiting to be uploaded
+
+	//GL thread only
+	GLuint texId;
+	GLuint pbo[2]; //alternate between these, so we never write into one the GPU may still be reading
+	int nextPbo;
+
+	void MakeGLObjects(void); //GL thread only
+	void AddDirtyRect(int x, int y, int w, int h); //expects pixelMutex to be held
+
+public:
+	//copy w x h RGBA pixels to x,y. sourceStride is the source's bytes per row, 0 for tightly packed.
+	//Any thread; the change shows up after the next frame's upload.
+	void Update(int x, int y, int w, int h, const uint8_t *source, int sourceStride = 0);
+	void Update(const uint8_t *source); //the whole texture
+	void Fill(int x, int y, int w, int h, uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+
+	//uploads the dirty rectangles, called once per frame by the TextureManager on the GL thread
+	void Upload(void);
+
+	int Width(void) { return width; }
+	int Height(void) { return height; }
+	const std::string &Name(void) { return name; }
+	TextureHandle Handle(void) { return texHandle; }
+
+	//we won't call this constructor directly, we'll let the Blit3D object do that
+	DynamicTexture(int w, int h, std::string textureName, bool pixelated, TextureManager *TexManager, GLWorkQueue *workQueue);
+	~DynamicTexture();
+};
@@ -0,0 +1,85 @@
+/*
+	Assets compiled into the executable, so they can be used at startup without file I/O or parsing.
+
+	The tables are written by the B3DEmbed tool (Tools/B3DEmbed), usually as a pre-build step:
+
+		B3DEmbed -o EmbeddedAssets_gen.h -n GameAssets Computer50_bin.fnt shader.vert shader.frag logo.png
+
+	Angelcode fonts become glyph and kerning tables (their page images are embedded too), shaders become
+	string literals, and QOI or 8-bit RGBA PNG images are decoded into RGBA pixels, rows bottom-up, ready
+	for glTexImage2D. Everything is plain static const data, initialized by the compiler.
+
+	Include the generated header in one .cpp file, then hand the bundle to Blit3D in Init(), before loading anything:
+
+		blit3D->AddEmbeddedAssets(GameAssets::assets); //images and shaders are then found by name, instead of read from disk
+		font = blit3D->MakeAngelcodeFont(GameAssets::Computer50_bin_fnt);
+
+	Version 1.0
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace B3D
+{
+	//an image, already decoded
+	class EmbeddedImage
+	{
+	public:
+		const char *name; //the filename it was made from, and is loaded by
+		uint32_t width, height;
+		const uint8_t *pixels; //RGBA, rows bottom-up
+	};
+
+	class EmbeddedShader
+	{
+	public:
+		const char *name;
+		const char *source;
+	};
+
+	//one glyph of an Angelcode font, as the font file has it
+	class EmbeddedGlyph
+	{
+	public:
+		int32_t code;
+		uint16_t x, y, width, height;
+		int16_t xOffset, yOffset, xAdvance;
+		uint8_t page;
+	};
+
+	class EmbeddedKerning
+	{
+	public:
+		uint32_t first, second;
+		int16_t amount;
+	};
+
+	class EmbeddedFont
+	{
+	public:
+		const char *name;
+		uint16_t lineHeight, base;
+		uint16_t scaleW, scaleH; //size of the pages
+		uint16_t pages;
+		const char *const *pageNames; //pages of them, loaded through the TextureManager like any other image
+		const EmbeddedGlyph *glyphs;
+		size_t glyphCount;
+		const EmbeddedKerning *kerning;
+		size_t kerningCount;
+	};
+
+	//everything one generated header holds, for registering it in one go
+	class EmbeddedAssets
+	{
+	public:
+		const EmbeddedImage *const *images;
+		size_t imageCount;
+		const EmbeddedShader *const *shaders;
+		size_t shaderCount;
+		const EmbeddedFont *const *fonts;
+		size_t fontCount;
+	};
+}
@@ -0,0 +1,65 @@
+/*
+	GLWorkQueue: OpenGL calls are only legal on the thread that owns the GL context.
+	Work submitted from any other thread is queued here and run on the GL thread
+	when Blit3D flushes the queue, once per frame after the buffers are swapped.
+
+	Version 1.1 - added deferred destruction of objects and batched deletion of GL objects:
+		objects released from any thread are destroyed on the GL thread when the queue is flushed,
+		and the GL names they free are deleted with one glDelete* call per type.
+	Version 1.0
+*/
+
+#pragma once
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include <vector>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+class GLWorkQueue
+{
+private:
+	std::mutex queueMutex;
+	std::vector<std::function<void(void)>> pending; //work waiting for the GL thread
+	std::vector<std::function<void(void)>> executing; //swapped with pending when flushing, so Submit() never waits on GL work
+	std::vector<std::function<void(void)>> pendingDestruction; //objects to destroy after the pending work has run
+	std::vector<std::function<void(void)>> executingDestruction;
+	std::thread::id glThread; //the thread that owns the GL context
+
+	//GL names waiting to be deleted in one batch per type
+	std::vector<GLuint> deadTextures;
+	std::vector<GLuint> deadBuffers;
+	std::vector<GLuint> deadVertexArrays;
+	std::vector<GLuint> deadFramebuffers;
+	std::vector<GLuint> deadRenderbuffers;
+
+	void QueueDelete(std::vector<GLuint> &list, GLuint id);
+
+public:
+	GLWorkQueue(); //the constructing thread is taken to be the GL thread
+
+	//call from the thread that owns the GL context, if it changes
+	void SetGLThread(void);
+	bool OnGLThread(void);
+
+	//runs work right away when called on the GL thread, otherwise queues it for the next Flush()
+	void Submit(std::function<void(void)> work);
+
+	//always queued, even on the GL thread: runs at the next Flush(), after the pending work,
+	//so an object created and released before a flush is created before it is destroyed
+	void DeferDestruction(std::function<void(void)> destroy);
+
+	//queue GL names for deletion, from any thread
+	void DeleteTexture(GLuint id);
+	void DeleteBuffer(GLuint id);
+	void DeleteVertexArray(GLuint id);
+	void DeleteFramebuffer(GLuint id);
+	void DeleteRenderbuffer(GLuint id);
+
+	//runs all queued work in submission order, then the deferred destruction, 
+	//then deletes the dead GL names...GL thread only!
+	void Flush(void);
+};
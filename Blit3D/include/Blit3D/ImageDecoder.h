@@ -0,0 +1,39 @@
+/*
+	Fast-path image decoders, used by the TextureManager before falling back on FreeImage.
+	Supports QOI files and non-interlaced 8-bit RGBA PNG files (the format our tools export),
+	decoding straight into a caller-provided RGBA buffer. Rows are written bottom-up, to match
+	OpenGL's texture origin (and FreeImage's row order).
+
+	PNG scanlines are unfiltered with SSE2 when it is available.
+
+	Version 1.1 - PNG scanlines are unfiltered as they are inflated, from a window of the last 32KB or so, and split
+		IDAT chunks are inflated where they are: neither the filtered image nor the joined chunks are held in memory
+	Version 1.0
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace B3D
+{
+	enum class ImageFormat { UNKNOWN = 0, QOI, PNG };
+
+	class ImageInfo
+	{
+	public:
+		ImageFormat format;
+		uint32_t width, height;
+
+		ImageInfo() : format(ImageFormat::UNKNOWN), width(0), height(0) {}
+	};
+
+	//Reads the header of an in-memory image file. Returns false if it isn't a format
+	//(or a variant of one) that we decode natively.
+	bool ProbeImage(const uint8_t *data, size_t size, ImageInfo &info);
+
+	//Decodes an image that ProbeImage() accepted into out, which must hold
+	//info.width * info.height * 4 bytes. Returns false on corrupt data.
+	bool DecodeImage(const uint8_t *data, size_t size, const ImageInfo &info, uint8_t *out);
+}
@@ -0,0 +1,125 @@
+/*
+	Input events, timestamped as GLFW reports them on the main thread and handed to the update thread
+	through a lock-free ring, so input callbacks never race Update().
+
+	Once Blit3D::QueueInput() is called, the key, cursor, mouse button and scroll callbacks stop being
+	called on the main thread as events arrive. Instead each event is stamped with glfwGetTime() and
+	pushed onto the ring, and at the start of every tick the update thread calls the callbacks for
+	the events that came in before that tick was due, in the order they happened. Joysticks handed
+	to Blit3D::WatchJoystick() are snapshotted once a frame, and a snapshot is queued whenever one changes.
+
+	SetDoInputEvent() takes every event whole, timestamp included, in place of the separate callbacks;
+	joystick snapshots only go there.
+
+		blit3D->QueueInput();
+		blit3D->WatchJoystick(1);
+		blit3D->SetDoInputEvent(DoInputEvent);
+
+		void DoInputEvent(const B3D::InputEvent &event) //on the update thread
+		{
+			if(event.type == B3D::InputEventType::KEY && event.key == GLFW_KEY_SPACE && event.action == GLFW_PRESS)
+				Jump(event.time);
+		}
+
+	The ring never allocates after it is made. When it is full, new events are dropped and counted
+	rather than waited on.
+
+	Version 1.0
+*/
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+namespace B3D
+{
+	//fixed size ring that one thread pushes onto and one other thread pops from, without locks
+	template <class T>
+	class SPSCQueue
+	{
+	private:
+		std::vector<T> slots;
+		size_t mask; //slots.size() - 1, the size being a power of two
+
+		//the indices only ever grow, and are wrapped by mask; each on its own cache line, as each is written by one thread
+		char padStart[64];
+		std::atomic<size_t> head; //next slot to pop, written by the consumer
+		char padHead[64];
+		std::atomic<size_t> tail; //next slot to push, written by the producer
+		char padTail[64];
+		std::atomic<uint64_t> dropped; //pushes refused because the ring was full
+
+		//the ring belongs to two threads, so it can't be copied
+		SPSCQueue(const SPSCQueue &);
+		SPSCQueue &operator=(const SPSCQueue &);
+
+	public:
+		//capacity is rounded up to a power of two
+		explicit SPSCQueue(size_t capacity) : head(0), tail(0), dropped(0)
+		{
+			size_t size = 2;
+			while(size < capacity) size *= 2;
+			slots.resize(size);
+			mask = size - 1;
+		}
+
+		size_t Capacity(void) const { return slots.size(); }
+		uint64_t Dropped(void) const { return dropped; }
+
+		//producer only: false, and the item dropped, if the ring is full
+		bool Push(const T &item)
+		{
+			size_t back = tail.load(std::memory_order_relaxed);
+			if(back - head.load(std::memory_order_acquire) == slots.size())
+			{
+				dropped++;
+				return false;
+			}
+
+			slots[back & mask] = item;
+			tail.store(back + 1, std::memory_order_release);
+			return true;
+		}
+
+		//consumer only: the oldest item, or NULL if the ring is empty; it stays valid until Pop()
+		const T *Peek(void)
+		{
+			size_t front = head.load(std::memory_order_relaxed);
+			if(front == tail.load(std::memory_order_acquire)) return NULL;
+			return &slots[front & mask];
+		}
+
+		//consumer only: gives the oldest item's slot back to the producer; only after Peek() found one
+		void Pop(void)
+		{
+			head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		}
+	};
+
+	enum class InputEventType { KEY = 0, CURSOR, MOUSEBUTTON, SCROLL, JOYSTICK };
+
+	class InputEvent
+	{
+	public:
+		enum { MAX_AXES = 8, MAX_BUTTONS = 32 }; //joystick state past these isn't kept
+
+		InputEventType type;
+		double time; //glfwGetTime() when the main thread got it
+		int key, scancode; //KEY
+		int button; //MOUSEBUTTON
+		int action, mods; //KEY and MOUSEBUTTON
+		double x, y; //CURSOR position, or SCROLL offsets
+
+		//JOYSTICK: a snapshot of the whole joystick, counted from 1 like Blit3D::PollJoystick()
+		int joystick;
+		bool present; //false once it is unplugged
+		int axisCount, buttonCount;
+		float axes[MAX_AXES];
+		unsigned char buttons[MAX_BUTTONS];
+	};
+
+	typedef SPSCQueue<InputEvent> InputQueue;
+}
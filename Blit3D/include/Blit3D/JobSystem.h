@@ -0,0 +1,138 @@
+/*
+	JobSystem: a pool of worker threads that run small jobs, for spreading work over every core.
+
+	Each worker has its own deque of jobs: it takes the newest job off the back of its own, and when that
+	runs dry it steals the oldest from the front of another worker's. Jobs submitted from a worker go on
+	its own deque, jobs from other threads are dealt out across the workers.
+
+	A job can depend on other jobs, and only runs once they have all finished, so a frame's work can be
+	built as a graph up front. Wait() and ParallelFor() run jobs themselves while they wait, so they are
+	safe to call from inside a job.
+
+		JobHandle load = jobs->Create([&]() { LoadLevel(); });
+		JobHandle spawn = jobs->Create([&]() { SpawnEnemies(); });
+		jobs->DependsOn(spawn, load);
+		jobs->Submit(load);
+		jobs->Submit(spawn);
+		...
+		jobs->Wait(spawn);
+
+		jobs->ParallelFor(enemies.size(), [&](size_t begin, size_t end)
+		{
+			for(size_t i = begin; i < end; ++i) enemies[i].Think(seconds);
+		});
+
+	Jobs must not make GL calls, queue those on the GLWorkQueue instead.
+
+	Version 1.0
+*/
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <stdint.h>
+
+class JobSystem;
+
+class Job
+{
+	friend class JobSystem;
+
+private:
+	std::function<void(void)> work;
+	std::atomic<int> waitingOn; //unfinished dependencies, plus one until it is submitted
+	std::atomic<bool> finished;
+	std::mutex dependentsMutex;
+	std::vector<std::shared_ptr<Job> > dependents; //jobs waiting on this one, released when it finishes
+
+public:
+	Job(std::function<void(void)> jobWork) : work(jobWork), waitingOn(1), finished(false)
+	{ }
+
+	bool IsDone(void) const { return finished; }
+};
+
+typedef std::shared_ptr<Job> JobHandle;
+
+//how busy one worker has been since the JobSystem was made or its stats were reset
+class JobWorkerStats
+{
+public:
+	uint64_t jobsRun;
+	uint64_t jobsStolen; //of jobsRun, how many were taken from another worker's deque
+	double busySeconds; //spent running jobs
+	double utilization; //busySeconds over the time elapsed, 0 to 1
+};
+
+class JobSystem
+{
+private:
+	class Worker
+	{
+	public:
+		std::mutex dequeMutex;
+		std::deque<JobHandle> jobs; //the owner works from the back, thieves from the front
+		std::thread thread;
+		std::thread::id id;
+
+		std::atomic<uint64_t> jobsRun, jobsStolen, busyMicroseconds;
+
+		Worker() : jobsRun(0), jobsStolen(0), busyMicroseconds(0)
+		{ }
+	};
+
+	std::vector<Worker *> workers;
+	std::atomic<int> queued; //jobs sitting in the deques
+	std::atomic<unsigned> nextWorker; //where the next job from outside the pool goes
+	std::atomic<bool> quit;
+	std::mutex sleepMutex;
+	std::condition_variable sleepCondition; //idle workers wait here for jobs
+	double statsStart; //glfwGetTime() when the stats were last reset
+
+	void WorkerLoop(int index);
+	int WorkerIndex(void); //of the calling thread, -1 if it isn't one of ours
+	void Push(const JobHandle &job);
+	bool Take(int index, JobHandle &job, bool &stolen); //our own newest job, or another worker's oldest
+	void Execute(const JobHandle &job);
+	void Release(const JobHandle &job); //one dependency fewer, queues it when there are none left
+
+	//one pool per Blit3D
+	JobSystem(const JobSystem &);
+	JobSystem &operator=(const JobSystem &);
+
+public:
+	//workerCount of 0 starts one worker per core, less the one the main thread runs on
+	JobSystem(int workerCount = 0);
+	~JobSystem(); //finishes the jobs already queued, then stops the workers
+
+	int WorkerCount(void) const { return (int)workers.size(); }
+
+	//a job that does nothing until it is submitted
+	JobHandle Create(std::function<void(void)> work);
+	//job won't run until before has finished; both must be created, and job not yet submitted
+	void DependsOn(const JobHandle &job, const JobHandle &before);
+	//the job runs as soon as its dependencies have finished
+	void Submit(const JobHandle &job);
+
+	//create and submit in one go
+	JobHandle Run(std::function<void(void)> work);
+	JobHandle Run(std::function<void(void)> work, const std::vector<JobHandle> &dependencies);
+
+	//runs other jobs until job has finished
+	void Wait(const JobHandle &job);
+	void Wait(const std::vector<JobHandle> &jobs);
+
+	//calls body(begin, end) over ranges covering 0 to count, in parallel, and returns when all are done.
+	//grain is the most indices per call, 0 picks a size that gives each worker a few ranges.
+	void ParallelFor(size_t count, std::function<void(size_t, size_t)> body, size_t grain = 0);
+
+	void GetStats(std::vector<JobWorkerStats> &stats); //one per worker
+	void ResetStats(void);
+};
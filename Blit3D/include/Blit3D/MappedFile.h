@@ -0,0 +1,41 @@
+/*
+	Read-only memory mapping of a whole file, for loaders that want to parse a file in place
+	rather than copy it into a buffer first. The mapping lasts until Close() or the destructor.
+
+	Version 1.0
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+namespace B3D
+{
+	class MappedFile
+	{
+	private:
+		const uint8_t *data;
+		size_t size;
+#ifdef _WIN32
+		void *fileHandle, *mappingHandle;
+#endif
+
+		//one mapping, one owner
+		MappedFile(const MappedFile &);
+		MappedFile &operator=(const MappedFile &);
+
+	public:
+		MappedFile();
+		~MappedFile();
+
+		//maps the file, replacing any file mapped before; returns false (and logs why) if it can't.
+		//An empty file opens with Data() NULL.
+		bool Open(const std::string &filename);
+		void Close(void);
+
+		const uint8_t *Data(void) const { return data; }
+		size_t Size(void) const { return size; }
+	};
+}
@@ -0,0 +1,22 @@
+/*
+	Fast content hashing for decoded images, so the TextureManager can spot identical textures.
+
+	Two xxHash32 streams (different seeds) run over the data in the same pass and are combined into
+	a 64 bit result, to keep accidental collisions out of reach for any realistic number of textures.
+	Uses SSE4.1 for the four xxHash lanes when the CPU has it, checked at runtime.
+
+	Version 1.0
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace B3D
+{
+	uint64_t HashPixels(const void *data, size_t size);
+
+	//plain xxHash32, exposed mostly so the SIMD path can be checked against it
+	uint32_t XXHash32(const void *data, size_t size, uint32_t seed);
+}
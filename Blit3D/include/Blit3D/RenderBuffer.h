@@ -11,6 +11,7 @@ public:
 	GLuint depth_rb;//depth buffer
 	TextureManager *texManager;
 	std::string texname;
+	TextureHandle texHandle; //handle to color_tex in the texture manager
 	int texwidth;
 	int texheight;
 	Blit3D *b3d;
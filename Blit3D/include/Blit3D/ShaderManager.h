@@ -3,31 +3,52 @@
 	TODO:	make ShaderManager store individual compiled shaders and look them up when linking,
 			so that progs can re-use vert or frag shaders without recompiling?
 
+	Version 1.3 - AddEmbeddedShader(): shader sources compiled into the program (see EmbeddedAssets.h) are used
+		in place of the files of the same name.
+	Version 1.2 - thread-safe: the shader map is guarded by a mutex. Shaders requested off the GL thread
+		are compiled and linked on the GL thread via the GLWorkQueue; check isLinked() before using them.
 	Version 1.1
 */
 
 #pragma once
 
 #include "Blit3D/glslprogram.h"
+#include "Blit3D/GLWorkQueue.h"
+#include "Blit3D/EmbeddedAssets.h"
+#include <mutex>
+#include <unordered_map>
 
 class ShaderManager
 {
 private:
 	std::map<std::string, GLSLProgram*> ShaderMap;
+	std::mutex shaderMutex; //guards ShaderMap
+	GLWorkQueue *glWork; //where compiles requested off the GL thread go
+	std::unordered_map<std::string, const char *> embeddedShaders; //sources by name
+	std::mutex embeddedMutex; //guards embeddedShaders, apart from shaderMutex as compiles run with that held
 
-	GLSLProgram* Load(const char* vertName, const char*fragName);
-	GLSLProgram*LoadFromStrings(const char* vertName, const char*fragName, std::string vertString, std::string fragString);
+	//compile and link into an existing program, GL thread only
+	bool Load(GLSLProgram* prog, const char* vertName, const char*fragName);
+	bool CompileStage(GLSLProgram* prog, const char* name, GLSLShader::GLSLShaderType type); //from the embedded source if there is one
+	bool LoadFromStrings(GLSLProgram* prog, const char* vertName, const char*fragName, const std::string &vertString, const std::string &fragString);
 
-	std::map<std::string, GLSLProgram*>::iterator shaderIter;
+	bool OnGLThread(void);
 
 public:
+	ShaderManager(GLWorkQueue *workQueue = NULL); //with no work queue, all calls must come from the GL thread
+
 	//Try to retrive a shader: if none exists for this combination or vert and frag shaders, load and 
 	//compile and link it, then store on map
 	GLSLProgram* GetShader(const char* vertName, const char* fragName);
 	GLSLProgram* GetShader(const char* vertName, const char* fragName, std::string vertString, std::string fragString);
-	//binds a shader for use
+	GLSLProgram* GetShader(const B3D::EmbeddedShader &vert, const B3D::EmbeddedShader &frag);
+	//binds a shader for use...the binding only happens on the GL thread
 	GLSLProgram* UseShader(const char* vertName, const char* fragName);
 	GLSLProgram* UseShader(const char* vertName, const char* fragName, std::string vertString, std::string fragString);
 
+	//from now on GetShader() compiles this source whenever it is asked for a file called shader.name.
+	//The shader must outlive the ShaderManager, as generated tables do.
+	void AddEmbeddedShader(const B3D::EmbeddedShader &shader);
+
 	~ShaderManager();
 };
@@ -1,5 +1,6 @@
 #pragma once
 #include "Blit3D/Blit3D.h"
+#include "Blit3D/TickScheduler.h"
 
 class Blit3D;
 class RenderBuffer;
@@ -10,21 +11,64 @@ namespace B3D
 	class JoystickState;
 }
 
+//where a sprite is drawn at the latest update tick and at the one before, so Draw() can blend between them.
+//Call NewTick() at the start of each tick, then move it by changing x, y, angle and the scales.
+//It carries the time of the tick that moved it, so a copy handed to Draw() blends by its own tick (Sprite::BlitTransform()).
+class SpriteTransform
+{
+public:
+	float x, y; //center, in window coordinates
+	float angle; //radians
+	float scaleX, scaleY;
+	float prevX, prevY, prevAngle, prevScaleX, prevScaleY; //as they were at the previous tick
+	double tickTime; //when the tick that set the current transform was due, see B3D::UpdateTickTime()
+
+	SpriteTransform() : x(0), y(0), angle(0), scaleX(1.f), scaleY(1.f),
+		prevX(0), prevY(0), prevAngle(0), prevScaleX(1.f), prevScaleY(1.f), tickTime(0)
+	{ }
+
+	//the current transform becomes the previous one, and the tick being run the one that moves it
+	void NewTick(void)
+	{
+		prevX = x;
+		prevY = y;
+		prevAngle = angle;
+		prevScaleX = scaleX;
+		prevScaleY = scaleY;
+		tickTime = B3D::UpdateTickTime();
+	}
+
+	//moves straight to x,y, without sliding there from the old place
+	void Teleport(float newX, float newY)
+	{
+		x = newX;
+		y = newY;
+		NewTick();
+	}
+};
+
 class Sprite
 {
+	friend class CommandList; //records the quad without drawing it
+
 private:
 	B3D::TVertex *verts;  // memory for vertice data
 	GLuint vboId;	// ID of VBO
 	GLuint vaoId;	//ID of the VAO 		
+	GLfloat halfSizeX, halfSizeY; //the quad, kept on the CPU for CommandLists
+	GLfloat u1, u2, v1, v2;
 
-	GLuint texId; //ID of texture
-	std::string textureName; //filename of the texture
+	TextureHandle texHandle; //handle to our texture in the texture manager
 	TextureManager *texManager; //pointer to the global texture manager
 	glm::mat4 modelMatrix; // Store the model matrix 
 	int modelMatrixLocation; // Store the location of our model matrix in the shader
 	int alphaLocation; //store the location of the alpha variable in the shader
 
 	GLSLProgram *prog; //shader program for 2D
+	GLWorkQueue *glWork; //for creating our VBO on the GL thread
+
+	//creates the VAO/VBO for our quad, GL thread only
+	void MakeQuad(GLfloat halfSizeX, GLfloat halfSizeY, GLfloat u1, GLfloat u2, GLfloat v1, GLfloat v2);
 
 public:
 	GLfloat dest_x; //window coordinates of the center of the sprite, in pixels
@@ -32,15 +76,25 @@ public:
 	GLfloat angle; //angle of the sprite, in degrees
 	GLfloat alpha; //amount of extra alpha-blending to apply, modifies opacity of the sprite
 	GLfloat scale_x, scale_y; //scaling value, 1 = 100%, 0.5 = half size, etc.
+	GLuint sampler; //0 draws with the sampler the texture was loaded with, or set one from TextureManager::GetSampler()
 	void Blit(void); //draw the sprite
 	void Blit(float x, float y); //draw the sprite centered at x,y
 	void Blit(float alpha_val); //draw the sprite with set alpha
 	void Blit(float x, float y, float scale_val_x, float scale_val_y); //draw the sprite centered at x,y with set scale
 	void Blit(float x, float y, float scale_val_x, float scale_val_y, float alpha_val); //draw the sprite centered at x,y with set scale and alpha
 
+	SpriteTransform transform; //for sprites that are one object in the game, drawn with BlitTransform()
+	//draw the sprite blend (0 to 1) of the way from t's previous transform to its current one;
+	//angles turn the short way round
+	void BlitInterpolated(const SpriteTransform &t, float blend, float alpha_val = 1.f);
+	void BlitInterpolated(float blend, float alpha_val = 1.f);
+	//the same, blended by how far this frame is past t's own tick, B3D::DrawInterpolation(t.tickTime)
+	void BlitTransform(const SpriteTransform &t, float alpha_val = 1.f);
+	void BlitTransform(float alpha_val = 1.f);
+
 	//we won't call this constructor directly, we'll let the Blit3D object do that
 	Sprite(GLfloat startX, GLfloat startY, GLfloat width, GLfloat height,
-		std::string TextureFileName, TextureManager *TexManager, GLSLProgram *shader);
-	Sprite(RenderBuffer * rb, TextureManager *TexManager, GLSLProgram *shader);
+		std::string TextureFileName, TextureManager *TexManager, GLSLProgram *shader, GLWorkQueue *workQueue = NULL);
+	Sprite(RenderBuffer * rb, TextureManager *TexManager, GLSLProgram *shader, GLWorkQueue *workQueue = NULL);
 	~Sprite();
 };
@@ -6,6 +6,28 @@ texture binding state management.
 
 Uses the excellent Free Image library as it's image loader.
 
+Version 3.2, binding by handle on the GL thread no longer takes the mutex: the GL thread keeps its own copy of
+	each record's generation, texture object and sampler, and only takes the mutex to catch up when one changed.
+Version 3.1, LoadTextureHandles(): loads a batch of textures, decoding them in parallel on the JobSystem.
+Version 3.0, AddEmbeddedImage(): images compiled into the program (see EmbeddedAssets.h) are loaded by name
+	like files, straight from their pixels, with no file read or decode.
+Version 2.9, DynamicTextures register here, and UploadDynamicTextures() sends their changes to the GPU once per frame.
+	Added SetTextureId() for textures whose texture object is made after they are registered.
+Version 2.8, optional deduplication (set deduplicate = true): decoded images are hashed, and textures with
+	identical content share one GL texture object, which is deleted when the last texture using it is freed.
+	The VRAM this saved is logged when the TextureManager is destroyed. AddLoadedTexture() warns about name collisions.
+Version 2.7, filtering, wrapping and anisotropy live in sampler objects, cached by GetSampler() and bound
+	per texture unit, instead of being set on every texture. Each texture remembers the sampler it was loaded
+	with, and can be bound with a different one, so the same texture can be drawn pixelated and smooth.
+	The maximum anisotropy is queried once, when the TextureManager is made.
+Version 2.6, QOI and 8-bit RGBA PNG files are decoded by our own fast path (ImageDecoder.h),
+	everything else still goes through FreeImage. Files are read into memory once for both.
+	Logs decode time and MB/s for every load.
+Version 2.5, thread-safe: the texture tables are guarded by a mutex and may be used from any thread.
+	Images are decoded on the calling thread, GL work off the GL thread is queued on the GLWorkQueue
+	and completes asynchronously (the handle binds texture 0 until the upload has run)
+Version 2.4, added TextureHandle: loads return a generational index into a dense array of
+	texture records, so binding/freeing/fetching by handle never hashes a string
 Version 2.3, uses GLEW on all platforms for now
 Version 2.2, changed from std::map to std::unordered_map for better speed
 Version 2.1, added pixelate argument to LoadTexture() for pixel graphics
@@ -34,8 +56,17 @@ Version 1.4, added AddLoadedTexture() to let FBO add textures to the TM
 
 #include <FreeImage.h>
 #include <unordered_map>
+#include <vector>
 #include <algorithm>
+#include <stdint.h>
+#include <mutex>
+#include <atomic>
 #include "Blit3D/glslprogram.h"
+#include "Blit3D/GLWorkQueue.h"
+#include "Blit3D/ImageDecoder.h"
+#include "Blit3D/PixelHash.h"
+#include "Blit3D/EmbeddedAssets.h"
+#include "Blit3D/JobSystem.h"
 
 
 struct tex
@@ -45,6 +76,60 @@ public:
 	GLuint refcount; //reference counter...how many objects are using this texture
 	bool unload; //do we unload this texture and free it's id when the refcount is 0?
 	int width, height;
+	GLuint sampler; //sampler object it was loaded with, 0 uses the texture's own parameters (FBO textures etc.)
+	uint64_t contentKey; //key into the shared content table when deduplicated, 0 if this record owns texId
+	uint32_t generation; //bumped every time this record is freed, so old handles to it go stale
+	std::string name; //the name this texture was loaded/registered under
+};
+
+class DynamicTexture;
+
+//a GL texture shared by every deduplicated texture record with the same content
+struct sharedTex
+{
+	GLuint texId; //0 until the first load's upload has run
+	GLuint users; //how many texture records share it
+	uint64_t bytes; //VRAM used, counted as saved for every extra user
+};
+
+//the GL thread's copy of what binding a texture record needs, see TextureManager::LookupBinding()
+struct texBinding
+{
+	uint32_t generation;
+	GLuint texId;
+	GLuint sampler;
+
+	texBinding() : generation(0), texId(0), sampler(0) {}
+};
+
+//A TextureHandle is returned when loading a texture, and is the fast way to refer to it afterwards.
+//index is the slot in the TextureManager's dense texture array, generation must match the slot's 
+//generation for the handle to be valid (i.e. the texture hasn't been freed and the slot reused).
+struct TextureHandle
+{
+	uint32_t index;
+	uint32_t generation;
+
+	TextureHandle() : index(0xFFFFFFFF), generation(0) {}
+	TextureHandle(uint32_t i, uint32_t g) : index(i), generation(g) {}
+
+	bool IsNull() const { return index == 0xFFFFFFFF; }
+	bool operator==(const TextureHandle &other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const TextureHandle &other) const { return !(*this == other); }
+};
+
+//A decoded image waiting to be uploaded. Either FreeImage owns the pixels (dib is set, pixels are BGRA),
+//our own decoder wrote them into pixels (RGBA), or they are an embedded image's (RGBA, embedded is set).
+//Rows are bottom-up in every case.
+struct DecodedImage
+{
+	FIBITMAP *dib;
+	uint8_t *pixels;
+	int width, height;
+	bool bgra;
+	bool embedded; //pixels belong to an EmbeddedImage, and are never freed
+
+	DecodedImage() : dib(NULL), pixels(NULL), width(0), height(0), bgra(false), embedded(false) {}
 };
 
 //the maximum texture units OpenGL supports
@@ -54,25 +139,91 @@ public:
 class TextureManager
 {
 private:
-	std::unordered_map<std::string, tex *> textures; //list of textures and associated id's, in a hashmap
-	GLuint currentId[TEXTURE_MANAGER_MAX_TEXTURES]; //currently bound texture
-	std::unordered_map<std::string, tex *>::iterator itor; //might as well save an iterator to use on our map
+	std::vector<tex> texArray; //dense array of texture records, indexed by TextureHandle::index
+	std::vector<uint32_t> freeSlots; //indices of unused records in texArray, reused before growing it
+	std::unordered_map<std::string, uint32_t> textures; //texture name -> index in texArray, in a hashmap
+	std::mutex texMutex; //guards texArray, freeSlots, textures and texturePath
+	GLuint currentId[TEXTURE_MANAGER_MAX_TEXTURES]; //currently bound texture, only touched on the GL thread
+	GLuint currentSampler[TEXTURE_MANAGER_MAX_TEXTURES]; //currently bound sampler, only touched on the GL thread
+	std::unordered_map<uint32_t, GLuint> samplers; //sampler objects by their packed settings (see GetSampler()), GL thread only
+	GLfloat maxAnisotropy; //device limit, 1 if anisotropic filtering isn't supported
+	GLWorkQueue *glWork; //where GL work requested off the GL thread goes
+	JobSystem *jobs; //decodes batches of images in parallel, may be NULL
+	std::unordered_map<uint64_t, sharedTex> contents; //deduplicated textures by content key, guarded by texMutex
+	uint64_t dedupBytesSaved; //total VRAM not allocated thanks to deduplication
+	uint32_t dedupHits; //how many loads were served from an identical texture
+	std::vector<DynamicTexture *> dynamicTextures; //uploaded every frame, guarded by texMutex
+	std::unordered_map<std::string, const B3D::EmbeddedImage *> embeddedImages; //by name, guarded by texMutex
+	std::vector<texBinding> glBindings; //GL thread only, indexed like texArray, so binding a handle needs no lock
+	std::vector<uint32_t> changedBindings; //records whose generation, texId or sampler changed since glBindings caught up, guarded by texMutex
+	std::atomic<bool> bindingsChanged; //set along with changedBindings, so the GL thread only takes texMutex when there is something to copy
+
+	const B3D::EmbeddedImage *FindEmbeddedImage(const std::string &filename); //takes texMutex
+
+	//these expect texMutex to be held
+	tex *Lookup(TextureHandle handle); //returns NULL if the handle is stale or invalid
+	TextureHandle AllocateSlot(const std::string &name); //grabs a free record and maps name to it
+	void ReleaseSlot(uint32_t index); //unmaps the record and invalidates all handles to it
+	TextureHandle AddReference(const std::string &filename); //bumps the refcount if loaded, else returns a null handle
+	void BindingChanged(uint32_t index); //call after changing a record's generation, texId or sampler
+
+	const texBinding *LookupBinding(TextureHandle handle); //GL thread, NULL if the handle is stale or invalid
+
+	GLuint ReleaseContent(uint64_t contentKey); //drops a user of shared content, returns the texture to delete when it was the last
+
+	bool OnGLThread(void);
+	uint64_t ContentKey(const DecodedImage &image, bool useMipMaps); //hash of the pixels and the settings that affect the GL texture
+	//registers a decoded image under filename and uploads it, or shares an identical or already loaded texture; releases image
+	TextureHandle FinishLoad(const std::string &filename, DecodedImage &image, uint64_t contentKey, bool useMipMaps, GLuint texture_unit, GLuint wrapflag, bool pixelate);
+	void UploadTexture(TextureHandle handle, DecodedImage image, bool useMipMaps, GLuint texture_unit, GLuint wrapflag, bool pixelate, uint64_t contentKey); //GL thread, releases image
+	void DeleteTextureObject(GLuint texId); //GL thread
+	void BindTextureAndSampler(GLuint bindId, GLuint sampler, GLuint texture_unit); //GL thread
 	
 public:
 	std::string texturePath; //relative path to the files
+	bool deduplicate; //hash decoded images and share one GL texture between identical ones, off by default
 
 	int texureLocation; // Store the location of our texture sampler in the shader
 
 	void InitShaderVar(GLSLProgram *the_shader, const char * samplerName, int shaderVar = 0); //initalizes the shader variable for the sampler
 
-	GLuint LoadTexture(std::string filename, bool useMipMaps = false, GLuint texture_unit = GL_TEXTURE0, GLuint wrapflag = GL_CLAMP_TO_EDGE, bool pixelate = true);
-	void FreeTexture(std::string filename); 
-	void BindTexture(GLuint bindId, GLuint texture_unit = GL_TEXTURE0);
-	void BindTexture(std::string filename, GLuint texture_unit = GL_TEXTURE0);
+	GLuint LoadTexture(const std::string &filename, bool useMipMaps = false, GLuint texture_unit = GL_TEXTURE0, GLuint wrapflag = GL_CLAMP_TO_EDGE, bool pixelate = true);
+	TextureHandle LoadTextureHandle(const std::string &filename, bool useMipMaps = false, GLuint texture_unit = GL_TEXTURE0, GLuint wrapflag = GL_CLAMP_TO_EDGE, bool pixelate = true);
+	//loads every file in filenames, like LoadTextureHandle() on each, with the decoding spread over the JobSystem's workers.
+	//handles[i] is filenames[i]'s texture, null if it failed to load
+	void LoadTextureHandles(const std::vector<std::string> &filenames, std::vector<TextureHandle> &handles,
+		bool useMipMaps = false, GLuint texture_unit = GL_TEXTURE0, GLuint wrapflag = GL_CLAMP_TO_EDGE, bool pixelate = true);
+	//decode without uploading, from any thread...filename includes the path
+	bool DecodeImage(const std::string &filename, DecodedImage &image); //fills in a 32 bit image
+	void ReleaseImage(DecodedImage &image); //frees the pixels of a decoded image
+	//from now on loading or decoding image.name (with or without texturePath) uses its pixels instead of reading the file.
+	//The image must outlive the TextureManager, as generated tables do.
+	void AddEmbeddedImage(const B3D::EmbeddedImage &image);
+	TextureHandle FindTexture(const std::string &name); //lookup without adding a reference
+	bool IsValid(TextureHandle handle);
+	GLuint GetTextureId(TextureHandle handle); //returns 0 if the handle is stale
+	void FreeTexture(const std::string &filename); 
+	void FreeTexture(TextureHandle handle);
+	void BindTexture(GLuint bindId, GLuint texture_unit = GL_TEXTURE0); //no sampler, the texture's own parameters apply
+	void BindTexture(TextureHandle handle, GLuint texture_unit = GL_TEXTURE0);
+	void BindTexture(TextureHandle handle, GLuint texture_unit, GLuint sampler); //overrides the sampler the texture was loaded with
+	void BindTexture(const std::string &filename, GLuint texture_unit = GL_TEXTURE0);
 	void SetTexturePath(std::string path);
-	void AddLoadedTexture(std::string name, GLuint bindId);//used by FBO add pre-created textures
-	bool FetchDimensions(std::string name, GLfloat &width, GLfloat &height);
-	TextureManager(void);
+
+	//sampler objects are made once per combination of settings and shared, GL thread only.
+	//A mipmapped sampler is safe to use on a texture without mipmaps, only its top level gets sampled.
+	GLuint GetSampler(bool useMipMaps, bool pixelate, GLuint wrapflag = GL_CLAMP_TO_EDGE, bool anisotropic = true);
+	void BindSampler(GLuint sampler, GLuint texture_unit = GL_TEXTURE0); //for textures the TextureManager doesn't bind itself
+	TextureHandle AddLoadedTexture(const std::string &name, GLuint bindId, int width = 0, int height = 0);//used by FBO add pre-created textures
+	bool SetTextureId(TextureHandle handle, GLuint bindId); //fills in the texture object later, returns false if the handle went stale
+
+	//DynamicTextures add and remove themselves
+	void AddDynamicTexture(DynamicTexture *texture);
+	void RemoveDynamicTexture(DynamicTexture *texture);
+	void UploadDynamicTextures(void); //GL thread, once per frame
+	bool FetchDimensions(const std::string &name, GLfloat &width, GLfloat &height);
+	bool FetchDimensions(TextureHandle handle, GLfloat &width, GLfloat &height);
+	TextureManager(GLWorkQueue *workQueue = NULL, JobSystem *jobSystem = NULL); //with no work queue, all calls must come from the GL thread
 	~TextureManager(void);
 };
 
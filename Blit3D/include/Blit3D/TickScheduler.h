@@ -0,0 +1,88 @@
+/*
+	Fixed rate scheduling for Update(): ticks come at a steady rate (60, 120, 240Hz...) and Update() is always
+	handed the same tick length, so games no longer need an accumulator of their own.
+
+	The update thread sleeps until just before the next tick is due and spins out the rest,
+	so it is on time without burning a core. When it falls behind, it runs the ticks it missed
+	back to back, up to maxCatchUp of them. Past that, the extra ticks are dropped and counted
+	as an overrun, rather than falling further behind.
+
+	Version 1.3 - UpdateTickTime() and DrawInterpolation(): state handed to another thread carries the time of the tick
+		that made it, and is blended by that, so a Draw() that overlaps an Update() never pairs new state with an old tick
+	Version 1.2 - TickTime(): when the tick about to run was due, for handing it the input that came before it
+	Version 1.1 - Interpolation(): how far the present is past the last tick run, for drawing between ticks
+	Version 1.0
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+namespace B3D
+{
+	//in Update(): when the tick being run was due. Stamp state handed to Draw() with it.
+	double UpdateTickTime(void);
+	//in Draw(): how far (0 to 1) the frame being drawn is past the tick due at tickTime; always 1 when not scheduling
+	double DrawInterpolation(double tickTime);
+
+	//how the ticks have gone so far, readable from any thread
+	class TickStats
+	{
+	public:
+		uint64_t ticks; //Update() calls made
+		uint64_t overruns; //times the update fell further behind than it may catch up
+		uint64_t droppedTicks; //ticks skipped by those overruns
+	};
+
+	class TickScheduler
+	{
+	private:
+		double tickSeconds; //0 when not scheduling
+		int maxCatchUp;
+		double nextTick; //when the next tick is due, in glfwGetTime() seconds
+		double spinSeconds; //how long before a deadline sleeping stops and spinning starts
+		double runTick; //when the next tick the caller runs was due, update thread only
+		std::atomic<double> lastTick; //when the last tick run was due, read by the render thread
+
+		std::atomic<uint64_t> ticks, overruns, droppedTicks;
+
+	public:
+		TickScheduler();
+
+		//hz of 0 stops scheduling: Update() is then called as often as possible with the time since the last call.
+		//Set it before Blit3D::Run().
+		void SetRate(double hz, int maxCatchUpTicks = 5);
+		bool Fixed(void) const { return tickSeconds > 0; }
+		double TickSeconds(void) const { return tickSeconds; }
+
+		//the first tick is due at now
+		void Start(double now);
+
+		//how many ticks are due by now, without waiting; the caller runs that many, each TickSeconds() long
+		int DueTicks(double now);
+
+		//sleeps, then spins, until the next tick is due, and returns how many ticks are due
+		int WaitForTicks(void);
+
+		//when the tick about to run was due, between DueTicks() or WaitForTicks() and TickRan()
+		double TickTime(void) const { return runTick; }
+
+		//call after each tick's Update() has finished
+		void TickRan(void);
+
+		//0 at the moment the last tick run was due, rising to 1 a tick later; always 1 when not scheduling.
+		//Drawing between the previous and the latest tick's state by this much moves things smoothly at any frame rate.
+		//Only exact while Update() and Draw() take turns: a Draw() running between an Update() handing over its
+		//state and TickRan() gets the new state with the old tick's time. Blend that state by DrawInterpolation().
+		double Interpolation(double now) const;
+
+		//call at the start of each frame, before Draw(), so every DrawInterpolation() in the frame uses the same time
+		void BeginFrame(double now);
+
+		//sleeps and spins until glfwGetTime() reaches deadline
+		void WaitUntil(double deadline);
+
+		TickStats Stats(void) const;
+	};
+}
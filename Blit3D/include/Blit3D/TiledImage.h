@@ -0,0 +1,113 @@
+/*
+	TiledImage: a very large image (bigger than GL_MAX_TEXTURE_SIZE, or than we want in VRAM at once),
+	split into fixed-size tiles that are streamed in as they come into view.
+
+	The first time an image is used, it is decoded and written out as a tile cache file next to it
+	("<image>.tiles"), raw RGBA tiles at fixed offsets plus a small overview image. After that only the
+	cache is read. Each tile carries a 1 pixel border copied from its neighbours, so linear filtering
+	doesn't show seams.
+
+	Only the tiles that intersect the screen, plus a prefetch margin, are kept resident: they live in the
+	layers of a texture array, are read from the cache by a background thread, and uploaded a few per
+	frame. Tiles that aren't resident yet show the overview image instead. All resident tiles are drawn
+	as one batch of quads.
+
+	Use it like a Sprite: create it with Blit3D::MakeTiledImage(), Blit() it at a position (the image's
+	center, so subtract your camera position) and release it with Blit3D::DeleteTiledImage().
+	Assumes the 2D view matrix is the identity when working out which tiles are visible.
+
+	Version 1.0
+*/
+
+#pragma once
+#include "Blit3D/Blit3D.h"
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+class Blit3D;
+class Sprite;
+
+namespace B3D
+{
+	class TLVertex;
+}
+
+class TiledImage
+{
+private:
+	//one tile read back from the cache, waiting for the GL thread to upload it
+	struct LoadedTile
+	{
+		int tile;
+		std::vector<uint8_t> pixels;
+	};
+
+	//what the GL thread knows about each tile
+	enum TileState { TILE_NOT_RESIDENT = 0, TILE_LOADING, TILE_RESIDENT };
+
+	Blit3D *b3d;
+	GLWorkQueue *glWork;
+	TextureManager *texManager;
+
+	std::string cacheName; //the tile cache file
+	uint64_t tilesOffset; //where the tile data starts in the cache file
+	std::vector<uint8_t> overviewPixels; //read with the cache header, freed once uploaded
+	int overviewWidth, overviewHeight;
+	int tileSize; //size of a stored tile, in pixels, including the border
+	int interior; //image pixels covered by one tile: tileSize - 2
+	int columns, rows;
+	int imageWidth, imageHeight;
+
+	//GL thread only
+	std::vector<uint8_t> tileState; //a TileState per tile
+	std::vector<int> tileLayer; //texture array layer of each resident tile, -1 if not resident
+	std::vector<int> layerTile; //tile held by each layer, -1 if the layer is free
+	std::vector<uint64_t> layerLastUsed; //frame each layer was last drawn, for least recently used eviction
+	uint64_t frame;
+	GLuint arrayTexId; //the tile pool
+	GLuint vboId, vaoId; //the batch of quads, refilled every Blit()
+	B3D::TLVertex *verts; //CPU copy of the batch, room for every tile in the pool
+	int maxQuads;
+	TextureHandle overviewHandle; //low resolution copy of the whole image, shown where tiles are missing
+	Sprite *overview;
+
+	//shared with the streaming thread, guarded by streamMutex
+	std::mutex streamMutex;
+	std::condition_variable streamCondition;
+	std::deque<int> requests; //tiles to read, most wanted first...rebuilt every Blit()
+	std::vector<LoadedTile> ready; //tiles read and waiting to be uploaded
+	std::vector<std::vector<uint8_t>> spareBuffers; //uploaded tiles' buffers, for reuse
+	bool quitStreaming;
+	std::thread streamer;
+
+	bool BuildCache(const std::string &imageFile); //decodes the image and writes the tile cache
+	bool ReadCache(uint64_t sourceSize); //checks the cache file is current, reads its dimensions and the overview
+	void MakeGLObjects(int poolLayers); //GL thread only
+	void StreamTiles(void); //the streaming thread
+	void UploadReadyTiles(void);
+	void RequestTiles(int col1, int row1, int col2, int row2, std::deque<int> &wanted);
+
+public:
+	GLfloat dest_x; //window coordinates of the center of the image, in pixels
+	GLfloat dest_y;
+	GLfloat alpha; //amount of extra alpha-blending to apply
+	GLfloat scale_x, scale_y; //scaling value, 1 = 100%
+	int prefetchMargin; //how many tiles beyond the edges of the screen are streamed in ahead of time
+	int uploadsPerFrame; //most tiles uploaded in one Blit(), to spread the cost over frames
+
+	void Blit(void); //draw the visible part of the image
+	void Blit(float x, float y); //draw the image centered at x,y
+	void Blit(float x, float y, float scale_val_x, float scale_val_y); //draw the image centered at x,y with set scale
+
+	int Width(void) { return imageWidth; }
+	int Height(void) { return imageHeight; }
+
+	//we won't call this constructor directly, we'll let the Blit3D object do that.
+	//poolLayers is the number of tiles kept resident, 0 sizes the pool to cover the screen plus the prefetch margin.
+	TiledImage(std::string imageFile, int tileSize, int poolLayers, Blit3D *blit3d);
+	~TiledImage();
+};
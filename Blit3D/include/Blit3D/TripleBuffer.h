@@ -0,0 +1,110 @@
+/*
+	Lock-free handoff of state from one thread to another, such as from Update() to Draw() when running
+	Blit3DThreadModel::MULTITHREADED. Neither side ever waits on the other.
+
+	There are three copies of the state. The writer fills its back copy and publishes it with
+	one atomic swap, which hands the writer the spare copy in exchange. The reader picks up the
+	newest published copy, also with one swap, and keeps reading it until it picks up another.
+	The reader never sees a copy that is half written, and it skips snapshots published faster
+	than it reads them.
+
+	After Publish() the back copy holds an older snapshot, not the one just published, so write
+	the whole state every time. The simplest way is for Update() to keep its own state and hand
+	over a copy of it:
+
+		B3D::TripleBuffer<GameState> snapshots;
+
+		void Update(double seconds)
+		{
+			...advance state...
+			snapshots.Publish(state);
+		}
+
+		void Draw(void)
+		{
+			const GameState &now = snapshots.Latest();
+			...draw now...
+		}
+
+	Exactly one thread writes and exactly one thread reads.
+
+	Version 1.0
+*/
+
+#pragma once
+
+#include <atomic>
+
+namespace B3D
+{
+	template <class T>
+	class TripleBuffer
+	{
+	private:
+		enum { INDEX_MASK = 3, FRESH = 4 }; //the middle slot's index, and whether it has been published since the reader last took it
+
+		//each copy on its own cache lines, so the threads don't slow each other down through sharing them
+		class Slot
+		{
+		public:
+			T state;
+			char pad[64];
+		};
+
+		Slot slots[3];
+		std::atomic<unsigned> middle; //the copy between the writer and the reader
+		char padMiddle[64];
+		unsigned back; //the writer's copy
+		char padBack[64];
+		unsigned front; //the reader's copy
+
+		//the copies belong to two threads, so the buffer can't be copied
+		TripleBuffer(const TripleBuffer &);
+		TripleBuffer &operator=(const TripleBuffer &);
+
+	public:
+		TripleBuffer() : middle(1), back(0), front(2)
+		{ }
+
+		//all three copies start as initial, so the reader has something sensible before the first Publish()
+		explicit TripleBuffer(const T &initial) : middle(1), back(0), front(2)
+		{
+			for(int i = 0; i < 3; ++i) slots[i].state = initial;
+		}
+
+		//writer only: the copy to fill in before Publish()
+		T &Back(void) { return slots[back].state; }
+
+		//writer only: makes the back copy the newest snapshot, and takes the spare copy as the new back copy
+		void Publish(void)
+		{
+			back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+		}
+
+		//writer only: copies state into the back copy and publishes it
+		void Publish(const T &state)
+		{
+			slots[back].state = state;
+			Publish();
+		}
+
+		//reader only: takes the newest snapshot if one was published since last time; returns false if there wasn't
+		bool Acquire(void)
+		{
+			if(!(middle.load(std::memory_order_relaxed) & FRESH)) return false;
+
+			front = middle.exchange(front, std::memory_order_acq_rel) & INDEX_MASK;
+			return true;
+		}
+
+		//reader only: the snapshot taken by the last Acquire()
+		const T &Front(void) const { return slots[front].state; }
+
+		//reader only: takes the newest snapshot, if there is one, and returns the snapshot being read
+		const T &Latest(void)
+		{
+			Acquire();
+			return slots[front].state;
+		}
+	};
+}
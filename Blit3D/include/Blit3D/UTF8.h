@@ -0,0 +1,34 @@
+/*
+	UTF-8 decoding for the text classes.
+
+	Malformed input (stray continuation bytes, overlong forms, surrogates, truncated sequences) decodes
+	to U+FFFD one byte at a time, so decoding never gets out of step with the bytes of the string.
+	Runs of 16 ASCII bytes are checked and widened with SSE2 where available, so plain English text
+	costs little more than the old byte-at-a-time loops.
+
+	Version 1.0
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+namespace B3D
+{
+	const int32_t UTF8_REPLACEMENT = 0xFFFD;
+
+	//decodes the code point at p and moves p past it, p must be < end
+	int32_t NextUTF8(const char *&p, const char *end);
+
+	//decodes length bytes of text into codes (replacing what was there), returns how many code points there were.
+	//If offsets isn't NULL it gets the byte offset of each code point.
+	size_t DecodeUTF8(const char *text, size_t length, std::vector<int32_t> &codes, std::vector<uint32_t> *offsets = NULL);
+
+	inline size_t DecodeUTF8(const std::string &text, std::vector<int32_t> &codes, std::vector<uint32_t> *offsets = NULL)
+	{
+		return DecodeUTF8(text.data(), text.size(), codes, offsets);
+	}
+}
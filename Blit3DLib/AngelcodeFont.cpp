@@ -1,475 +1,1192 @@
 #include "Blit3D/AngelcodeFont.h"
+#include "Blit3D/MappedFile.h"
 #include <iostream>
-#include <fstream>
 #include <cassert>
-#include "Blit3D/ByteSwap.h"
+#include <string.h>
+#include <algorithm>
+
+//room for this many glyphs in the VBO to start with, it grows to fit longer strings
+#define ANGELCODE_INITIAL_QUADS 256
+//default size of the cached mesh VBO
+#define ANGELCODE_CACHE_BYTES (256 * 1024)
+//cached meshes are given room in steps of this many quads, so strings that grow a little can be updated in place
+#define ANGELCODE_MESH_GRANULARITY 8
+//forget where strings were drawn once this many positions are remembered
+#define ANGELCODE_MAX_POSITIONS 4096
+//forget memoized layouts and widths past this many of each
+#define ANGELCODE_MAX_LAYOUTS 256
+#define ANGELCODE_MAX_WIDTHS 1024
+//sizes in the binary file: block type and size, the fixed part of the common block, one glyph, one kerning pair
+#define ANGELCODE_BLOCK_HEADER_BYTES 5
+#define ANGELCODE_COMMON_BYTES 15
+#define ANGELCODE_CHAR_BYTES 20
+#define ANGELCODE_KERN_BYTES 10
+
+namespace
+{
+	//Angelcode binary fonts are little-endian; putting the bytes together with shifts reads them the same way
+	//on any machine, and never loads from an unaligned address
+	inline uint16_t ReadU16(const uint8_t *p)
+	{
+		return (uint16_t)(p[0] | (p[1] << 8));
+	}
+
+	inline int16_t ReadS16(const uint8_t *p)
+	{
+		return (int16_t)ReadU16(p);
+	}
+
+	inline uint32_t ReadU32(const uint8_t *p)
+	{
+		return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+	}
+}
 
 extern logger oLog;
 
-AngelcodeFont::AngelcodeFont(std::string fontfile, TextureManager *TexManager, GLSLProgram *shader)
+AngelcodeFont::AngelcodeFont(std::string fontfile, TextureManager *TexManager, GLSLProgram *shader, GLWorkQueue *workQueue, Blit3D *blit3D, AngelcodeFontMode mode)
 {
+	Setup(TexManager, shader, workQueue, blit3D, mode);
+
+	B3D::MappedFile file;
+	if(!file.Open(fontfile))
+	{
+		oLog(Level::Severe) << "Error while loading font data file: " << fontfile << " for AngelcodeFont";
+		assert("Couldn't open the font file" && 0);
+	}
+	else if(!Parse(file.Data(), file.Size()))
+	{
+		oLog(Level::Severe) << "AngelcodeFont file " << fontfile << " is damaged or not a binary Angelcode font";
+		assert("Malformed Angelcode font file" && 0);
+	}
+	file.Close();
+
+	Finish(fontfile);
+}
+
+AngelcodeFont::AngelcodeFont(const B3D::EmbeddedFont &font, TextureManager *TexManager, GLSLProgram *shader, GLWorkQueue *workQueue, Blit3D *blit3D, AngelcodeFontMode mode)
+{
+	Setup(TexManager, shader, workQueue, blit3D, mode);
+
+	if(!LoadTables(font))
+	{
+		oLog(Level::Severe) << "Embedded AngelcodeFont " << font.name << " is malformed";
+		assert("Malformed embedded Angelcode font" && 0);
+	}
+
+	Finish(font.name);
+}
+
+AngelcodeFont::AngelcodeFont(void)
+{
+	Setup(NULL, NULL, NULL, NULL, AngelcodeFontMode::BITMAP);
+	verts = NULL;
+	vboId = vaoId = 0;
+	texId = 0;
+}
+
+void AngelcodeFont::Setup(TextureManager *TexManager, GLSLProgram *shader, GLWorkQueue *workQueue, Blit3D *blit3D, AngelcodeFontMode mode)
+{
+	b3d = blit3D;
+	fontMode = mode;
+	glWork = workQueue;
 	texManager = TexManager;
 	angle = 0.f;
 	alpha = 1.f;
+	scale = 1.f;
+	textColour = glm::vec3(1.f);
 	prog = shader;
+	cacheText = true;
+	cacheVboId = cacheVaoId = 0;
+	cacheQuads = 0;
+	cacheBudget = ANGELCODE_CACHE_BYTES;
+	pages = 1;
+	arrayTexId = 0;
+	arrayPages = false;
+	lineHeight = base = 0;
+	scaleW = scaleH = 1;
+	for(int i = 0; i < 256; ++i) lowGlyphs[i] = -1;
+}
 
-	//determine endianness of architecture
-	unsigned char word[4] = { (unsigned char)0x01, (unsigned char)0x23, (unsigned char)0x45, (unsigned char)0x67 };
+//the font's textures and vertices, once its tables are filled in
+void AngelcodeFont::Finish(const std::string &fontfile)
+{
+	//distance fields go in an array even with one page, so there is one shader for them
+	arrayPages = pages > 1 || fontMode != AngelcodeFontMode::BITMAP;
+	if(!arrayPages)
+	{
+		texHandle = texManager->LoadTextureHandle(textureName);
+		texId = texManager->GetTextureId(texHandle);
+	}
+	else
+	{
+		//drawing the array needs one of Blit3D's texture array shaders
+		if(b3d == NULL || (int)pageNames.size() != pages || !LoadPages())
+		{
+			oLog(Level::Severe) << "Couldn't load the " << pages << " texture pages of AngelcodeFont " << fontfile;
+			assert("Couldn't load the font's texture pages" && 0);
+		}
+		texId = arrayTexId;
+	}
 
-	unsigned long be = 0x01234567;
-	unsigned long le = 0x67452301;
-	unsigned long me = 0x23016745;
-	unsigned long we;
+	verts = new B3D::TLVertex[4 * glyphs.size()]; //make an array of Textured Vertices
 
-	memcpy(&we, word, 4);
-	endian = 0;
-	if(we == le) endian = 0;
-	else if(we == be) endian = 1;
-	else if(we == me) endian = 2;
+	//set the vertex array points...we need 4 vertices, one for each corner of our sprite,
+	//per letter
 	
-	//Reading a binary file in
-
-	std::ifstream ifs;
-	ifs.open(fontfile, std::ios::in | std::ios::binary| std::ios::ate);
-		
-	if(!ifs.is_open()) 
+	for(size_t loop = 0; loop < glyphs.size(); ++loop)
 	{
-		oLog(Level::Severe) << "Error while loading font data file: " << fontfile << "for AngelcodeFont";
-		assert(ifs.is_open());
+		const AngelcodeCharDescriptor &C = glyphs[loop];
+		float cx = C.x;				// X Position Of Current Character
+		float cy = C.y;				// Y Position Of Current Character
+		
+		float charwidth = C.width;
+		float charheight = C.height;
+
+		float xoffset = C.xOffset;
+		float yoffset = C.yOffset - charheight; //invert char height for Blit3D coordinate system
+
+		verts[loop * 4].x = 0 + xoffset; verts[loop * 4].y = 0 + yoffset;		// Vertex Coord (Bottom Left)
+		verts[loop * 4].u = cx / scaleW;	verts[loop * 4].v = 1 - (cy + charheight) / scaleH;	// Texture Coord (Bottom Left)
+
+		verts[loop * 4 + 1].x = xoffset + charwidth;	verts[loop * 4 + 1].y = 0 + yoffset;	// Vertex Coord (Bottom Right)	
+		verts[loop * 4 + 1].u = (cx + charwidth) / scaleW;	verts[loop * 4 + 1].v = 1 - (cy + charheight) / scaleH;	// Texture Coord (Bottom Right)
+
+		verts[loop * 4 + 2].x = xoffset + charwidth;	verts[loop * 4 + 2].y = yoffset + charheight;	// Vertex Coord (Top Right)
+		verts[loop * 4 + 2].u = (cx + charwidth) / scaleW;	verts[loop * 4 + 2].v = 1 - cy / scaleH;	// Texture Coord (Top Right)
+
+		verts[loop * 4 + 3].x = 0 + xoffset;	verts[loop * 4 + 3].y = yoffset + charheight;		// Vertex Coord (Top Left)							
+		verts[loop * 4 + 3].u = cx / scaleW;	verts[loop * 4 + 3].v = 1 - cy / scaleH;	// Texture Coord (Top Left)
+
+		verts[loop * 4].z = verts[loop * 4 + 1].z = verts[loop * 4 + 2].z = verts[loop * 4 + 3].z = 0.f;
+		verts[loop * 4].layer = verts[loop * 4 + 1].layer = verts[loop * 4 + 2].layer = verts[loop * 4 + 3].layer = (GLfloat)C.page;
 	}
 
-	std::streampos end = ifs.tellg();
-	ifs.seekg(0, std::ios::beg);
-	std::streampos start = ifs.tellg();
-	uint32_t fsize = (uint32_t) (end - start);
+	//the glyph quads stay on the CPU, BlitText() copies them into a batch and streams that to the VBO
+	vboQuads = ANGELCODE_INITIAL_QUADS;
+	MakeVAO(vaoId, vboId, sizeof(B3D::TLVertex) * 4 * vboQuads, GL_STREAM_DRAW);
+}
 
-	int16_t *buf = new int16_t[fsize]; //memory to read into
-	char *buffer = (char *)buf;
+void AngelcodeFont::MakeVAO(GLuint &vao, GLuint &vbo, size_t bytes, GLenum usage)
+{
+	// generate a new VAO and get the associated ID
+	glGenVertexArrays(1, &vao); // Create our Vertex Array Object  
+	glBindVertexArray(vao); // Bind our Vertex Array Object so we can use it  
 
-	//load entire file in one go...much faster than reading 2 chars at a time!
-	ifs.read(buffer, fsize);
+	// generate a new VBO and get the associated ID
+	glGenBuffers(1, &vbo);
 
-	ifs.close();
+	// bind VBO in order to use
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, bytes, NULL, usage);
+
+	// Set up our vertex attributes pointers
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(B3D::TLVertex), BUFFER_OFFSET(0)); //3 values (x,y,z) per point, start at 0 offset 
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(B3D::TLVertex), BUFFER_OFFSET(sizeof(GLfloat) * 3)); //u,v,layer; the 2D shader only reads u,v
+
+	// activate attribute array
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glDisableVertexAttribArray(2); // don'yt use channel 2
+	glDisableVertexAttribArray(3); //don't use Color channel, we are textured
+
+	glBindVertexArray(0); // Disable our Vertex Array Object? 
+	glBindBuffer(GL_ARRAY_BUFFER, 0);// Disable our Vertex Buffer Object
+}
 
-	//process buffer
-	if(!(	buffer[0] == 'B'
-		&&	buffer[1] == 'M'
-		&&	buffer[2] == 'F'))
+bool AngelcodeFont::LoadPages(void)
+{
+	glGenTextures(1, &arrayTexId);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, arrayTexId);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, (GLsizei)scaleW, (GLsizei)scaleH, pages, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	bool loaded = true;
+	for(int page = 0; page < pages && loaded; ++page)
 	{
-		assert("Not a binary Angelcode font file" && 0);
+		DecodedImage image;
+		if(!texManager->DecodeImage(pageNames[page], image)) loaded = false;
+		else if(image.width != (int)scaleW || image.height != (int)scaleH)
+		{
+			oLog(Level::Severe) << "AngelcodeFont page " << pageNames[page] << " is " << image.width << "x" << image.height
+				<< ", the font expects " << scaleW << "x" << scaleH;
+			loaded = false;
+		}
+		else
+		{
+			//FreeImage hands us BGRA, our own decoder RGBA
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, page, image.width, image.height, 1,
+				image.bgra ? GL_BGRA : GL_RGBA, GL_UNSIGNED_BYTE, image.pixels);
+		}
+		texManager->ReleaseImage(image);
 	}
 
-	if(buffer[3] != 3)
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	return loaded;
+}
+
+AngelcodeFont::~AngelcodeFont()
+{
+	//only parsed, by Validate(): nothing was loaded
+	if(texManager == NULL)
 	{
-		assert("Not a version 3 font file" && 0);
+		delete[] verts;
+		return;
 	}
-		
-	uint32_t current = 3;
-	int vertsCounter = 0;
-	while(current < fsize - 1)
+
+	// free texture
+	if(!arrayPages) texManager->FreeTexture(texHandle);
+	else if(glWork) glWork->DeleteTexture(arrayTexId);
+	else glDeleteTextures(1, &arrayTexId);
+
+	delete[] verts;
+
+	// delete VBO when object destroyed
+	if(glWork)
 	{
-		current++;
-		switch(buffer[current])
-		{
-		case 1://info block
+		//batched with the rest of the frame's deletes
+		glWork->DeleteBuffer(vboId);
+		glWork->DeleteVertexArray(vaoId);
+		if(cacheQuads)
 		{
-			current++; //advance to size data
-			//move current to end of block
-			int count = ReadInt(current, buffer);
-			current += count + 3;
+			glWork->DeleteBuffer(cacheVboId);
+			glWork->DeleteVertexArray(cacheVaoId);
 		}
-			break;
-		case 2: //common block
+	}
+	else
+	{
+		glDeleteBuffers(1, &vboId);
+		glDeleteVertexArrays(1, &vaoId);
+		if(cacheQuads)
 		{
-			current++; //advance to size data
-			//use marker to advance through this block
-			int marker = current + 4; //move it past the block size data
-
-			//move current to end of block
-			int count = ReadInt(current, buffer);
-			current += count + 3;
-			
-			lineHeight = (float)ReadShortAndAdvance(marker, buffer);			
-			base = (float)ReadShortAndAdvance(marker, buffer);
-			scaleW = (float)ReadShortAndAdvance(marker, buffer);
-			scaleH = (float)ReadShortAndAdvance(marker, buffer);
-			
-			if(ReadShortAndAdvance(marker, buffer) != 1)
-			{
-				assert("More than one texture page" && 0);
-			}
+			glDeleteBuffers(1, &cacheVboId);
+			glDeleteVertexArrays(1, &cacheVaoId);
 		}
-			break;
+	}
+}
 
-		case 3: //page block
+const AngelcodeCharDescriptor *AngelcodeFont::FindGlyph(int32_t code) const
+{
+	if(code >= 0 && code < 256)
+	{
+		int32_t index = lowGlyphs[code];
+		return index < 0 ? NULL : &glyphs[index];
+	}
+
+	std::vector<int32_t>::const_iterator itr = std::lower_bound(highCodes.begin(), highCodes.end(), code);
+	if(itr == highCodes.end() || *itr != code) return NULL;
+	return &glyphs[highGlyphs[itr - highCodes.begin()]];
+}
+
+//how much to move the second glyph of the pair, 0 if they aren't kerned
+float AngelcodeFont::Kerning(int32_t first, const AngelcodeCharDescriptor *second) const
+{
+	size_t n = second->kernCount;
+	if(n == 0) return 0.f;
+
+	//only the second glyph's range needs searching, so its code is the same in every key there
+	uint64_t key = (kernKeys[second->kernStart] & 0xFFFFFFFF00000000ULL) | (uint32_t)first;
+
+	//branchless binary search: ends on the last key <= the one we want, the compiler turns the select into a cmov
+	const uint64_t *base = &kernKeys[second->kernStart];
+	while(n > 1)
+	{
+		size_t half = n / 2;
+		base = (base[half] <= key) ? base + half : base;
+		n -= half;
+	}
+
+	return (*base == key) ? kernAmounts[base - &kernKeys[0]] : 0.f;
+}
+
+//appends the quads for output, from byte start on, to batch; cursor is where the layout was at start.
+//With a mesh, its cursors are redone from start on too. Returns where the layout ended.
+AngelcodeFont::LayoutCursor AngelcodeFont::LayoutText(const std::string &output, size_t start, LayoutCursor cursor, TextMesh *mesh)
+{
+	size_t count = B3D::DecodeUTF8(output.data() + start, output.size() - start, codes, mesh ? &codeOffsets : NULL);
+
+	if(mesh)
+	{
+		mesh->cursors.resize(start);
+		mesh->cursors.reserve(output.size() + 1);
+	}
+
+	for(size_t i = 0; i < count; ++i)
+	{
+		if(mesh)
 		{
-			current++; //advance to size data
-			//use marker to advance through this block
-			int marker = current + 4; //move it past the block size data
+			//every byte of the character gets the cursor from before it, before kerning, which depends on what it turns out to be
+			size_t bytes = (i + 1 < count ? codeOffsets[i + 1] : output.size() - start) - codeOffsets[i];
+			mesh->cursors.insert(mesh->cursors.end(), bytes, cursor);
+		}
+
+		int32_t letter = codes[i];
 
-			//move current to end of block
-			int count = ReadInt(current, buffer);
-			current += count + 3;
+		//lookup this letter and fetch its verts offset
+		const AngelcodeCharDescriptor *C = FindGlyph(letter);
+		if(C != NULL)
+		{
+			cursor.pen += Kerning(cursor.prevLetter, C);
 
-			//just getting one texture name
-			while(buffer[marker] != 0)
+			const B3D::TLVertex *glyph = &verts[C->lookupVerts * 4];
+			for(int corner = 0; corner < 4; ++corner)
 			{
-				textureName += buffer[marker];
-				marker++;
+				batch.push_back(glyph[corner]);
+				batch.back().x += cursor.pen;
 			}
+
+			cursor.quads++;
+			cursor.pen += C->xAdvance;
+			cursor.prevLetter = letter; //store this letter for kerning the next one
 		}
-			break;
+	}
 
-		case 4: //character data
+	if(mesh) mesh->cursors.push_back(cursor);
+	return cursor;
+}
+
+void AngelcodeFont::SetTextCacheBudget(size_t bytes)
+{
+	meshes.clear();
+	meshLookup.clear();
+	layoutMeshLookup.clear();
+	meshRanges.clear();
+	lastDrawnAt.clear();
+
+	if(cacheQuads)
+	{
+		if(glWork)
 		{
-			current++; //advance to size data
-			//use marker to advance through this block
-			int marker = current + 4; //move it past the block size data
+			glWork->DeleteBuffer(cacheVboId);
+			glWork->DeleteVertexArray(cacheVaoId);
+		}
+		else
+		{
+			glDeleteBuffers(1, &cacheVboId);
+			glDeleteVertexArrays(1, &cacheVaoId);
+		}
+		cacheVboId = cacheVaoId = 0;
+		cacheQuads = 0; //made again the next time it's needed
+	}
 
-			//move current to end of block
-			int count = ReadInt(current, buffer);
-			current += count + 3;
+	cacheBudget = bytes;
+}
 
-			int numChars = count / 20;
-			for(int i = 0; i < numChars; ++i)
-			{
-				int charNum = ReadIntAndAdvance(marker, buffer);
+void AngelcodeFont::EvictMesh(std::list<TextMesh>::iterator mesh)
+{
+	meshRanges.erase(mesh->offset);
+	if(mesh->laidOut) layoutMeshLookup.erase(mesh->text);
+	else meshLookup.erase(mesh->text);
+	meshes.erase(mesh);
+}
 
-				AngelcodeCharDescriptor AD;
-				AD.x = ReadShortAndAdvance(marker, buffer);
-				AD.y = ReadShortAndAdvance(marker, buffer);
-				AD.width = ReadShortAndAdvance(marker, buffer);
-				AD.height = ReadShortAndAdvance(marker, buffer);
-				AD.xOffset = ReadShortAndAdvance(marker, buffer);
-				AD.yOffset = -(float)ReadShortAndAdvance(marker, buffer);//negate y offsets for Blit3D coordinate system!
-				AD.xAdvance = ReadShortAndAdvance(marker, buffer); 
-				AD.lookupVerts = vertsCounter;
-				if(Chars.count(charNum) == 0)
-				{
-					vertsCounter++; //only increment if unique key...turns out for some files we need this sanity check
-					//add to map
-					Chars[charNum] = AD;
-				}
-				
-				marker += 2; //skip page & chnl data
+//first fit in the cache VBO, throwing out the least recently drawn meshes until there is room
+bool AngelcodeFont::AllocateMesh(size_t quads, size_t &offset)
+{
+	for(;;)
+	{
+		size_t end = 0;
+		for(std::map<size_t, size_t>::iterator itr = meshRanges.begin(); itr != meshRanges.end(); ++itr)
+		{
+			if(itr->first - end >= quads)
+			{
+				offset = end;
+				return true;
 			}
+			end = itr->first + itr->second;
 		}
-			break;
 
-		case 5: //kerning pairs data
+		if(cacheQuads - end >= quads)
 		{
-			current++; //advance to size data
-			//use marker to advance through this block
-			int marker = current + 4; //move it past the block size data
+			offset = end;
+			return true;
+		}
 
-			//move current to end of block
-			int count = ReadInt(current, buffer);
-			current += count + 3;
+		if(meshes.empty()) return false;
+		EvictMesh(--meshes.end());
+	}
+}
 
-			int numKerns = count / 10;
-			
-			std::unordered_map<int32_t, AngelcodeCharDescriptor>::iterator itr;
+//finds, updates or makes the cached mesh for output. Returns meshes.end() if it shouldn't be cached.
+std::list<AngelcodeFont::TextMesh>::iterator AngelcodeFont::CachedMesh(const std::string &output, float x, float y)
+{
+	if(cacheQuads == 0)
+	{
+		cacheQuads = cacheBudget / (sizeof(B3D::TLVertex) * 4);
+		if(cacheQuads == 0) return meshes.end();
+		MakeVAO(cacheVaoId, cacheVboId, sizeof(B3D::TLVertex) * 4 * cacheQuads, GL_DYNAMIC_DRAW);
+	}
 
-			for(int i = 0; i < numKerns; ++i)
-			{
-				uint32_t charNum1 = ReadUIntAndAdvance(marker, buffer);
+	uint32_t bits[2];
+	memcpy(&bits[0], &x, 4);
+	memcpy(&bits[1], &y, 4);
+	uint64_t position = ((uint64_t)bits[0] << 32) | bits[1];
+
+	std::unordered_map<std::string, std::list<TextMesh>::iterator>::iterator found = meshLookup.find(output);
+	if(found != meshLookup.end())
+	{
+		meshes.splice(meshes.begin(), meshes, found->second);
+		lastDrawnAt[position] = output;
+		return meshes.begin();
+	}
+
+	if(lastDrawnAt.size() >= ANGELCODE_MAX_POSITIONS) lastDrawnAt.clear();
+	std::string &previous = lastDrawnAt[position];
 
-				uint32_t charNum2 = ReadUIntAndAdvance(marker, buffer);
+	//the string drawn here last time may only differ at the end, then only the end is laid out and uploaded again
+	found = meshLookup.find(previous);
+	if(found != meshLookup.end())
+	{
+		std::list<TextMesh>::iterator itr = found->second;
+		TextMesh &mesh = *itr;
 
-				int16_t amount = ReadShortAndAdvance(marker, buffer);
+		size_t prefix = 0;
+		size_t shortest = std::min(mesh.text.size(), output.size());
+		while(prefix < shortest && mesh.text[prefix] == output[prefix]) ++prefix;
 
-				//lookup second character, add first cahracter to it's kerning table
-				itr = Chars.find(charNum2);
-				if(itr != Chars.end())
+		//start again from the beginning of a character, not partway through one
+		while(prefix > 0 && ((prefix < output.size() && ((unsigned char)output[prefix] & 0xC0) == 0x80)
+			|| (prefix < mesh.text.size() && ((unsigned char)mesh.text[prefix] & 0xC0) == 0x80))) --prefix;
+
+		if(prefix > 0)
+		{
+			TextMesh updated;
+			updated.cursors.assign(mesh.cursors.begin(), mesh.cursors.begin() + prefix + 1);
+
+			batch.clear();
+			size_t quads = LayoutText(output, prefix, updated.cursors[prefix], &updated).quads;
+
+			if(quads > 0 && quads <= mesh.capacity)
+			{
+				size_t first = updated.cursors[prefix].quads;
+				if(!batch.empty())
 				{
-					itr->second.kerningTable[charNum1] = (float)amount;
+					glBindBuffer(GL_ARRAY_BUFFER, cacheVboId);
+					glBufferSubData(GL_ARRAY_BUFFER, sizeof(B3D::TLVertex) * 4 * (mesh.offset + first), sizeof(B3D::TLVertex) * batch.size(), &batch[0]);
+					glBindBuffer(GL_ARRAY_BUFFER, 0);
 				}
 
+				meshLookup.erase(mesh.text);
+				mesh.text = output;
+				mesh.quads = quads;
+				mesh.cursors.swap(updated.cursors);
+				meshLookup[output] = itr;
+
+				meshes.splice(meshes.begin(), meshes, itr);
+				previous = output;
+				return meshes.begin();
 			}
 		}
-			break;
+	}
 
-		default:
-		{
-			//skip unknown blocks for now
-			current++; //advance to size data
-			//move current to end of block
-			int count = ReadInt(current, buffer);
-			current += count + 3;
-		}
-			break;
-		}//end switch
+	//a new mesh
+	TextMesh mesh;
+	mesh.text = output;
+	mesh.laidOut = false;
+	batch.clear();
+	batch.reserve(output.size() * 4);
+	LayoutCursor start = { 0.f, 0, -1 };
+	LayoutText(output, 0, start, &mesh);
+
+	std::list<TextMesh>::iterator itr = StoreMesh(mesh, batch);
+	if(itr != meshes.end())
+	{
+		meshLookup[output] = itr;
+		previous = output;
 	}
+	return itr;
+}
 
-	delete[] buffer;
+//finds or makes the cached mesh for a laid out string
+std::list<AngelcodeFont::TextMesh>::iterator AngelcodeFont::CachedLayoutMesh(const std::string &key, const TextLayout &layout)
+{
+	if(cacheQuads == 0)
+	{
+		cacheQuads = cacheBudget / (sizeof(B3D::TLVertex) * 4);
+		if(cacheQuads == 0) return meshes.end();
+		MakeVAO(cacheVaoId, cacheVboId, sizeof(B3D::TLVertex) * 4 * cacheQuads, GL_DYNAMIC_DRAW);
+	}
 
-	texId = texManager->LoadTexture(textureName);
+	std::unordered_map<std::string, std::list<TextMesh>::iterator>::iterator found = layoutMeshLookup.find(key);
+	if(found != layoutMeshLookup.end())
+	{
+		meshes.splice(meshes.begin(), meshes, found->second);
+		return meshes.begin();
+	}
 
-	verts = new B3D::TVertex[4 * Chars.size()]; //make an array of Textured Vertices
+	TextMesh mesh;
+	mesh.text = key;
+	mesh.laidOut = true;
 
-	// generate a new VAO and get the associated ID
-	glGenVertexArrays(1, &vaoId); // Create our Vertex Array Object  
-	glBindVertexArray(vaoId); // Bind our Vertex Array Object so we can use it  
+	std::list<TextMesh>::iterator itr = StoreMesh(mesh, layout.verts);
+	if(itr != meshes.end()) layoutMeshLookup[key] = itr;
+	return itr;
+}
 
-	// generate a new VBO and get the associated ID
-	glGenBuffers(1, &vboId);
+//finds room for a new mesh and uploads its quads, returns meshes.end() if it shouldn't be cached
+std::list<AngelcodeFont::TextMesh>::iterator AngelcodeFont::StoreMesh(TextMesh &mesh, const std::vector<B3D::TLVertex> &quads)
+{
+	mesh.quads = quads.size() / 4;
+	mesh.capacity = (mesh.quads + ANGELCODE_MESH_GRANULARITY - 1) / ANGELCODE_MESH_GRANULARITY * ANGELCODE_MESH_GRANULARITY;
+
+	//nothing to draw, or so long it would push everything else out: stream it instead
+	if(mesh.quads == 0 || mesh.capacity > cacheQuads / 4) return meshes.end();
+	if(!AllocateMesh(mesh.capacity, mesh.offset)) return meshes.end();
+
+	glBindBuffer(GL_ARRAY_BUFFER, cacheVboId);
+	glBufferSubData(GL_ARRAY_BUFFER, sizeof(B3D::TLVertex) * 4 * mesh.offset, sizeof(B3D::TLVertex) * quads.size(), &quads[0]);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	meshRanges[mesh.offset] = mesh.capacity;
+	meshes.push_front(TextMesh());
+	meshes.front().text.swap(mesh.text);
+	meshes.front().offset = mesh.offset;
+	meshes.front().capacity = mesh.capacity;
+	meshes.front().quads = mesh.quads;
+	meshes.front().cursors.swap(mesh.cursors);
+	meshes.front().laidOut = mesh.laidOut;
+	return meshes.begin();
+}
 
-	// bind VBO in order to use
+//sends quads to the streaming VBO, leaving our VAO bound for DrawQuads()
+void AngelcodeFont::StreamQuads(const std::vector<B3D::TLVertex> &quads)
+{
+	size_t count = quads.size() / 4;
+
+	glBindVertexArray(vaoId); // Bind our Vertex Array Object 
 	glBindBuffer(GL_ARRAY_BUFFER, vboId);
 
-	//set the vertex array points...we need 4 vertices, one for each corner of our sprite,
-	//per letter
-	
-	for(auto C : Chars)
+	//orphan the last string's data rather than wait for the GPU to finish with it
+	if(count > vboQuads) vboQuads = std::max(count, vboQuads * 2);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(B3D::TLVertex) * 4 * vboQuads, NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(B3D::TLVertex) * quads.size(), &quads[0]);
+}
+
+//draws vertices from the bound VAO at dest_x, dest_y
+void AngelcodeFont::DrawQuads(GLint first, GLsizei count)
+{
+	GLSLProgram *shader = prog;
+	if(!arrayPages)
 	{
-		//C.second.lookupVerts = loop; can't update this way
-		int loop = C.second.lookupVerts;
-		assert(loop < Chars.size());
-		float cx = C.second.x;				// X Position Of Current Character
-		float cy = C.second.y;				// Y Position Of Current Character
-		
-		float charwidth = C.second.width;
-		float charheight = C.second.height;
+		//bind our texture
+		texManager->BindTexture(texHandle);
+	}
+	else
+	{
+		//every page at once, so glyphs from any of them draw in the same call
+		bool distanceField = fontMode != AngelcodeFontMode::BITMAP;
+		shader = distanceField ? b3d->shaderSDF : b3d->shader2dArray;
+		shader->use();
+		shader->setUniform("projectionMatrix", b3d->projectionMatrix);
+		shader->setUniform("viewMatrix", b3d->viewMatrix);
+		if(distanceField)
+		{
+			shader->setUniform("in_Colour", textColour);
+			shader->setUniform("in_MSDF", fontMode == AngelcodeFontMode::MSDF ? 1 : 0);
+		}
 
-		float xoffset = C.second.xOffset;
-		float yoffset = C.second.yOffset - charheight; //invert char height for Blit3D coordinate system
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, arrayTexId);
+		//bitmap pages get the same filtering single page fonts do; distances are interpolated between texels
+		texManager->BindSampler(texManager->GetSampler(false, !distanceField));
+	}
 
-		verts[loop * 4].x = 0 + xoffset; verts[loop * 4].y = 0 + yoffset;		// Vertex Coord (Bottom Left)
-		verts[loop * 4].u = cx / scaleW;	verts[loop * 4].v = 1 - (cy + charheight) / scaleH;	// Texture Coord (Bottom Left)
+	// set the translation matrix
+	modelMatrix = glm::translate(glm::mat4(1.f), glm::vec3(dest_x, dest_y, 0.f));
+	//apply rotation
+	modelMatrix = glm::rotate(modelMatrix, angle, glm::vec3(0.f, 0.f, 1.f));
 
-		verts[loop * 4 + 1].x = xoffset + charwidth;	verts[loop * 4 + 1].y = 0 + yoffset;	// Vertex Coord (Bottom Right)	
-		verts[loop * 4 + 1].u = (cx + charwidth) / scaleW;	verts[loop * 4 + 1].v = 1 - (cy + charheight) / scaleH;	// Texture Coord (Bottom Right)
+	//send our alpha to the shader
+	shader->setUniform("in_Alpha", alpha);
 
-		verts[loop * 4 + 2].x = xoffset + charwidth;	verts[loop * 4 + 2].y = yoffset + charheight;	// Vertex Coord (Top Right)
-		verts[loop * 4 + 2].u = (cx + charwidth) / scaleW;	verts[loop * 4 + 2].v = 1 - cy / scaleH;	// Texture Coord (Top Right)
+	//send our modelMatrix to the shader
+	shader->setUniform("modelMatrix", modelMatrix);
+	shader->setUniform("in_Scale_X", scale);
+	shader->setUniform("in_Scale_Y", scale);
 
-		verts[loop * 4 + 3].x = 0 + xoffset;	verts[loop * 4 + 3].y = yoffset + charheight;		// Vertex Coord (Top Left)							
-		verts[loop * 4 + 3].u = cx / scaleW;	verts[loop * 4 + 3].v = 1 - cy / scaleH;	// Texture Coord (Top Left)
+	//the whole string in one call
+	glDrawArrays(GL_QUADS, first, count);
 
-		verts[loop * 4].z = verts[loop * 4 + 1].z = verts[loop * 4 + 2].z = verts[loop * 4 + 3].z = 0.f;
+	// bind with 0, so, switch back to normal pointer operation
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	//sprites expect the 2D shader to be in use
+	if(shader != prog) prog->use();
+}
+
+//draws the string
+void AngelcodeFont::BlitText(float x, float y, std::string output)
+{
+	dest_x = x;
+	dest_y = y;
+
+	if(output.empty()) return;
+
+	std::list<TextMesh>::iterator mesh = meshes.end();
+	if(cacheText) mesh = CachedMesh(output, x, y);
+
+	if(mesh != meshes.end())
+	{
+		glBindVertexArray(cacheVaoId);
+		DrawQuads((GLint)mesh->offset * 4, (GLsizei)mesh->quads * 4);
+		return;
 	}
 
-	// upload data to VBO
-	glBufferData(GL_ARRAY_BUFFER, sizeof(B3D::TVertex) * 4 * Chars.size(), verts, GL_STATIC_DRAW);
+	//lay the string out: each glyph's quad, moved along by the pen position
+	batch.clear();
+	batch.reserve(output.size() * 4);
+	LayoutCursor start = { 0.f, 0, -1 };
+	LayoutText(output, 0, start, NULL);
 
-	// Set up our vertex attributes pointers
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(B3D::TVertex), BUFFER_OFFSET(0)); //3 values (x,y,z) per point, start at 0 offset 
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(B3D::TVertex), BUFFER_OFFSET(sizeof(GLfloat) * 3)); //Start after x,y,z, data 
+	if(batch.empty()) return;
+
+	StreamQuads(batch);
+	DrawQuads(0, (GLsizei)batch.size());
+}
 
+void AngelcodeFont::BlitText(float x, float y, const std::string &output, const TextLayoutParams &params)
+{
+	dest_x = x;
+	dest_y = y;
 
+	std::string key = LayoutKey(output, params);
+	const TextLayout &layout = Layout(output, params, key);
+	if(layout.verts.empty()) return;
 
-	// activate attribute array
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glDisableVertexAttribArray(2); // don'yt use channel 2
-	glDisableVertexAttribArray(3); //don't use Color channel, we are textured
+	std::list<TextMesh>::iterator mesh = meshes.end();
+	if(cacheText) mesh = CachedLayoutMesh(key, layout);
 
-	glBindVertexArray(0); // Disable our Vertex Array Object? 
-	glBindBuffer(GL_ARRAY_BUFFER, 0);// Disable our Vertex Buffer Object
+	if(mesh != meshes.end())
+	{
+		glBindVertexArray(cacheVaoId);
+		DrawQuads((GLint)mesh->offset * 4, (GLsizei)mesh->quads * 4);
+		return;
+	}
 
-	//free the memory once it's been uploaded
-	delete[] verts;
+	StreamQuads(layout.verts);
+	DrawQuads(0, (GLsizei)layout.verts.size());
 }
 
-AngelcodeFont::~AngelcodeFont()
+//the string followed by the parameters, so each way of laying a string out is memoized separately
+std::string AngelcodeFont::LayoutKey(const std::string &output, const TextLayoutParams &params)
 {
-	// free texture
-	texManager->FreeTexture(textureName);
+	std::string key;
+	key.reserve(output.size() + 11);
+	key = output;
+	key.push_back('\0');
+	key.append((const char *)&params.maxWidth, sizeof(float));
+	key.append((const char *)&params.lineSpacing, sizeof(float));
+	key.push_back((char)params.wrap);
+	key.push_back((char)params.align);
+	return key;
+}
 
-	// delete VBO when object destroyed
-	glDeleteBuffers(1, &vboId);
-	glDeleteVertexArrays(1, &vaoId);
+const TextLayout &AngelcodeFont::Layout(const std::string &output, const TextLayoutParams &params)
+{
+	return Layout(output, params, LayoutKey(output, params));
 }
 
-//draws the string
-void AngelcodeFont::BlitText(float x, float y, std::string output)
+const TextLayout &AngelcodeFont::Layout(const std::string &output, const TextLayoutParams &params, const std::string &key)
 {
-	dest_x = x;
-	dest_y = y;
+	std::unordered_map<std::string, TextLayout>::iterator found = layouts.find(key);
+	if(found != layouts.end()) return found->second;
 
-	glBindVertexArray(vaoId); // Bind our Vertex Array Object 
+	if(layouts.size() >= ANGELCODE_MAX_LAYOUTS) layouts.clear();
 
-	//bind our texture
-	texManager->BindTexture(texId);
+	TextLayout &layout = layouts[key];
+	BuildLayout(output, params, layout);
+	return layout;
+}
 
-	// set the translation matrix
-	modelMatrix = glm::translate(glm::mat4(1.f), glm::vec3(dest_x, dest_y, 0.f));
-	//apply rotation
-	modelMatrix = glm::rotate(modelMatrix, angle, glm::vec3(0.f, 0.f, 1.f));
+void AngelcodeFont::BuildLayout(const std::string &output, const TextLayoutParams &params, TextLayout &layout)
+{
+	layout.verts.clear();
+	layout.lines.clear();
+	layout.width = layout.height = 0.f;
 
-	//send our alpha to the shader
-	prog->setUniform("in_Alpha", alpha);
+	size_t count = B3D::DecodeUTF8(output, codes, &codeOffsets);
 
-	//send our modelMatrix to the shader
-	prog->setUniform("modelMatrix", modelMatrix);
-	prog->setUniform("in_Scale_X", 1.f); //default scaling
-	prog->setUniform("in_Scale_Y", 1.f); //default scaling
-	
-	std::unordered_map<int32_t, AngelcodeCharDescriptor>::iterator itr;
-	std::unordered_map<int32_t, float>::iterator itrK;
+	//where the lines break, in code points
+	struct LineRange
+	{
+		size_t start, end;
+		bool wrapped; //broken because it was too long, rather than at a newline or the end
+	};
+	std::vector<LineRange> ranges;
+
+	bool wrapping = params.wrap != TextWrap::NONE && params.maxWidth > 0.f;
+	const size_t none = (size_t)-1;
+	size_t lineStart = 0;
+	size_t lastSpace = none;
+	float pen = 0.f;
+	int32_t prevLetter = -1;
+
+	for(size_t i = 0; i < count; ++i)
+	{
+		int32_t letter = codes[i];
+		if(letter == '\n')
+		{
+			LineRange range = { lineStart, i, false };
+			ranges.push_back(range);
+			lineStart = i + 1;
+			pen = 0.f;
+			prevLetter = -1;
+			lastSpace = none;
+			continue;
+		}
 
-	int prevLetter = -1; //shouldn't find a kerning pair for this letter on first pass
+		const AngelcodeCharDescriptor *C = FindGlyph(letter);
+		if(C == NULL) continue;
+
+		float advance = Kerning(prevLetter, C) + C->xAdvance;
 
-	for(unsigned int i = 0; i < output.size(); ++i)
+		//spaces may hang past the edge, they are trimmed from the end of the line anyway
+		if(wrapping && letter != ' ' && i > lineStart && pen + advance > params.maxWidth)
+		{
+			//break after the last word that fits, or if there is none, before this character
+			size_t breakAt = (params.wrap == TextWrap::WORD && lastSpace != none && lastSpace > lineStart) ? lastSpace : i;
+			LineRange range = { lineStart, breakAt, true };
+			ranges.push_back(range);
+
+			lineStart = breakAt;
+			while(lineStart < count && codes[lineStart] == ' ') lineStart++;
+			pen = 0.f;
+			prevLetter = -1;
+			lastSpace = none;
+
+			//walk the new line again from its start
+			i = lineStart - 1;
+			continue;
+		}
+
+		if(letter == ' ') lastSpace = i;
+		pen += advance;
+		prevLetter = letter;
+	}
+
+	LineRange last = { lineStart, count, false };
+	ranges.push_back(last);
+
+	//measure each line without its trailing spaces
+	std::vector<float> lineWidths(ranges.size());
+	for(size_t l = 0; l < ranges.size(); ++l)
+	{
+		while(ranges[l].end > ranges[l].start && codes[ranges[l].end - 1] == ' ') ranges[l].end--;
+
+		float width = 0.f;
+		prevLetter = -1;
+		for(size_t i = ranges[l].start; i < ranges[l].end; ++i)
+		{
+			const AngelcodeCharDescriptor *C = FindGlyph(codes[i]);
+			if(C == NULL) continue;
+			width += Kerning(prevLetter, C) + C->xAdvance;
+			prevLetter = codes[i];
+		}
+
+		lineWidths[l] = width;
+		layout.width = std::max(layout.width, width);
+	}
+
+	float box = params.maxWidth > 0.f ? params.maxWidth : layout.width;
+	float lineAdvance = lineHeight * params.lineSpacing;
+
+	//then place the glyphs
+	layout.lines.resize(ranges.size());
+	layout.verts.reserve(count * 4);
+	for(size_t l = 0; l < ranges.size(); ++l)
 	{
-		//lookup this letter in the Chars map and fetch its verts offset
-		itr = Chars.find(output[i]);
-		if(itr != Chars.end())
-		{ 
-			//kerning: lookup previous letter in cyrrent character's kerning map
-			itrK = itr->second.kerningTable.find(prevLetter);
-			if(itrK != itr->second.kerningTable.end())
+		const LineRange &range = ranges[l];
+		TextLine &line = layout.lines[l];
+		line.width = lineWidths[l];
+		line.y = -(float)l * lineAdvance;
+
+		float spaceStretch = 0.f;
+		switch(params.align)
+		{
+		case TextAlign::LEFT:
+			line.x = 0.f;
+			break;
+		case TextAlign::CENTER:
+			line.x = (box - line.width) / 2;
+			break;
+		case TextAlign::RIGHT:
+			line.x = box - line.width;
+			break;
+		case TextAlign::JUSTIFY:
+			line.x = 0.f;
+			//only lines that were wrapped are stretched, the last line of a paragraph stays as it is
+			if(range.wrapped && line.width < box)
 			{
-				modelMatrix = glm::translate(modelMatrix, glm::vec3(itrK->second, 0.f, 0.f));
+				int spaces = 0;
+				for(size_t i = range.start; i < range.end; ++i) if(codes[i] == ' ') spaces++;
+				if(spaces > 0)
+				{
+					spaceStretch = (box - line.width) / spaces;
+					line.width = box;
+				}
 			}
-			
-			// draw a quad: 1 quad x 4points per quad = 4 verts, the third argument
-			glDrawArrays(GL_QUADS, itr->second.lookupVerts * 4, 4);
-			modelMatrix = glm::translate(modelMatrix, glm::vec3(itr->second.xAdvance, 0.f, 0.f));
-			prog->setUniform("modelMatrix", modelMatrix);
-			prevLetter = output[i]; //store this letter for kerning the next one
+			break;
 		}
-	}
 
-	// bind with 0, so, switch back to normal pointer operation
-	glBindVertexArray(0);
+		line.start = range.start < count ? codeOffsets[range.start] : output.size();
+		line.end = range.end < count ? codeOffsets[range.end] : output.size();
+		line.firstQuad = layout.verts.size() / 4;
 
-	return;
+		pen = line.x;
+		prevLetter = -1;
+		for(size_t i = range.start; i < range.end; ++i)
+		{
+			int32_t letter = codes[i];
+			const AngelcodeCharDescriptor *C = FindGlyph(letter);
+			if(C == NULL) continue;
+
+			pen += Kerning(prevLetter, C);
+
+			const B3D::TLVertex *glyph = &verts[C->lookupVerts * 4];
+			for(int corner = 0; corner < 4; ++corner)
+			{
+				layout.verts.push_back(glyph[corner]);
+				layout.verts.back().x += pen;
+				layout.verts.back().y += line.y;
+			}
+
+			pen += C->xAdvance;
+			if(letter == ' ') pen += spaceStretch;
+			prevLetter = letter;
+		}
+
+		line.quads = layout.verts.size() / 4 - line.firstQuad;
+	}
+
+	layout.height = (ranges.size() - 1) * lineAdvance + lineHeight;
 }
 
 //returns the width of the text string, in pixels
 float AngelcodeFont::WidthText(std::string output)
 {
-	float width_text = 0;
-	std::unordered_map<int32_t, AngelcodeCharDescriptor>::iterator itr;
-	std::unordered_map<int32_t, float>::iterator itrK;
+	std::unordered_map<std::string, float>::iterator found = widths.find(output);
+	if(found != widths.end()) return found->second * scale;
 
+	float width_text = 0;
 	int prevLetter = -1; //shouldn't find a kerning pair for this letter on first pass
 
-	for(unsigned int i = 0; i < output.size(); ++i)
+	size_t count = B3D::DecodeUTF8(output, codes);
+	for(size_t i = 0; i < count; ++i)
+	{
+		int32_t letter = codes[i];
+
+		const AngelcodeCharDescriptor *C = FindGlyph(letter);
+		if(C != NULL)
+		{
+			width_text += C->xAdvance + Kerning(prevLetter, C);
+
+			prevLetter = letter; //store this letter for kerning the next one
+		}
+	}
+
+	if(widths.size() >= ANGELCODE_MAX_WIDTHS) widths.clear();
+	widths[output] = width_text;
+
+	return width_text * scale;
+}
+
+//reads a binary (version 3) Angelcode font held in memory. The blocks are checked against the size of the data
+//before any of them is read, so a damaged file is turned away rather than read past its end.
+bool AngelcodeFont::Parse(const uint8_t *data, size_t size)
+{
+	if(data == NULL || size < 4 || data[0] != 'B' || data[1] != 'M' || data[2] != 'F')
+	{
+		oLog(Level::Severe) << "Not a binary Angelcode font file";
+		return false;
+	}
+
+	if(data[3] != 3)
+	{
+		oLog(Level::Severe) << "Not a version 3 Angelcode font file";
+		return false;
+	}
+
+	//check the layout of the blocks, and count what is in them so the tables can be sized once
+	const uint8_t *common = NULL;
+	size_t numChars = 0, numKerns = 0;
+	size_t offset = 4;
+	while(offset < size)
+	{
+		if(size - offset < ANGELCODE_BLOCK_HEADER_BYTES)
+		{
+			oLog(Level::Severe) << "Angelcode font block header at byte " << offset << " is cut off";
+			return false;
+		}
+
+		uint8_t type = data[offset];
+		uint32_t blockSize = ReadU32(data + offset + 1);
+		offset += ANGELCODE_BLOCK_HEADER_BYTES;
+		if(blockSize > size - offset)
+		{
+			oLog(Level::Severe) << "Angelcode font block " << (int)type << " runs " << blockSize - (size - offset) << " bytes past the end of the file";
+			return false;
+		}
+
+		bool valid = true;
+		switch(type)
+		{
+		case 2: //common block
+			valid = blockSize >= ANGELCODE_COMMON_BYTES;
+			common = data + offset;
+			break;
+
+		case 4: //character data
+			valid = blockSize % ANGELCODE_CHAR_BYTES == 0;
+			numChars += blockSize / ANGELCODE_CHAR_BYTES;
+			break;
+
+		case 5: //kerning pairs
+			valid = blockSize % ANGELCODE_KERN_BYTES == 0;
+			numKerns += blockSize / ANGELCODE_KERN_BYTES;
+			break;
+		}
+
+		if(!valid)
+		{
+			oLog(Level::Severe) << "Angelcode font block " << (int)type << " has a bad size, " << blockSize << " bytes";
+			return false;
+		}
+
+		offset += blockSize;
+	}
+
+	if(common == NULL)
 	{
+		oLog(Level::Severe) << "Angelcode font has no common block";
+		return false;
+	}
+
+	lineHeight = (float)ReadU16(common);
+	base = (float)ReadU16(common + 2);
+	scaleW = (float)ReadU16(common + 4);
+	scaleH = (float)ReadU16(common + 6);
+	pages = ReadU16(common + 8);
+	if(scaleW == 0 || scaleH == 0 || pages < 1)
+	{
+		oLog(Level::Severe) << "Angelcode font has a " << scaleW << "x" << scaleH << " texture and " << pages << " pages";
+		return false;
+	}
+
+	//now read the blocks, building the glyph lookup tables as the glyphs go by
+	glyphs.reserve(numChars);
+	std::vector<std::pair<int32_t, int32_t> > high; //code, index into glyphs
+	std::vector<std::pair<uint64_t, float> > kernPairs;
+	kernPairs.reserve(numKerns);
+	bool badPage = false;
 
-		itr = Chars.find(output[i]);
-		if(itr != Chars.end())
+	offset = 4;
+	while(offset < size)
+	{
+		uint8_t type = data[offset];
+		uint32_t blockSize = ReadU32(data + offset + 1);
+		const uint8_t *block = data + offset + ANGELCODE_BLOCK_HEADER_BYTES;
+		const uint8_t *blockEnd = block + blockSize;
+		offset += ANGELCODE_BLOCK_HEADER_BYTES + blockSize;
+
+		switch(type)
 		{
-			//kerning: lookup previous letter in current character's kerning map
-			itrK = itr->second.kerningTable.find(prevLetter);
-			if(itrK != itr->second.kerningTable.end())
+		case 3: //page block, one null terminated name per page
+			while(block < blockEnd)
 			{
-				width_text += (itr->second.xAdvance + itrK->second);
+				const uint8_t *name = block;
+				while(block < blockEnd && *block != 0) block++;
+				if(block > name) pageNames.push_back(std::string((const char *)name, block - name));
+				block++; //skip the null
 			}
-			else width_text += itr->second.xAdvance;
+			break;
 
-			prevLetter = output[i]; //store this letter for kerning the next one
+		case 4: //character data
+			for(; block < blockEnd; block += ANGELCODE_CHAR_BYTES)
+			{
+				AngelcodeCharDescriptor AD;
+				AD.x = ReadU16(block + 4);
+				AD.y = ReadU16(block + 6);
+				AD.width = ReadU16(block + 8);
+				AD.height = ReadU16(block + 10);
+				AD.xOffset = ReadS16(block + 12);
+				AD.yOffset = -(float)ReadS16(block + 14);//negate y offsets for Blit3D coordinate system!
+				AD.xAdvance = ReadS16(block + 16);
+				AD.page = block[18]; //block[19] is the channel, unused
+				if(AD.page >= pages) badPage = true;
+				AddGlyph((int32_t)ReadU32(block), AD, high);
+			}
+			break;
+
+		case 5: //kerning pairs
+			for(; block < blockEnd; block += ANGELCODE_KERN_BYTES)
+			{
+				uint32_t charNum1 = ReadU32(block);
+				uint32_t charNum2 = ReadU32(block + 4);
+				int16_t amount = ReadS16(block + 8);
+
+				//sorted by the second glyph first, so each glyph's pairs end up next to each other
+				kernPairs.push_back(std::make_pair(((uint64_t)charNum2 << 32) | charNum1, (float)amount));
+			}
+			break;
+
+		default: //info block, and anything newer we don't know
+			break;
 		}
 	}
 
-	return width_text;
+	if(badPage)
+	{
+		oLog(Level::Severe) << "Angelcode font has glyphs on pages past its " << pages << " pages";
+		for(int i = 0; i < 256; ++i) lowGlyphs[i] = -1;
+		glyphs.clear();
+		pageNames.clear();
+		return false;
+	}
+
+	BuildTables(high, kernPairs);
+	if(!pageNames.empty()) textureName = pageNames[0];
+	return true;
 }
 
-int16_t AngelcodeFont::ReadShortAndAdvance(int &offset, char buffer[])
+bool AngelcodeFont::Validate(const uint8_t *data, size_t size)
 {
-	int16_t *temp = (int16_t *)&buffer[offset];
-	int16_t val = *temp;
-	
-	switch(endian)
-	{
-	case 0://little-endian
-		//
-		break;
-
-	case 1: //big-endian	
-		val = swap_int16(val);
-		break;
-	case 2:
-		break;
-	}	
-	
-	offset += 2;
-	return val;
+	AngelcodeFont font;
+	if(!font.Parse(data, size)) return false;
+	return font.CheckTables();
 }
 
-int32_t AngelcodeFont::ReadIntAndAdvance(int &offset, char buffer[])
-{	
-	int32_t *charNum = (int32_t *)&buffer[offset];
-	int32_t val = *charNum; 	
-	
-	switch(endian)
-	{
-	case 0://little-endian
-		
-		break;
+//every index in the lookup tables lands inside the arrays it points into, and every glyph's kerning range is its own
+bool AngelcodeFont::CheckTables(void) const
+{
+	bool ok = highCodes.size() == highGlyphs.size() && kernKeys.size() == kernAmounts.size() && pages >= 1;
 
-	case 1: //big-endian	
-		val = swap_int32(val);		
-		break;
-	case 2: //middle-endian??
-		break;
+	for(int code = 0; ok && code < 256; ++code)
+		ok = lowGlyphs[code] < (int32_t)glyphs.size();
+
+	for(size_t i = 0; ok && i < highCodes.size(); ++i)
+		ok = (i == 0 || highCodes[i - 1] < highCodes[i]) && highGlyphs[i] >= 0 && highGlyphs[i] < (int32_t)glyphs.size()
+			&& FindGlyph(highCodes[i]) == &glyphs[highGlyphs[i]];
+
+	for(size_t i = 0; ok && i < glyphs.size(); ++i)
+	{
+		const AngelcodeCharDescriptor &C = glyphs[i];
+		ok = C.lookupVerts == (int)i && C.page >= 0 && C.page < pages
+			&& C.kernStart >= 0 && C.kernCount >= 0 && (size_t)C.kernStart + C.kernCount <= kernKeys.size();
+
+		//each pair in the range finds its own amount
+		for(int k = C.kernStart; ok && k < C.kernStart + C.kernCount; ++k)
+			ok = (kernKeys[k] >> 32) == (kernKeys[C.kernStart] >> 32)
+				&& Kerning((int32_t)(uint32_t)kernKeys[k], &C) == kernAmounts[k];
+		if(ok && C.kernCount) Kerning(-1, &C);
 	}
 
-	offset += 4;
-	return val;
+	if(!ok)
+	{
+		oLog(Level::Severe) << "AngelcodeFont built inconsistent lookup tables";
+		assert("AngelcodeFont lookup tables are inconsistent" && 0);
+	}
+	return ok;
 }
 
-uint32_t AngelcodeFont::ReadUIntAndAdvance(int &offset, char buffer[])
+//the same tables, from a font compiled into the program
+bool AngelcodeFont::LoadTables(const B3D::EmbeddedFont &font)
 {
-	uint32_t *charNum = (uint32_t *)&buffer[offset];
-	uint32_t val = *charNum;
+	if(font.scaleW == 0 || font.scaleH == 0 || font.pages < 1)
+	{
+		oLog(Level::Severe) << "Angelcode font has a " << font.scaleW << "x" << font.scaleH << " texture and " << font.pages << " pages";
+		return false;
+	}
 
-	switch(endian)
+	lineHeight = font.lineHeight;
+	base = font.base;
+	scaleW = font.scaleW;
+	scaleH = font.scaleH;
+	pages = font.pages;
+	pageNames.assign(font.pageNames, font.pageNames + pages);
+	textureName = pageNames[0];
+
+	glyphs.reserve(font.glyphCount);
+	std::vector<std::pair<int32_t, int32_t> > high;
+	for(size_t i = 0; i < font.glyphCount; ++i)
 	{
-	case 0://little-endian
+		const B3D::EmbeddedGlyph &glyph = font.glyphs[i];
+		if(glyph.page >= pages)
+		{
+			oLog(Level::Severe) << "Angelcode font has glyphs on pages past its " << pages << " pages";
+			return false;
+		}
 
-		break;
+		AngelcodeCharDescriptor AD;
+		AD.x = glyph.x;
+		AD.y = glyph.y;
+		AD.width = glyph.width;
+		AD.height = glyph.height;
+		AD.xOffset = glyph.xOffset;
+		AD.yOffset = -(float)glyph.yOffset;//negate y offsets for Blit3D coordinate system!
+		AD.xAdvance = glyph.xAdvance;
+		AD.page = glyph.page;
+		AddGlyph(glyph.code, AD, high);
+	}
 
-	case 1: //big-endian	
-		val = swap_uint32(val);
-		break;
-	case 2: //middle-endian??
-		break;
+	std::vector<std::pair<uint64_t, float> > kernPairs;
+	kernPairs.reserve(font.kerningCount);
+	for(size_t i = 0; i < font.kerningCount; ++i)
+	{
+		const B3D::EmbeddedKerning &pair = font.kerning[i];
+		kernPairs.push_back(std::make_pair(((uint64_t)pair.second << 32) | pair.first, (float)pair.amount));
 	}
 
-	offset += 4;
-	return val;
+	BuildTables(high, kernPairs);
+	return true;
 }
 
-int16_t AngelcodeFont::ReadShort(int offset, char buffer[])
+//adds a glyph unless its code is taken already: some files store a glyph more than once, the first one wins
+void AngelcodeFont::AddGlyph(int32_t code, AngelcodeCharDescriptor &AD, std::vector<std::pair<int32_t, int32_t> > &high)
 {
-	int16_t *temp = (int16_t *)&buffer[offset];
-	int16_t val = *temp;
-
-	switch(endian)
+	if(code >= 0 && code < 256)
 	{
-	case 0://little-endian
-		//
-		break;
+		if(lowGlyphs[code] != -1) return;
+		lowGlyphs[code] = (int32_t)glyphs.size();
+	}
+	else high.push_back(std::make_pair(code, (int32_t)glyphs.size()));
 
-	case 1: //big-endian	
-		val = swap_int16(val);
-		break;
-	case 2:
-		break;
-	}	
-	return val;
+	AD.lookupVerts = (int)glyphs.size();
+	glyphs.push_back(AD);
 }
 
-int32_t AngelcodeFont::ReadInt(int offset, char buffer[])
+//finishes the lookup tables: high holds (code, glyph index) for codes past 255, kernPairs ((second << 32 | first), amount)
+void AngelcodeFont::BuildTables(std::vector<std::pair<int32_t, int32_t> > &high, std::vector<std::pair<uint64_t, float> > &kernPairs)
 {
-	int32_t *charNum = (int32_t *)&buffer[offset];
-	int32_t val = *charNum;
+	//codes past 255 in a sorted table; sorting the pairs puts a repeated code's first glyph first
+	std::sort(high.begin(), high.end());
+	highCodes.reserve(high.size());
+	highGlyphs.reserve(high.size());
+	for(size_t i = 0; i < high.size(); ++i)
+	{
+		if(i > 0 && high[i].first == high[i - 1].first) continue;
+		highCodes.push_back(high[i].first);
+		highGlyphs.push_back(high[i].second);
+	}
 
-	switch(endian)
+	//and the kerning table: the last amount read for a pair wins, and pairs ending in a glyph we don't have are dropped
+	std::stable_sort(kernPairs.begin(), kernPairs.end(),
+		[](const std::pair<uint64_t, float> &a, const std::pair<uint64_t, float> &b) { return a.first < b.first; });
+
+	kernKeys.reserve(kernPairs.size());
+	kernAmounts.reserve(kernPairs.size());
+	for(size_t i = 0; i < kernPairs.size(); ++i)
 	{
-	case 0://little-endian
+		if(i + 1 < kernPairs.size() && kernPairs[i + 1].first == kernPairs[i].first) continue;
 
-		break;
+		AngelcodeCharDescriptor *second = (AngelcodeCharDescriptor *)FindGlyph((int32_t)(kernPairs[i].first >> 32));
+		if(second == NULL) continue;
 
-	case 1: //big-endian	
-		val = swap_int32(val);
-		break;
-	case 2: //middle-endian??
-		break;
+		if(second->kernCount == 0) second->kernStart = (int)kernKeys.size();
+		second->kernCount++;
+		kernKeys.push_back(kernPairs[i].first);
+		kernAmounts.push_back(kernPairs[i].second);
 	}
-	
-	return val;
-}
\ No newline at end of file
+}
@@ -1,12 +1,18 @@
 #include "Blit3D/BFont.h"
+#include <algorithm>
+
+//room for this many glyphs in the VBO to start with, it grows to fit longer strings
+#define BFONT_INITIAL_QUADS 64
 
 extern logger oLog;
 
-BFont::BFont(std::string TextureFileName, std::string widths_file, float fontsize, TextureManager *TexManager, GLSLProgram *shader)
+BFont::BFont(std::string TextureFileName, std::string widths_file, float fontsize, TextureManager *TexManager, GLSLProgram *shader, GLWorkQueue *workQueue)
 {
+	glWork = workQueue;
 	//load the texture via the texture manager
 	texManager = TexManager;
-	texId = texManager->LoadTexture(TextureFileName);
+	texHandle = texManager->LoadTextureHandle(TextureFileName);
+	texId = texManager->GetTextureId(texHandle);
 	if(texId == 0)
 	{
 		oLog(Level::Severe) << "Free Image loading error while loading image file: " << TextureFileName << "for Bfont";
@@ -85,8 +91,9 @@ BFont::BFont(std::string TextureFileName, std::string widths_file, float fontsiz
 		verts[loop * 4].z = verts[loop * 4 + 1].z = verts[loop * 4 + 2].z = verts[loop * 4 + 3].z = 0.f;
 	}
 
-	// upload data to VBO
-	glBufferData(GL_ARRAY_BUFFER, sizeof(B3D::TVertex) * 4 * 256, verts, GL_STATIC_DRAW);
+	//the glyph quads stay on the CPU, BlitText() copies them into a batch and streams that to the VBO
+	vboQuads = BFONT_INITIAL_QUADS;
+	glBufferData(GL_ARRAY_BUFFER, sizeof(B3D::TVertex) * 4 * vboQuads, NULL, GL_STREAM_DRAW);
 
 	// Set up our vertex attributes pointers
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(B3D::TVertex), BUFFER_OFFSET(0)); //3 values (x,y,z) per point, start at 0 offset 
@@ -106,9 +113,6 @@ BFont::BFont(std::string TextureFileName, std::string widths_file, float fontsiz
 	//find the modelMatrix location in the current shader
 	//modelMatrixLocation = glGetUniformLocation(shader->id(), "modelMatrix");
 	//alphaLocation = glGetUniformLocation(shader->id(), "in_Alpha"); //-Frderic Duguay
-
-	//free the memory once it's been uploaded
-	delete[] verts;
 }
 
 void BFont::BlitText(bool whichFont, float x, float y, std::string output)
@@ -116,10 +120,42 @@ void BFont::BlitText(bool whichFont, float x, float y, std::string output)
 	dest_x = x;
 	dest_y = y;
 
+	//lay the string out first: each glyph's quad, moved along by the pen position
+	batch.clear();
+	batch.reserve(output.size() * 4);
+
+	float scale = fontSize / 128;
+	float pen = 0.f;
+	for(unsigned int i = 0; i < output.size(); ++i)
+	{
+		int letter = output[i] - 32;
+		if(whichFont) letter += 128;
+		if(letter < 0 || letter > 255) continue; //not in the font, and would read outside verts
+
+		const B3D::TVertex *glyph = &verts[letter * 4];
+		for(int corner = 0; corner < 4; ++corner)
+		{
+			batch.push_back(glyph[corner]);
+			batch.back().x += pen;
+		}
+
+		pen += (float)widths[letter] * scale;
+	}
+
+	if(batch.empty()) return;
+
+	size_t quads = batch.size() / 4;
+
 	glBindVertexArray(vaoId); // Bind our Vertex Array Object 
+	glBindBuffer(GL_ARRAY_BUFFER, vboId);
+
+	//orphan the last string's data rather than wait for the GPU to finish with it
+	if(quads > vboQuads) vboQuads = std::max(quads, vboQuads * 2);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(B3D::TVertex) * 4 * vboQuads, NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(B3D::TVertex) * batch.size(), &batch[0]);
 
 	//bind our texture
-	texManager->BindTexture(texId);
+	texManager->BindTexture(texHandle);
 
 	// set the rotation/translation matrix
 	modelMatrix = glm::translate(glm::mat4(1.f), glm::vec3(dest_x, dest_y, 0.f));
@@ -132,21 +168,13 @@ void BFont::BlitText(bool whichFont, float x, float y, std::string output)
 	prog->setUniform("modelMatrix", modelMatrix);
 	prog->setUniform("in_Scale_X", 1.f); //default scaling
 	prog->setUniform("in_Scale_Y", 1.f); //default scaling
-	int letter;
 
-	float scale = fontSize / 128;
-	for(unsigned int i = 0; i < output.size(); ++i)
-	{
-		letter = output[i] - 32;
-		if(whichFont) letter += 128;
-		// draw a quad: 1 quad x 4points per quad = 4 verts, the third argument
-		glDrawArrays(GL_QUADS, letter * 4, 4);
-		modelMatrix = glm::translate(modelMatrix, glm::vec3((float)widths[letter] * scale, 0.f, 0.f));
-		prog->setUniform("modelMatrix", modelMatrix);
-	}
+	//the whole string in one call
+	glDrawArrays(GL_QUADS, 0, (GLsizei)batch.size());
 
 	// bind with 0, so, switch back to normal pointer operation
 	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
 	return;
 }
@@ -162,6 +190,7 @@ float BFont::WidthText(bool whichFont, std::string output)
 		letter = output[i] - 32;
 
 		if(whichFont) letter += 128;
+		if(letter < 0 || letter > 255) continue;
 
 		width_text += widths[letter] * scale;
 	}
@@ -172,9 +201,20 @@ float BFont::WidthText(bool whichFont, std::string output)
 BFont::~BFont(void)
 {
 	// free texture
-	texManager->FreeTexture(textureName);
+	texManager->FreeTexture(texHandle);
+
+	delete[] verts;
 
 	// delete VBO when object destroyed
-	glDeleteBuffers(1, &vboId);
-	glDeleteVertexArrays(1, &vaoId);
+	if(glWork)
+	{
+		//batched with the rest of the frame's deletes
+		glWork->DeleteBuffer(vboId);
+		glWork->DeleteVertexArray(vaoId);
+	}
+	else
+	{
+		glDeleteBuffers(1, &vboId);
+		glDeleteVertexArrays(1, &vaoId);
+	}
 }
\ No newline at end of file
@@ -1,20 +1,102 @@
 #include "Blit3D/Blit3D.h"
 
+#include <chrono>
+#include <algorithm>
+
 logger oLog("Blit3D.log", false);
 
 void(*Blit3DDoInput)(int, int, int, int);
 void(*Blit3DCursorPosition)(double, double);
 void(*Blit3DMouseButton)(int, int, int);
 void(*Blit3DScrollwheel)(double, double);
+void(*Blit3DDoJoystick)(void);
+void(*Blit3DDoInputEvent)(const B3D::InputEvent &);
 
 namespace B3D
 {
 	std::mutex loopMutex;
 
 	std::atomic<bool> quitLooping; //global var for multi-threaded loop control
+
+	//Blit3DThreadModel::RENDERTHREAD handshakes; globals, as DeInit() may delete the Blit3D before the threads finish
+	std::atomic<bool> pumpStopped; //the main thread has stopped calling the program's input callbacks
+	std::atomic<bool> renderFinished; //the render thread has run DeInit() and let go of the context
+	std::atomic<int> cursorRequest; //ShowCursor() from the render thread, applied by the main thread; -1 for none
+
+	//QueueInput(): the callbacks push here on the main thread, the update thread pops
+	InputQueue *inputQueue = NULL;
+	std::atomic<uint32_t> watchedJoysticks(0); //bit n for joystick n + 1
+	InputEvent joystickSeen[GLFW_JOYSTICK_LAST + 1]; //the last snapshot queued of each joystick, main thread only
 };
 
-void SimpleThreadUpdate(void(*Update)(double))
+//calls the callbacks for the queued events that came before until, on the update thread
+static void DrainInput(double until)
+{
+	if(B3D::inputQueue == NULL) return;
+
+	for(const B3D::InputEvent *event = B3D::inputQueue->Peek(); event != NULL && event->time <= until; event = B3D::inputQueue->Peek())
+	{
+		if(Blit3DDoInputEvent) Blit3DDoInputEvent(*event);
+		else switch(event->type)
+		{
+		case B3D::InputEventType::KEY:
+			if(Blit3DDoInput) Blit3DDoInput(event->key, event->scancode, event->action, event->mods);
+			break;
+		case B3D::InputEventType::CURSOR:
+			if(Blit3DCursorPosition) Blit3DCursorPosition(event->x, event->y);
+			break;
+		case B3D::InputEventType::MOUSEBUTTON:
+			if(Blit3DMouseButton) Blit3DMouseButton(event->button, event->action, event->mods);
+			break;
+		case B3D::InputEventType::SCROLL:
+			if(Blit3DScrollwheel) Blit3DScrollwheel(event->x, event->y);
+			break;
+		default:
+			break; //joystick snapshots only go to DoInputEvent()
+		}
+
+		B3D::inputQueue->Pop();
+	}
+}
+
+//queues a snapshot of each watched joystick that changed since its last one, on the main thread
+static void SnapshotJoysticks(void)
+{
+	if(B3D::inputQueue == NULL) return;
+
+	uint32_t watched = B3D::watchedJoysticks;
+	for(int j = 0; watched != 0 && j <= GLFW_JOYSTICK_LAST; ++j, watched >>= 1)
+	{
+		if(!(watched & 1)) continue;
+
+		B3D::InputEvent event = B3D::InputEvent();
+		event.type = B3D::InputEventType::JOYSTICK;
+		event.joystick = j + 1;
+		event.present = glfwJoystickPresent(j) != 0;
+		if(event.present)
+		{
+			int count = 0;
+			const float *axes = glfwGetJoystickAxes(j, &count);
+			event.axisCount = std::min(count, (int)B3D::InputEvent::MAX_AXES);
+			for(int i = 0; i < event.axisCount; ++i) event.axes[i] = axes[i];
+
+			const unsigned char *buttons = glfwGetJoystickButtons(j, &count);
+			event.buttonCount = std::min(count, (int)B3D::InputEvent::MAX_BUTTONS);
+			for(int i = 0; i < event.buttonCount; ++i) event.buttons[i] = buttons[i];
+		}
+
+		//only changes are queued
+		B3D::InputEvent &seen = B3D::joystickSeen[j];
+		if(seen.present == event.present && seen.axisCount == event.axisCount && seen.buttonCount == event.buttonCount
+			&& std::equal(event.axes, event.axes + event.axisCount, seen.axes)
+			&& std::equal(event.buttons, event.buttons + event.buttonCount, seen.buttons)) continue;
+
+		event.time = glfwGetTime();
+		if(B3D::inputQueue->Push(event)) seen = event;
+	}
+}
+
+void SimpleThreadUpdate(void(*Update)(double), B3D::TickScheduler *ticks)
 {
 	double time = glfwGetTime();
 	double prevTime = time;
@@ -22,6 +104,26 @@ void SimpleThreadUpdate(void(*Update)(double))
 
 	for(;;)
 	{
+		if(ticks->Fixed())
+		{
+			int due = ticks->WaitForTicks();
+
+			B3D::loopMutex.lock();
+			if(B3D::quitLooping)
+			{
+				B3D::loopMutex.unlock();
+				return;
+			}
+			for(int i = 0; i < due; ++i)
+			{
+				DrainInput(ticks->TickTime());
+				Update(ticks->TickSeconds());
+				ticks->TickRan();
+			}
+			B3D::loopMutex.unlock();
+			continue;
+		}
+
 		B3D::loopMutex.lock();
 		if(B3D::quitLooping)
 		{
@@ -33,12 +135,13 @@ void SimpleThreadUpdate(void(*Update)(double))
 		elapsedTime = time - prevTime;
 		prevTime = time;
 
+		DrainInput(time);
 		Update(elapsedTime);
 		B3D::loopMutex.unlock();
 	}
 }
 
-void MultiThreadUpdate(void(*Update)(double))
+void MultiThreadUpdate(void(*Update)(double), B3D::TickScheduler *ticks)
 {
 	double time = glfwGetTime();
 	double prevTime = time;
@@ -51,42 +154,99 @@ void MultiThreadUpdate(void(*Update)(double))
 			//time to get out of here
 			return;
 		}
+
+		if(ticks->Fixed())
+		{
+			int due = ticks->WaitForTicks();
+			for(int i = 0; i < due && !B3D::quitLooping; ++i)
+			{
+				DrainInput(ticks->TickTime());
+				Update(ticks->TickSeconds());
+				ticks->TickRan();
+			}
+			continue;
+		}
 		time = glfwGetTime();
 		elapsedTime = time - prevTime;
 		prevTime = time;
 
+		DrainInput(time);
 		Update(elapsedTime);
 	}
 }
 
+//a queued event of type, stamped now
+static B3D::InputEvent NewEvent(B3D::InputEventType type)
+{
+	B3D::InputEvent event = B3D::InputEvent();
+	event.type = type;
+	event.time = glfwGetTime();
+	return event;
+}
+
 static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
-	if(Blit3DDoInput) Blit3DDoInput(key, scancode, action, mods);
+	if(B3D::inputQueue)
+	{
+		B3D::InputEvent event = NewEvent(B3D::InputEventType::KEY);
+		event.key = key;
+		event.scancode = scancode;
+		event.action = action;
+		event.mods = mods;
+		B3D::inputQueue->Push(event);
+	}
+	else if(Blit3DDoInput) Blit3DDoInput(key, scancode, action, mods);
 }
 
 static void cursor_position_callback(GLFWwindow* window, double xpos, double ypos)
 {
-	if(Blit3DCursorPosition) Blit3DCursorPosition(xpos, ypos);
+	if(B3D::inputQueue)
+	{
+		B3D::InputEvent event = NewEvent(B3D::InputEventType::CURSOR);
+		event.x = xpos;
+		event.y = ypos;
+		B3D::inputQueue->Push(event);
+	}
+	else if(Blit3DCursorPosition) Blit3DCursorPosition(xpos, ypos);
 }
 
 static void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
 {
-	if(Blit3DMouseButton) Blit3DMouseButton(button, action, mods);
+	if(B3D::inputQueue)
+	{
+		B3D::InputEvent event = NewEvent(B3D::InputEventType::MOUSEBUTTON);
+		event.button = button;
+		event.action = action;
+		event.mods = mods;
+		B3D::inputQueue->Push(event);
+	}
+	else if(Blit3DMouseButton) Blit3DMouseButton(button, action, mods);
 }
 
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
-	if(Blit3DScrollwheel) Blit3DScrollwheel(xoffset, yoffset);
+	if(B3D::inputQueue)
+	{
+		B3D::InputEvent event = NewEvent(B3D::InputEventType::SCROLL);
+		event.x = xoffset;
+		event.y = yoffset;
+		B3D::inputQueue->Push(event);
+	}
+	else if(Blit3DScrollwheel) Blit3DScrollwheel(xoffset, yoffset);
 }
 
 Blit3D::Blit3D(Blit3DWindowModel windowMode, const char* window_name, int width, int height)
 {
 	sManager = NULL;
 	tManager = NULL;	
+	glWork = NULL;
+	jobs = NULL;
+	workerCount = 0;
 
 	Init = NULL;
 	Update = NULL;
 	Draw = NULL;
+	DrawInterpolated = NULL;
 	DeInit = NULL;
 	DoInput = NULL;
 	Blit3DDoInput = NULL;
@@ -98,6 +258,10 @@ Blit3D::Blit3D(Blit3DWindowModel windowMode, const char* window_name, int width,
 	DoScrollwheel = NULL;
 	Blit3DScrollwheel = NULL;
 	DoJoystick = NULL;
+	Blit3DDoJoystick = NULL;
+	threadModel = Blit3DThreadModel::SINGLETHREADED;
+	inputQueue = NULL;
+	Blit3DDoInputEvent = NULL;
 
 	winMode= windowMode;
 	screenWidth = (float)width;
@@ -108,6 +272,11 @@ Blit3D::Blit3D(Blit3DWindowModel windowMode, const char* window_name, int width,
 	farplane = 10000.f;
 
 	shader2d = NULL;
+	shader2dArray = NULL;
+	shaderSDF = NULL;
+	shaderBatch = NULL;
+	shaderBatchArray = NULL;
+	commandLists = NULL;
 	window = NULL;
 }
 
@@ -115,10 +284,14 @@ Blit3D::Blit3D()
 {
 	sManager = NULL;
 	tManager = NULL;
+	glWork = NULL;
+	jobs = NULL;
+	workerCount = 0;
 
 	Init = NULL;
 	Update = NULL;
 	Draw = NULL;
+	DrawInterpolated = NULL;
 	DeInit = NULL;
 	DoInput = NULL;
 	Blit3DDoInput = NULL;
@@ -130,6 +303,10 @@ Blit3D::Blit3D()
 	DoScrollwheel = NULL;
 	Blit3DScrollwheel = NULL;
 	DoJoystick = NULL;
+	Blit3DDoJoystick = NULL;
+	threadModel = Blit3DThreadModel::SINGLETHREADED;
+	inputQueue = NULL;
+	Blit3DDoInputEvent = NULL;
 
 	winMode = Blit3DWindowModel::BORDERLESSFULLSCREEN_1080P;
 	screenWidth = 1920.f;
@@ -140,22 +317,46 @@ Blit3D::Blit3D()
 	farplane = 10000.f;
 
 	shader2d = NULL;
+	shader2dArray = NULL;
+	shaderSDF = NULL;
+	shaderBatch = NULL;
+	shaderBatchArray = NULL;
+	commandLists = NULL;
 	window = NULL;
 }
 
 
 Blit3D::~Blit3D()
 {
-	//free all sprite memory first
+	//finish any jobs still running before the things they use go away
+	if(jobs) delete jobs;
+
+	//run the GL work still queued while the sprites it was queued for are alive: a sprite made off the GL
+	//thread during the last Update() is only set up here
+	if (glWork) glWork->Flush();
+
+	//free all sprite memory; the queue is empty, so nothing left in it can point at them
 	for(std::unordered_set<Sprite *>::iterator itr = spriteSet.begin(); itr != spriteSet.end(); itr++)
 	{
 		delete *itr;
 	}
 	spriteSet.clear(); // clear the elements 
 
+	if(commandLists) delete commandLists;
+
+	if(inputQueue)
+	{
+		B3D::inputQueue = NULL;
+		delete inputQueue;
+	}
+
+	//delete the GL objects the sprites and the rest freed
+	if (glWork) glWork->Flush();
+
 	//free the managers and all of their associated memory
 	if (tManager) delete tManager;
 	if (sManager) delete sManager;
+	if (glWork) delete glWork;
 }
 
 void Blit3D::Quit()
@@ -176,6 +377,35 @@ void Blit3D::SetUpdate(void(*func)(double))
 void Blit3D::SetDraw(void(*func)(void))
 {
 	Draw = func;
+	DrawInterpolated = NULL;
+}
+
+void Blit3D::SetDraw(void(*func)(double))
+{
+	DrawInterpolated = func;
+	Draw = NULL;
+}
+
+void Blit3D::DrawFrame(void)
+{
+	double now = glfwGetTime();
+	updateTicks.BeginFrame(now);
+
+	if(DrawInterpolated != NULL) DrawInterpolated(updateTicks.Interpolation(now));
+	else Draw();
+
+	//whatever was submitted and not drawn yet goes on top
+	commandLists->Draw();
+}
+
+void Blit3D::SubmitCommandList(CommandList *list)
+{
+	commandLists->Submit(list);
+}
+
+void Blit3D::DrawCommandLists(void)
+{
+	commandLists->Draw();
 }
 
 void Blit3D::SetDeInit(void(*func)(void))
@@ -189,6 +419,21 @@ void Blit3D::SetDoInput(void(*func)(int, int, int, int))
 	Blit3DDoInput = DoInput;
 }
 
+void Blit3D::SetWorkerCount(int workers)
+{
+	workerCount = workers;
+}
+
+void Blit3D::SetUpdateRate(double hz, int maxCatchUpTicks)
+{
+	updateTicks.SetRate(hz, maxCatchUpTicks);
+}
+
+B3D::TickStats Blit3D::GetTickStats(void)
+{
+	return updateTicks.Stats();
+}
+
 void Blit3D::SetSync(void(*func)(void))
 {
 	Sync = func;
@@ -232,10 +477,46 @@ bool Blit3D::CheckJoystick(int joystickNumber)
 void Blit3D::SetDoJoystick(void(*func)(void))
 {
 	DoJoystick = func;
+	Blit3DDoJoystick = DoJoystick;
+}
+
+void Blit3D::QueueInput(size_t capacity)
+{
+	if(inputQueue != NULL) return; //already queueing
+
+	inputQueue = new B3D::InputQueue(capacity);
+	B3D::inputQueue = inputQueue;
+}
+
+void Blit3D::SetDoInputEvent(void(*func)(const B3D::InputEvent &))
+{
+	Blit3DDoInputEvent = func;
+}
+
+void Blit3D::WatchJoystick(int joystickNumber, bool watch)
+{
+	if(joystickNumber < 1 || joystickNumber > GLFW_JOYSTICK_LAST + 1) return;
+
+	uint32_t bit = 1u << (joystickNumber - 1);
+	if(watch) B3D::watchedJoysticks |= bit;
+	else B3D::watchedJoysticks &= ~bit;
+}
+
+uint64_t Blit3D::DroppedInputEvents(void)
+{
+	return inputQueue ? inputQueue->Dropped() : 0;
 }
 
 void Blit3D::ShowCursor(bool show)
 {
+	//only the main thread may change the cursor, and it is pumping events
+	if(threadModel == Blit3DThreadModel::RENDERTHREAD)
+	{
+		B3D::cursorRequest = show ? 1 : 0;
+		glfwPostEmptyEvent();
+		return;
+	}
+
 	if(show) glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
 	else glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_HIDDEN);
 }
@@ -340,14 +621,33 @@ int Blit3D::Run(Blit3DThreadModel threadType)
 		glfwTerminate();
 		return 1;
 	}
-	glfwMakeContextCurrent(window);
-
 	//set some callbacks for input modes
 	glfwSetKeyCallback(window, key_callback);
 	glfwSetCursorPosCallback(window, cursor_position_callback);	
 	glfwSetMouseButtonCallback(window, mouse_button_callback);
 	glfwSetScrollCallback(window, scroll_callback);
 
+	B3D::quitLooping = false;
+	threadModel = threadType;
+
+	//the main thread only pumps events, GL belongs to the render thread
+	if(threadType == Blit3DThreadModel::RENDERTHREAD) return PumpEvents();
+
+	glfwMakeContextCurrent(window);
+	if(StartGL()) RunLoop(threadType);
+
+	if(DeInit != NULL) DeInit();
+
+	// close GL context and any other GLFW resources
+	glfwTerminate();
+
+	oLog(Level::Info) << "Terminated Blit3D";
+	return 0;
+}
+
+//makes the managers and built-in shaders, and calls Init(), on the thread the context is current on
+bool Blit3D::StartGL(void)
+{
 	// start GLEW extension handler
 	glewExperimental = GL_TRUE;
 	glewInit();
@@ -358,8 +658,10 @@ int Blit3D::Run(Blit3DThreadModel threadType)
 	oLog(Level::Info) << "Renderer: " << renderer;
 	oLog(Level::Info) << "OpenGL version supported: " << version;
 
-	sManager = new ShaderManager();
-	tManager = new TextureManager();
+	glWork = new GLWorkQueue(); //this thread owns the GL context
+	jobs = new JobSystem(workerCount);
+	sManager = new ShaderManager(glWork);
+	tManager = new TextureManager(glWork, jobs);
 
 	projectionMatrix = glm::mat4(1.f);
 	viewMatrix = glm::mat4(1.f);
@@ -410,6 +712,97 @@ int Blit3D::Run(Blit3DThreadModel threadType)
 	shader2d->bindAttribLocation(0, "in_Position");
 	shader2d->bindAttribLocation(1, "in_Texcoord");
 
+	//the same, but sampling a layer of a texture array: the third texture coordinate picks the layer
+	std::string vert2dArray = "#version 330 \n"
+		"uniform mat4 projectionMatrix; \n"
+		"uniform mat4 viewMatrix; \n"
+		"uniform mat4 modelMatrix; \n"
+		"layout(location = 0) in vec3 in_Position; \n"
+		"layout(location = 1) in vec3 in_Texcoord; \n"
+		"uniform float in_Scale_X = 1.f; \n"
+		"uniform float in_Scale_Y = 1.f; \n"
+		"out vec3 v_texcoord; \n"
+		"void main(void)\n"
+		"{\n"
+			"gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(in_Position.x * in_Scale_X, in_Position.y * in_Scale_Y, in_Position.z, 1.0); \n"
+			"v_texcoord = in_Texcoord; \n"
+		"}";
+
+	std::string frag2dArray = "#version 330 \n"
+		"uniform sampler2DArray mytexture; \n"
+		"in vec3 v_texcoord; \n"
+		"uniform float in_Alpha = 1.f; \n"
+		"out vec4 out_Color; \n"
+		"void main(void)"
+		"{ \n"
+		"vec4 myTexel = texture(mytexture, v_texcoord); \n"
+		"out_Color = myTexel * in_Alpha; \n"
+		"}";
+
+	shader2dArray = sManager->GetShader("shader2darray_built_in.vert", "shader2darray_built_in.frag", vert2dArray, frag2dArray);
+
+	//distance field glyphs: the texel holds the distance to the glyph's edge (0.5 is on it), which is turned into
+	//coverage over about one screen pixel, so the edge stays sharp at any scale or angle.
+	//MSDF atlases take the median of their three channels; single channel atlases come either as grey RGB with
+	//solid alpha, or white RGB with the distance in alpha, and min(r, a) reads both.
+	std::string fragSDF = "#version 330 \n"
+		"uniform sampler2DArray mytexture; \n"
+		"in vec3 v_texcoord; \n"
+		"uniform float in_Alpha = 1.f; \n"
+		"uniform vec3 in_Colour = vec3(1.f); \n"
+		"uniform int in_MSDF = 0; \n"
+		"out vec4 out_Color; \n"
+		"float median(float r, float g, float b) { return max(min(r, g), min(max(r, g), b)); } \n"
+		"void main(void)"
+		"{ \n"
+		"vec4 myTexel = texture(mytexture, v_texcoord); \n"
+		"float dist = in_MSDF != 0 ? median(myTexel.r, myTexel.g, myTexel.b) : min(myTexel.r, myTexel.a); \n"
+		"float edge = max(0.5f * fwidth(dist), 0.0001f); \n"
+		"out_Color = vec4(in_Colour, smoothstep(0.5f - edge, 0.5f + edge, dist) * in_Alpha); \n"
+		"}";
+
+	shaderSDF = sManager->GetShader("shadersdf_built_in.vert", "shadersdf_built_in.frag", vert2dArray, fragSDF);
+
+	//CommandLists: the vertices are already where they go, and carry their own colour to multiply the texel by
+	std::string vertBatch = "#version 330 \n"
+		"uniform mat4 projectionMatrix; \n"
+		"uniform mat4 viewMatrix; \n"
+		"layout(location = 0) in vec3 in_Position; \n"
+		"layout(location = 1) in vec3 in_Texcoord; \n"
+		"layout(location = 2) in vec4 in_Colour; \n"
+		"out vec3 v_texcoord; \n"
+		"out vec4 v_colour; \n"
+		"void main(void)\n"
+		"{\n"
+			"gl_Position = projectionMatrix * viewMatrix * vec4(in_Position, 1.0); \n"
+			"v_texcoord = in_Texcoord; \n"
+			"v_colour = in_Colour; \n"
+		"}";
+
+	std::string fragBatch = "#version 330 \n"
+		"uniform sampler2D mytexture; \n"
+		"in vec3 v_texcoord; \n"
+		"in vec4 v_colour; \n"
+		"out vec4 out_Color; \n"
+		"void main(void)"
+		"{ \n"
+		"out_Color = texture(mytexture, v_texcoord.xy) * v_colour; \n"
+		"}";
+
+	std::string fragBatchArray = "#version 330 \n"
+		"uniform sampler2DArray mytexture; \n"
+		"in vec3 v_texcoord; \n"
+		"in vec4 v_colour; \n"
+		"out vec4 out_Color; \n"
+		"void main(void)"
+		"{ \n"
+		"out_Color = texture(mytexture, v_texcoord) * v_colour; \n"
+		"}";
+
+	shaderBatch = sManager->GetShader("shaderbatch_built_in.vert", "shaderbatch_built_in.frag", vertBatch, fragBatch);
+	shaderBatchArray = sManager->GetShader("shaderbatch_built_in.vert", "shaderbatcharray_built_in.frag", vertBatch, fragBatchArray);
+	commandLists = new CommandListRenderer(this);
+
 	//2d orthographic projection
 	SetMode(Blit3DRenderMode::BLIT2D);	
 
@@ -417,51 +810,67 @@ int Blit3D::Run(Blit3DThreadModel threadType)
 	else
 	{
 		oLog(Level::Severe) << "No Init() provided";
-		goto error;
+		return false;
 	}
 
 	if(Update == NULL)
 	{
 		oLog(Level::Severe) << "No Update() provided";
-		goto error;
+		return false;
 	}
 
-	if(Draw == NULL)
+	if(Draw == NULL && DrawInterpolated == NULL)
 	{
 		oLog(Level::Severe) << "No Draw() provided";
-		goto error;
+		return false;
 	}
 
 	if(DoInput == NULL)
 	{
 		oLog(Level::Severe) << "No DoInput() provided";
-		goto error;
+		return false;
 	}
-	
+
+	return true;
+}
+
+//the frame loop for threadType, on the GL thread, until the window is closed
+void Blit3D::RunLoop(Blit3DThreadModel threadType)
+{
 	double time = glfwGetTime();
 	double prevTime = time;
 	double elapsedTime = 0;
-	B3D::quitLooping = false;
+
+#ifdef _WIN32
+	//sleeps are only as fine as the system timer, 15.6ms by default
+	if(updateTicks.Fixed()) timeBeginPeriod(1);
+#endif
+	updateTicks.Start(time);
 
 	//event loop
 	switch(threadType)
 	{
 	case Blit3DThreadModel::SIMPLEMULTITHREADED:
 	{
-		std::thread t1(SimpleThreadUpdate, Update);
+		std::thread t1(SimpleThreadUpdate, Update, &updateTicks);
 
 		while(!glfwWindowShouldClose(window))
 		{
-
-			Draw();
+			DrawFrame();
 			// put the stuff we've been drawing onto the display
 			glfwSwapBuffers(window);
 
+			//finish any GL work the Update thread asked for, and delete what was released this frame
+			glWork->Flush();
+			//send this frame's DynamicTexture changes on their way
+			tManager->UploadDynamicTextures();
+
 			B3D::loopMutex.lock();
 			if(Sync != NULL) Sync();
 
 			// update other events like input handling 
 			glfwPollEvents();
+			SnapshotJoysticks();
 			if(DoJoystick) DoJoystick();
 			B3D::loopMutex.unlock();
 		}
@@ -473,17 +882,22 @@ int Blit3D::Run(Blit3DThreadModel threadType)
 
 	case Blit3DThreadModel::MULTITHREADED:
 	{
-		std::thread t2(MultiThreadUpdate, Update);
+		std::thread t2(MultiThreadUpdate, Update, &updateTicks);
 
 		while(!glfwWindowShouldClose(window))
 		{
-
-			Draw();
+			DrawFrame();
 			// put the stuff we've been drawing onto the display
 			glfwSwapBuffers(window);
 
+			//finish any GL work the Update thread asked for, and delete what was released this frame
+			glWork->Flush();
+			//send this frame's DynamicTexture changes on their way
+			tManager->UploadDynamicTextures();
+
 			// update other events like input handling 
 			glfwPollEvents();
+			SnapshotJoysticks();
 			if(DoJoystick) DoJoystick();
 		}
 
@@ -492,6 +906,31 @@ int Blit3D::Run(Blit3DThreadModel threadType)
 	}
 		break;
 
+	case Blit3DThreadModel::RENDERTHREAD:
+	{
+		//we are the render thread: the main thread is in PumpEvents(), waiting on input
+		std::thread t3(MultiThreadUpdate, Update, &updateTicks);
+
+		while(!glfwWindowShouldClose(window))
+		{
+			DrawFrame();
+			// put the stuff we've been drawing onto the display
+			glfwSwapBuffers(window);
+
+			//finish any GL work the Update thread asked for, and delete what was released this frame
+			glWork->Flush();
+			//send this frame's DynamicTexture changes on their way
+			tManager->UploadDynamicTextures();
+
+			//wake the main thread, so DoJoystick() is still called once a frame
+			glfwPostEmptyEvent();
+		}
+
+		B3D::quitLooping = true;
+		t3.join();
+	}
+		break;
+
 	case Blit3DThreadModel::SINGLETHREADED:
 		//event loop
 		while(!glfwWindowShouldClose(window))
@@ -499,22 +938,103 @@ int Blit3D::Run(Blit3DThreadModel threadType)
 			time = glfwGetTime();
 			elapsedTime = time - prevTime;
 			prevTime = time;
-						
-			Update(elapsedTime);
 
-			Draw();
+			if(updateTicks.Fixed())
+			{
+				//the frame rate paces the loop, so run whatever ticks came due since the last frame
+				int due = updateTicks.DueTicks(time);
+				for(int i = 0; i < due; ++i)
+				{
+					DrainInput(updateTicks.TickTime());
+					Update(updateTicks.TickSeconds());
+					updateTicks.TickRan();
+				}
+			}
+			else
+			{
+				DrainInput(time);
+				Update(elapsedTime);
+			}
+
+			DrawFrame();
 			// put the stuff we've been drawing onto the display
 			glfwSwapBuffers(window);
 
+			//run GL work queued by any threads the program spawned, and delete what was released this frame
+			glWork->Flush();
+			//send this frame's DynamicTexture changes on their way
+			tManager->UploadDynamicTextures();
+
 			// update other events like input handling 
 			glfwPollEvents();
+			SnapshotJoysticks();
 			if(DoJoystick) DoJoystick();
 		}
 		break;
 	}
 
-error:
-	if(DeInit != NULL) DeInit();
+	if(updateTicks.Fixed())
+	{
+#ifdef _WIN32
+		timeEndPeriod(1);
+#endif
+		B3D::TickStats stats = updateTicks.Stats();
+		oLog(Level::Info) << "Ran " << stats.ticks << " update ticks at " << 1.0 / updateTicks.TickSeconds() << "Hz, "
+			<< stats.overruns << " overruns dropped " << stats.droppedTicks << " ticks";
+	}
+
+	if(DroppedInputEvents() > 0)
+		oLog(Level::Warning) << "Input queue of " << inputQueue->Capacity() << " events was full, dropped " << DroppedInputEvents();
+}
+
+void Blit3D::RenderThread(void)
+{
+	glfwMakeContextCurrent(window);
+	if(StartGL()) RunLoop(Blit3DThreadModel::RENDERTHREAD);
+
+	//the main thread must stop calling into the program before DeInit() frees what it uses
+	B3D::quitLooping = true;
+	glfwPostEmptyEvent();
+	while(!B3D::pumpStopped) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+	if(DeInit != NULL) DeInit(); //may delete us, so nothing below touches members
+	glfwMakeContextCurrent(NULL);
+
+	B3D::renderFinished = true;
+	glfwPostEmptyEvent();
+}
+
+int Blit3D::PumpEvents(void)
+{
+	//DeInit() may delete us on the render thread while we are still waiting here, so keep what we need
+	GLFWwindow *win = window;
+
+	B3D::pumpStopped = false;
+	B3D::renderFinished = false;
+	B3D::cursorRequest = -1;
+	std::thread render(&Blit3D::RenderThread, this);
+
+	while(!B3D::quitLooping)
+	{
+		//sleep until there is input, or the render thread finishes a frame, then handle it straight away
+		glfwWaitEvents();
+
+		int cursor = B3D::cursorRequest.exchange(-1);
+		if(cursor >= 0) glfwSetInputMode(win, GLFW_CURSOR, cursor ? GLFW_CURSOR_NORMAL : GLFW_CURSOR_HIDDEN);
+
+		SnapshotJoysticks();
+		if(Blit3DDoJoystick) Blit3DDoJoystick();
+	}
+
+	//nothing reaches the program's callbacks from here on
+	glfwSetKeyCallback(win, NULL);
+	glfwSetCursorPosCallback(win, NULL);
+	glfwSetMouseButtonCallback(win, NULL);
+	glfwSetScrollCallback(win, NULL);
+	B3D::pumpStopped = true;
+
+	while(!B3D::renderFinished) glfwWaitEvents();
+	render.join();
 
 	// close GL context and any other GLFW resources
 	glfwTerminate();
@@ -529,7 +1049,7 @@ Sprite *Blit3D::MakeSprite(GLfloat startX, GLfloat startY, GLfloat width, GLfloa
 	std::lock_guard<std::mutex> lock(spriteMutex);
 
 	//create a new sprite from a bitmap file
-	Sprite *sprite =  new Sprite(startX, startY, width, height, TextureFileName, tManager, shader2d);
+	Sprite *sprite =  new Sprite(startX, startY, width, height, TextureFileName, tManager, shader2d, glWork);
 
 	//add sprite pointer to the set tracking all allocated sprites
 	spriteSet.insert(sprite);
@@ -543,7 +1063,7 @@ Sprite*Blit3D::MakeSprite(RenderBuffer *rb)
 	std::lock_guard<std::mutex> lock(spriteMutex);
 
 	//create a new sprite from a renderbuffer
-	Sprite *sprite = new Sprite(rb, tManager, shader2d);
+	Sprite *sprite = new Sprite(rb, tManager, shader2d, glWork);
 
 	spriteSet.insert(sprite);
 
@@ -552,12 +1072,23 @@ Sprite*Blit3D::MakeSprite(RenderBuffer *rb)
 
 BFont *Blit3D::MakeBFont(std::string TextureFileName, std::string widths_file, float fontsize)
 {
-	return new BFont(TextureFileName, widths_file, fontsize, tManager, shader2d);
+	return new BFont(TextureFileName, widths_file, fontsize, tManager, shader2d, glWork);
 }
 
-AngelcodeFont *Blit3D::MakeAngelcodeFontFromBinary32(std::string filename)
+AngelcodeFont *Blit3D::MakeAngelcodeFontFromBinary32(std::string filename, AngelcodeFontMode fontMode)
 {
-	return new AngelcodeFont(filename, tManager, shader2d);
+	return new AngelcodeFont(filename, tManager, shader2d, glWork, this, fontMode);
+}
+
+AngelcodeFont *Blit3D::MakeAngelcodeFont(const B3D::EmbeddedFont &font, AngelcodeFontMode fontMode)
+{
+	return new AngelcodeFont(font, tManager, shader2d, glWork, this, fontMode);
+}
+
+void Blit3D::AddEmbeddedAssets(const B3D::EmbeddedAssets &assets)
+{
+	for(size_t i = 0; i < assets.imageCount; ++i) tManager->AddEmbeddedImage(*assets.images[i]);
+	for(size_t i = 0; i < assets.shaderCount; ++i) sManager->AddEmbeddedShader(*assets.shaders[i]);
 }
 
 RenderBuffer *Blit3D::MakeRenderBuffer(int width, int height, std::string name)
@@ -694,12 +1225,52 @@ void Blit3D::DeleteSprite(Sprite *sprite)
 	std::unordered_set<Sprite *>::iterator it = spriteSet.find(sprite);
 	if(it != spriteSet.end()) 
 	{
-		//delete the sprite and remove from set
-		delete *it;
+		//remove from set, the sprite itself is deleted on the GL thread at the end of the frame
 		spriteSet.erase(it);
+		glWork->DeferDestruction([sprite]() { delete sprite; });
 	}
 	else
 	{
 		oLog(Level::Warning) << "DeleteSprite() called on non-existant Sprite * " << sprite;
 	}
+}
+
+void Blit3D::DeleteFont(AngelcodeFont *font)
+{
+	if(font == NULL) return;
+	glWork->DeferDestruction([font]() { delete font; });
+}
+
+void Blit3D::DeleteFont(BFont *font)
+{
+	if(font == NULL) return;
+	glWork->DeferDestruction([font]() { delete font; });
+}
+
+void Blit3D::DeleteRenderBuffer(RenderBuffer *rb)
+{
+	if(rb == NULL) return;
+	glWork->DeferDestruction([rb]() { delete rb; });
+}
+
+TiledImage *Blit3D::MakeTiledImage(std::string filename, int tileSize, int poolLayers)
+{
+	return new TiledImage(filename, tileSize, poolLayers, this);
+}
+
+void Blit3D::DeleteTiledImage(TiledImage *image)
+{
+	if(image == NULL) return;
+	glWork->DeferDestruction([image]() { delete image; });
+}
+
+DynamicTexture *Blit3D::MakeDynamicTexture(int width, int height, std::string name, bool pixelate)
+{
+	return new DynamicTexture(width, height, name, pixelate, tManager, glWork);
+}
+
+void Blit3D::DeleteDynamicTexture(DynamicTexture *texture)
+{
+	if(texture == NULL) return;
+	glWork->DeferDestruction([texture]() { delete texture; });
 }
\ No newline at end of file
@@ -0,0 +1,371 @@
+#include "Blit3D/CommandList.h"
+
+#include <algorithm>
+
+extern logger oLog;
+
+namespace
+{
+	//numbers lists in the order they are made, to break ties between equal order values the same way every frame
+	std::atomic<uint64_t> nextSequence(0);
+
+	//rotates, scales and moves a corner the way a sprite's model matrix would
+	inline void Place(B3D::CVertex &vert, float localX, float localY, float x, float y, float c, float s)
+	{
+		vert.x = x + c * localX - s * localY;
+		vert.y = y + s * localX + c * localY;
+		vert.z = 0.f;
+	}
+
+	inline void Colour(B3D::CVertex *quad, float r, float g, float b, float a)
+	{
+		for(int i = 0; i < 4; ++i)
+		{
+			quad[i].r = r;
+			quad[i].g = g;
+			quad[i].b = b;
+			quad[i].a = a;
+		}
+	}
+
+	bool ListOrder(const CommandList *a, const CommandList *b)
+	{
+		if(a->order != b->order) return a->order < b->order;
+		return a->Sequence() < b->Sequence();
+	}
+}
+
+CommandList::CommandList(int drawOrder) : sequence(nextSequence++), order(drawOrder)
+{ }
+
+void CommandList::Reset(void)
+{
+	verts.clear();
+	runs.clear();
+}
+
+B3D::CVertex *CommandList::AddQuad(const TextureHandle &handle, GLuint texId, GLuint sampler, bool array)
+{
+	uint32_t quad = (uint32_t)(verts.size() / 4);
+
+	if(runs.empty() || runs.back().handle != handle || runs.back().texId != texId
+		|| runs.back().sampler != sampler || runs.back().array != array)
+	{
+		DrawRun run;
+		run.handle = handle;
+		run.texId = texId;
+		run.sampler = sampler;
+		run.array = array;
+		run.firstQuad = quad;
+		run.quads = 0;
+		runs.push_back(run);
+	}
+	runs.back().quads++;
+
+	verts.resize(verts.size() + 4);
+	return &verts[quad * 4];
+}
+
+void CommandList::AddSprite(const Sprite &sprite, float x, float y, float angle, float scaleX, float scaleY, float alpha)
+{
+	B3D::CVertex *quad = AddQuad(sprite.texHandle, 0, sprite.sampler, false);
+
+	float c = cosf(angle);
+	float s = sinf(angle);
+	float halfX = sprite.halfSizeX * scaleX;
+	float halfY = sprite.halfSizeY * scaleY;
+
+	//the same corners, in the same order, as the sprite's own quad
+	Place(quad[0], -halfX, halfY, x, y, c, s);
+	quad[0].u = sprite.u1; quad[0].v = sprite.v1;
+	Place(quad[1], -halfX, -halfY, x, y, c, s);
+	quad[1].u = sprite.u1; quad[1].v = sprite.v2;
+	Place(quad[2], halfX, -halfY, x, y, c, s);
+	quad[2].u = sprite.u2; quad[2].v = sprite.v2;
+	Place(quad[3], halfX, halfY, x, y, c, s);
+	quad[3].u = sprite.u2; quad[3].v = sprite.v1;
+
+	for(int i = 0; i < 4; ++i) quad[i].layer = 0.f;
+
+	//the 2D shader multiplies the whole texel by the sprite's alpha
+	Colour(quad, alpha, alpha, alpha, alpha);
+}
+
+void CommandList::AddSprite(const Sprite &sprite, const SpriteTransform &t, float blend, float alpha)
+{
+	float turn = fmodf(t.angle - t.prevAngle, 2.f * (float)M_PI);
+	if(turn > (float)M_PI) turn -= 2.f * (float)M_PI;
+	else if(turn < -(float)M_PI) turn += 2.f * (float)M_PI;
+
+	AddSprite(sprite, t.prevX + (t.x - t.prevX) * blend, t.prevY + (t.y - t.prevY) * blend, t.prevAngle + turn * blend,
+		t.prevScaleX + (t.scaleX - t.prevScaleX) * blend, t.prevScaleY + (t.scaleY - t.prevScaleY) * blend, alpha);
+}
+
+void CommandList::AddText(const AngelcodeFont &font, float x, float y, const std::string &text, float alpha)
+{
+	//distance fields need their own shader, BlitText() draws those
+	if(font.fontMode != AngelcodeFontMode::BITMAP) return;
+
+	size_t count = B3D::DecodeUTF8(text.data(), text.size(), codes, NULL);
+
+	float c = cosf(font.angle);
+	float s = sinf(font.angle);
+	float pen = 0.f;
+	int32_t prevLetter = -1;
+
+	for(size_t i = 0; i < count; ++i)
+	{
+		const AngelcodeCharDescriptor *C = font.FindGlyph(codes[i]);
+		if(C == NULL) continue;
+
+		pen += font.Kerning(prevLetter, C);
+
+		B3D::CVertex *quad = font.arrayPages ? AddQuad(TextureHandle(), font.arrayTexId, 0, true)
+			: AddQuad(font.texHandle, 0, 0, false);
+
+		const B3D::TLVertex *glyph = &font.verts[C->lookupVerts * 4];
+		for(int corner = 0; corner < 4; ++corner)
+		{
+			Place(quad[corner], (glyph[corner].x + pen) * font.scale, glyph[corner].y * font.scale, x, y, c, s);
+			quad[corner].u = glyph[corner].u;
+			quad[corner].v = glyph[corner].v;
+			quad[corner].layer = glyph[corner].layer;
+		}
+		Colour(quad, alpha, alpha, alpha, alpha);
+
+		pen += C->xAdvance;
+		prevLetter = codes[i];
+	}
+}
+
+void CommandList::AddRect(float x, float y, float width, float height, const glm::vec4 &colour)
+{
+	B3D::CVertex *quad = AddQuad(TextureHandle(), 0, 0, false);
+
+	//counterclockwise from the bottom left, like every other quad
+	quad[0].x = x;			quad[0].y = y;
+	quad[1].x = x + width;	quad[1].y = y;
+	quad[2].x = x + width;	quad[2].y = y + height;
+	quad[3].x = x;			quad[3].y = y + height;
+
+	for(int i = 0; i < 4; ++i)
+	{
+		quad[i].z = 0.f;
+		quad[i].u = quad[i].v = 0.5f;
+		quad[i].layer = 0.f;
+	}
+	Colour(quad, colour.r, colour.g, colour.b, colour.a);
+}
+
+void CommandList::AddLine(float x1, float y1, float x2, float y2, float thickness, const glm::vec4 &colour)
+{
+	float dx = x2 - x1;
+	float dy = y2 - y1;
+	float length = sqrtf(dx * dx + dy * dy);
+	if(length <= 0.f) return;
+
+	//half the thickness out to either side
+	float nx = -dy / length * thickness * 0.5f;
+	float ny = dx / length * thickness * 0.5f;
+
+	B3D::CVertex *quad = AddQuad(TextureHandle(), 0, 0, false);
+	quad[0].x = x1 - nx;	quad[0].y = y1 - ny;
+	quad[1].x = x2 - nx;	quad[1].y = y2 - ny;
+	quad[2].x = x2 + nx;	quad[2].y = y2 + ny;
+	quad[3].x = x1 + nx;	quad[3].y = y1 + ny;
+
+	for(int i = 0; i < 4; ++i)
+	{
+		quad[i].z = 0.f;
+		quad[i].u = quad[i].v = 0.5f;
+		quad[i].layer = 0.f;
+	}
+	Colour(quad, colour.r, colour.g, colour.b, colour.a);
+}
+
+//Renderer ------------------------------------------------------------------------------------
+
+CommandListRenderer::CommandListRenderer(Blit3D *blit3D)
+{
+	b3d = blit3D;
+	vboQuads = iboQuads = 0;
+
+	glGenVertexArrays(1, &vaoId);
+	glBindVertexArray(vaoId);
+
+	glGenBuffers(1, &vboId);
+	glBindBuffer(GL_ARRAY_BUFFER, vboId);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(B3D::CVertex), BUFFER_OFFSET(0)); //x,y,z
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(B3D::CVertex), BUFFER_OFFSET(sizeof(GLfloat) * 3)); //u,v,layer
+	glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(B3D::CVertex), BUFFER_OFFSET(sizeof(GLfloat) * 6)); //r,g,b,a
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glEnableVertexAttribArray(2);
+	glDisableVertexAttribArray(3);
+
+	//the index buffer is part of the VAO's state
+	glGenBuffers(1, &iboId);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, iboId);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	//rectangles and lines sample this, so they go through the same shader as everything else
+	const uint8_t white[4] = { 255, 255, 255, 255 };
+	glGenTextures(1, &whiteTexId);
+	glBindTexture(GL_TEXTURE_2D, whiteTexId);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+CommandListRenderer::~CommandListRenderer()
+{
+	b3d->glWork->DeleteBuffer(vboId);
+	b3d->glWork->DeleteBuffer(iboId);
+	b3d->glWork->DeleteVertexArray(vaoId);
+	b3d->glWork->DeleteTexture(whiteTexId);
+}
+
+void CommandListRenderer::Submit(CommandList *list)
+{
+	std::lock_guard<std::mutex> lock(submitMutex);
+	submitted.push_back(list);
+}
+
+bool CommandListRenderer::BindRun(const CommandList::DrawRun &run)
+{
+	TextureManager *tManager = b3d->tManager;
+
+	if(run.array)
+	{
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, run.texId);
+		tManager->BindSampler(tManager->GetSampler(false, true));
+		return true;
+	}
+
+	if(run.handle.IsNull())
+	{
+		tManager->BindTexture(whiteTexId);
+		return true;
+	}
+
+	//loaded off the GL thread, and not uploaded yet
+	if(tManager->GetTextureId(run.handle) == 0) return false;
+
+	if(run.sampler != 0) tManager->BindTexture(run.handle, GL_TEXTURE0, run.sampler);
+	else tManager->BindTexture(run.handle);
+	return true;
+}
+
+void CommandListRenderer::Draw(void)
+{
+	{
+		std::lock_guard<std::mutex> lock(submitMutex);
+		drawing.swap(submitted);
+	}
+	if(drawing.empty()) return;
+
+	std::stable_sort(drawing.begin(), drawing.end(), ListOrder);
+
+	size_t quads = 0;
+	for(size_t i = 0; i < drawing.size(); ++i) quads += drawing[i]->QuadCount();
+
+	if(quads > 0)
+	{
+		glBindVertexArray(vaoId);
+		glBindBuffer(GL_ARRAY_BUFFER, vboId);
+
+		//orphan last frame's vertices rather than wait for the GPU to finish with them, then pack every list in order
+		if(quads > vboQuads) vboQuads = std::max(quads, vboQuads * 2);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(B3D::CVertex) * 4 * vboQuads, NULL, GL_STREAM_DRAW);
+
+		size_t offset = 0;
+		for(size_t i = 0; i < drawing.size(); ++i)
+		{
+			const std::vector<B3D::CVertex> &verts = drawing[i]->verts;
+			if(verts.empty()) continue;
+			glBufferSubData(GL_ARRAY_BUFFER, sizeof(B3D::CVertex) * offset, sizeof(B3D::CVertex) * verts.size(), &verts[0]);
+			offset += verts.size();
+		}
+
+		//two triangles per quad, the same for every quad, so they only change when there are more quads
+		if(quads > iboQuads)
+		{
+			iboQuads = vboQuads;
+			std::vector<GLuint> indices(iboQuads * 6);
+			for(size_t q = 0; q < iboQuads; ++q)
+			{
+				GLuint first = (GLuint)(q * 4);
+				indices[q * 6] = first;
+				indices[q * 6 + 1] = first + 1;
+				indices[q * 6 + 2] = first + 2;
+				indices[q * 6 + 3] = first;
+				indices[q * 6 + 4] = first + 2;
+				indices[q * 6 + 5] = first + 3;
+			}
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * indices.size(), &indices[0], GL_STATIC_DRAW);
+		}
+
+		GLSLProgram *shaders[2] = { b3d->shaderBatch, b3d->shaderBatchArray };
+		for(int i = 0; i < 2; ++i)
+		{
+			shaders[i]->use();
+			shaders[i]->setUniform("projectionMatrix", b3d->projectionMatrix);
+			shaders[i]->setUniform("viewMatrix", b3d->viewMatrix);
+		}
+		GLSLProgram *current = shaders[1];
+
+		//runs with the same texture in a row are drawn together, even when they come from different lists
+		const CommandList::DrawRun *pending = NULL;
+		size_t pendingFirst = 0, pendingQuads = 0;
+		auto flush = [&]()
+		{
+			if(pending == NULL) return;
+
+			GLSLProgram *shader = pending->array ? shaders[1] : shaders[0];
+			if(shader != current)
+			{
+				shader->use();
+				current = shader;
+			}
+			if(BindRun(*pending))
+				glDrawElements(GL_TRIANGLES, (GLsizei)pendingQuads * 6, GL_UNSIGNED_INT, BUFFER_OFFSET(sizeof(GLuint) * 6 * pendingFirst));
+		};
+
+		size_t base = 0; //first quad of the list in the VBO
+		for(size_t i = 0; i < drawing.size(); ++i)
+		{
+			const std::vector<CommandList::DrawRun> &runs = drawing[i]->runs;
+			for(size_t r = 0; r < runs.size(); ++r)
+			{
+				const CommandList::DrawRun &run = runs[r];
+				if(pending != NULL && run.handle == pending->handle && run.texId == pending->texId
+					&& run.sampler == pending->sampler && run.array == pending->array)
+				{
+					pendingQuads += run.quads;
+					continue;
+				}
+
+				flush();
+				pending = &run;
+				pendingFirst = base + run.firstQuad;
+				pendingQuads = run.quads;
+			}
+			base += drawing[i]->QuadCount();
+		}
+		flush();
+
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		//sprites expect the 2D shader to be in use
+		b3d->shader2d->use();
+	}
+
+	for(size_t i = 0; i < drawing.size(); ++i) drawing[i]->Reset();
+	drawing.clear();
+}
@@ -0,0 +1,252 @@
+#include "Blit3D/DynamicTexture.h"
+#include <algorithm>
+#include <string.h>
+
+extern logger oLog;
+
+//past this many dirty rectangles in a frame, they are merged into their bounding box
+#define DYNAMICTEXTURE_MAX_RECTS 16
+
+DynamicTexture::DynamicTexture(int w, int h, std::string textureName, bool pixelated, TextureManager *TexManager, GLWorkQueue *workQueue)
+{
+	texManager = TexManager;
+	glWork = workQueue;
+	width = w;
+	height = h;
+	name = textureName;
+	pixelate = pixelated;
+
+	texId = 0;
+	pbo[0] = pbo[1] = 0;
+	nextPbo = 0;
+
+	assert(width > 0 && height > 0);
+
+	//starts out transparent black
+	pixels.assign((size_t)width * height * 4, 0);
+
+	//register the name right away, so sprites can be made from it; the texture object follows on the GL thread
+	texHandle = texManager->AddLoadedTexture(name, 0, width, height);
+	texManager->AddDynamicTexture(this);
+
+	if(glWork == NULL || glWork->OnGLThread())
+	{
+		MakeGLObjects();
+	}
+	else
+	{
+		glWork->Submit([=]()
+		{
+			MakeGLObjects();
+		});
+	}
+}
+
+DynamicTexture::~DynamicTexture()
+{
+	texManager->RemoveDynamicTexture(this);
+
+	//sprites made from us keep the texture itself alive until they are gone
+	texManager->FreeTexture(texHandle);
+
+	if(glWork)
+	{
+		glWork->DeleteBuffer(pbo[0]);
+		glWork->DeleteBuffer(pbo[1]);
+	}
+	else
+	{
+		glDeleteBuffers(2, pbo);
+	}
+}
+
+void DynamicTexture::MakeGLObjects(void)
+{
+	glGenTextures(1, &texId);
+	texManager->BindTexture(texId); //through the TextureManager, so it knows what is bound
+
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+	//it has no sampler of its own, so it carries its filtering
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, pixelate ? GL_NEAREST : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	//each PBO can hold the whole texture, the most one frame can upload
+	glGenBuffers(2, pbo);
+	for(int i = 0; i < 2; ++i)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo[i]);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)width * height * 4, NULL, GL_STREAM_DRAW);
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	if(!texManager->SetTextureId(texHandle, texId))
+	{
+		//we were released before the GL thread got here
+		glDeleteTextures(1, &texId);
+		texId = 0;
+		return;
+	}
+
+	//whatever was written before the texture existed goes up with the first upload
+	std::lock_guard<std::mutex> lock(pixelMutex);
+	dirty.clear();
+	DirtyRect all = { 0, 0, width, height };
+	dirty.push_back(all);
+}
+
+void DynamicTexture::AddDirtyRect(int x, int y, int w, int h)
+{
+	DirtyRect rect = { x, y, w, h };
+
+	//drop rectangles the new one covers, and skip it if one already covers it
+	for(size_t i = 0; i < dirty.size(); )
+	{
+		DirtyRect &d = dirty[i];
+		if(d.x <= x && d.y <= y && d.x + d.width >= x + w && d.y + d.height >= y + h) return;
+
+		if(x <= d.x && y <= d.y && x + w >= d.x + d.width && y + h >= d.y + d.height)
+		{
+			dirty[i] = dirty.back();
+			dirty.pop_back();
+		}
+		else ++i;
+	}
+
+	dirty.push_back(rect);
+
+	if(dirty.size() > DYNAMICTEXTURE_MAX_RECTS)
+	{
+		//too many little uploads, send their bounding box instead
+		int x1 = width, y1 = height, x2 = 0, y2 = 0;
+		for(size_t i = 0; i < dirty.size(); ++i)
+		{
+			x1 = std::min(x1, dirty[i].x);
+			y1 = std::min(y1, dirty[i].y);
+			x2 = std::max(x2, dirty[i].x + dirty[i].width);
+			y2 = std::max(y2, dirty[i].y + dirty[i].height);
+		}
+
+		dirty.clear();
+		DirtyRect box = { x1, y1, x2 - x1, y2 - y1 };
+		dirty.push_back(box);
+	}
+}
+
+void DynamicTexture::Update(int x, int y, int w, int h, const uint8_t *source, int sourceStride)
+{
+	//tightly packed rows are as wide as the caller's rectangle, not the clipped one
+	if(sourceStride == 0) sourceStride = w * 4;
+
+	//clip to the texture
+	int sourceX = 0, sourceY = 0;
+	if(x < 0) { sourceX = -x; w += x; x = 0; }
+	if(y < 0) { sourceY = -y; h += y; y = 0; }
+	w = std::min(w, width - x);
+	h = std::min(h, height - y);
+	if(w <= 0 || h <= 0) return;
+
+	source += sourceY * sourceStride + sourceX * 4;
+
+	std::lock_guard<std::mutex> lock(pixelMutex);
+
+	for(int row = 0; row < h; ++row)
+	{
+		memcpy(&pixels[((size_t)(y + row) * width + x) * 4], source + row * sourceStride, w * 4);
+	}
+
+	AddDirtyRect(x, y, w, h);
+}
+
+void DynamicTexture::Update(const uint8_t *source)
+{
+	Update(0, 0, width, height, source);
+}
+
+void DynamicTexture::Fill(int x, int y, int w, int h, uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+{
+	if(x < 0) { w += x; x = 0; }
+	if(y < 0) { h += y; y = 0; }
+	w = std::min(w, width - x);
+	h = std::min(h, height - y);
+	if(w <= 0 || h <= 0) return;
+
+	uint8_t colour[4] = { r, g, b, a };
+
+	std::lock_guard<std::mutex> lock(pixelMutex);
+
+	for(int row = 0; row < h; ++row)
+	{
+		uint8_t *dst = &pixels[((size_t)(y + row) * width + x) * 4];
+		for(int col = 0; col < w; ++col, dst += 4) memcpy(dst, colour, 4);
+	}
+
+	AddDirtyRect(x, y, w, h);
+}
+
+void DynamicTexture::Upload(void)
+{
+	if(texId == 0) return;
+
+	GLuint buffer = pbo[nextPbo];
+	std::vector<DirtyRect> rects;
+
+	{
+		std::lock_guard<std::mutex> lock(pixelMutex);
+		if(dirty.empty()) return;
+
+		//the rectangles never overlap much, but they might still add up to more than the PBO holds
+		size_t bytes = 0;
+		for(size_t i = 0; i < dirty.size(); ++i) bytes += (size_t)dirty[i].width * dirty[i].height * 4;
+		if(bytes > (size_t)width * height * 4)
+		{
+			dirty.clear();
+			DirtyRect all = { 0, 0, width, height };
+			dirty.push_back(all);
+			bytes = (size_t)width * height * 4;
+		}
+
+		//invalidating lets the driver hand us fresh memory instead of waiting on the GPU
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+		uint8_t *dst = (uint8_t *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		if(dst == NULL)
+		{
+			oLog(Level::Severe) << "DynamicTexture " << name << " couldn't map its pixel buffer";
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			return;
+		}
+
+		//pack each rectangle's rows one after the other
+		for(size_t i = 0; i < dirty.size(); ++i)
+		{
+			const DirtyRect &d = dirty[i];
+			size_t rowBytes = (size_t)d.width * 4;
+			for(int row = 0; row < d.height; ++row, dst += rowBytes)
+			{
+				memcpy(dst, &pixels[((size_t)(d.y + row) * width + d.x) * 4], rowBytes);
+			}
+		}
+
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		rects.swap(dirty);
+	}
+
+	//copies from the PBO, so these return without waiting for the data to reach the texture
+	texManager->BindTexture(texId);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	size_t offset = 0;
+	for(size_t i = 0; i < rects.size(); ++i)
+	{
+		const DirtyRect &d = rects[i];
+		glTexSubImage2D(GL_TEXTURE_2D, 0, d.x, d.y, d.width, d.height, GL_RGBA, GL_UNSIGNED_BYTE, BUFFER_OFFSET(offset));
+		offset += (size_t)d.width * d.height * 4;
+	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	nextPbo = 1 - nextPbo;
+}
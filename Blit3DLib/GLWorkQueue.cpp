@@ -0,0 +1,117 @@
+#include "Blit3D/GLWorkQueue.h"
+#include <cassert>
+
+GLWorkQueue::GLWorkQueue()
+{
+	glThread = std::this_thread::get_id();
+}
+
+void GLWorkQueue::SetGLThread(void)
+{
+	std::lock_guard<std::mutex> lock(queueMutex);
+	glThread = std::this_thread::get_id();
+}
+
+bool GLWorkQueue::OnGLThread(void)
+{
+	return std::this_thread::get_id() == glThread;
+}
+
+void GLWorkQueue::Submit(std::function<void(void)> work)
+{
+	if(OnGLThread())
+	{
+		work();
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(queueMutex);
+	pending.push_back(work);
+}
+
+void GLWorkQueue::DeferDestruction(std::function<void(void)> destroy)
+{
+	std::lock_guard<std::mutex> lock(queueMutex);
+	pendingDestruction.push_back(destroy);
+}
+
+void GLWorkQueue::QueueDelete(std::vector<GLuint> &list, GLuint id)
+{
+	if(id == 0) return; //never created, or already gone
+
+	std::lock_guard<std::mutex> lock(queueMutex);
+	list.push_back(id);
+}
+
+void GLWorkQueue::DeleteTexture(GLuint id)
+{
+	QueueDelete(deadTextures, id);
+}
+
+void GLWorkQueue::DeleteBuffer(GLuint id)
+{
+	QueueDelete(deadBuffers, id);
+}
+
+void GLWorkQueue::DeleteVertexArray(GLuint id)
+{
+	QueueDelete(deadVertexArrays, id);
+}
+
+void GLWorkQueue::DeleteFramebuffer(GLuint id)
+{
+	QueueDelete(deadFramebuffers, id);
+}
+
+void GLWorkQueue::DeleteRenderbuffer(GLuint id)
+{
+	QueueDelete(deadRenderbuffers, id);
+}
+
+void GLWorkQueue::Flush(void)
+{
+	assert(OnGLThread() && "GLWorkQueue::Flush() called off the GL thread");
+
+	//grab the work and the destruction lists together, so anything created and then released
+	//by another thread is either handled completely by this flush or left for the next one
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		executing.swap(pending);
+		executingDestruction.swap(pendingDestruction);
+	}
+
+	for(size_t i = 0; i < executing.size(); ++i) executing[i]();
+	executing.clear();
+
+	//destructors queue their GL names with the Delete*() methods, so run them before deleting
+	for(size_t i = 0; i < executingDestruction.size(); ++i) executingDestruction[i]();
+	executingDestruction.clear();
+
+	//now delete the dead GL names, one call per type
+	std::lock_guard<std::mutex> lock(queueMutex);
+	if(!deadVertexArrays.empty())
+	{
+		glDeleteVertexArrays((GLsizei)deadVertexArrays.size(), &deadVertexArrays[0]);
+		deadVertexArrays.clear();
+	}
+	if(!deadBuffers.empty())
+	{
+		glDeleteBuffers((GLsizei)deadBuffers.size(), &deadBuffers[0]);
+		deadBuffers.clear();
+	}
+	if(!deadFramebuffers.empty())
+	{
+		glDeleteFramebuffers((GLsizei)deadFramebuffers.size(), &deadFramebuffers[0]);
+		deadFramebuffers.clear();
+	}
+	if(!deadRenderbuffers.empty())
+	{
+		glDeleteRenderbuffers((GLsizei)deadRenderbuffers.size(), &deadRenderbuffers[0]);
+		deadRenderbuffers.clear();
+	}
+	if(!deadTextures.empty())
+	{
+		glDeleteTextures((GLsizei)deadTextures.size(), &deadTextures[0]);
+		deadTextures.clear();
+	}
+}
@@ -0,0 +1,782 @@
+#include "Blit3D/ImageDecoder.h"
+#include <string.h>
+#include <vector>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+	#define B3D_IMAGE_SSE2
+	#include <emmintrin.h>
+#endif
+
+namespace
+{
+	uint32_t ReadBE32(const uint8_t *p)
+	{
+		return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+	}
+
+	//---------------------------------------------------------------------------------------
+	// QOI, see https://qoiformat.org/qoi-specification.pdf
+	//---------------------------------------------------------------------------------------
+
+	const size_t QOI_HEADER_SIZE = 14;
+	const size_t QOI_PADDING_SIZE = 8;
+
+	bool ProbeQOI(const uint8_t *data, size_t size, B3D::ImageInfo &info)
+	{
+		if(size < QOI_HEADER_SIZE + QOI_PADDING_SIZE) return false;
+		if(data[0] != 'q' || data[1] != 'o' || data[2] != 'i' || data[3] != 'f') return false;
+
+		uint32_t width = ReadBE32(data + 4);
+		uint32_t height = ReadBE32(data + 8);
+		uint8_t channels = data[12];
+
+		if(width == 0 || height == 0 || (channels != 3 && channels != 4)) return false;
+		//stay well clear of overflowing the output size
+		if((uint64_t)width * height > 400000000ULL) return false;
+
+		info.format = B3D::ImageFormat::QOI;
+		info.width = width;
+		info.height = height;
+		return true;
+	}
+
+	bool DecodeQOI(const uint8_t *data, size_t size, const B3D::ImageInfo &info, uint8_t *out)
+	{
+		uint8_t index[64][4];
+		memset(index, 0, sizeof(index));
+
+		uint8_t px[4] = { 0, 0, 0, 255 };
+		size_t pos = QOI_HEADER_SIZE;
+		size_t chunksEnd = size - QOI_PADDING_SIZE;
+		uint32_t run = 0;
+		size_t stride = (size_t)info.width * 4;
+
+		for(uint32_t y = 0; y < info.height; ++y)
+		{
+			//QOI is stored top-down, we write bottom-up
+			uint8_t *dst = out + (size_t)(info.height - 1 - y) * stride;
+
+			for(uint32_t x = 0; x < info.width; ++x, dst += 4)
+			{
+				if(run > 0)
+				{
+					run--;
+				}
+				else
+				{
+					if(pos >= chunksEnd) return false;
+
+					uint8_t b1 = data[pos++];
+
+					if(b1 == 0xFE) //QOI_OP_RGB
+					{
+						if(pos + 3 > chunksEnd) return false;
+						px[0] = data[pos];
+						px[1] = data[pos + 1];
+						px[2] = data[pos + 2];
+						pos += 3;
+					}
+					else if(b1 == 0xFF) //QOI_OP_RGBA
+					{
+						if(pos + 4 > chunksEnd) return false;
+						memcpy(px, data + pos, 4);
+						pos += 4;
+					}
+					else if((b1 & 0xC0) == 0x00) //QOI_OP_INDEX
+					{
+						memcpy(px, index[b1], 4);
+					}
+					else if((b1 & 0xC0) == 0x40) //QOI_OP_DIFF
+					{
+						px[0] += ((b1 >> 4) & 0x03) - 2;
+						px[1] += ((b1 >> 2) & 0x03) - 2;
+						px[2] += (b1 & 0x03) - 2;
+					}
+					else if((b1 & 0xC0) == 0x80) //QOI_OP_LUMA
+					{
+						if(pos >= chunksEnd) return false;
+						uint8_t b2 = data[pos++];
+						int vg = (b1 & 0x3F) - 32;
+						px[0] += vg - 8 + ((b2 >> 4) & 0x0F);
+						px[1] += vg;
+						px[2] += vg - 8 + (b2 & 0x0F);
+					}
+					else //QOI_OP_RUN
+					{
+						run = (b1 & 0x3F);
+					}
+
+					memcpy(index[(px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) & 63], px, 4);
+				}
+
+				memcpy(dst, px, 4);
+			}
+		}
+
+		return true;
+	}
+
+	//---------------------------------------------------------------------------------------
+	// zlib inflate (RFC 1950/1951), just enough for PNG IDAT data
+	//---------------------------------------------------------------------------------------
+
+	const int ZFAST_BITS = 9;
+	const int ZFAST_MASK = (1 << ZFAST_BITS) - 1;
+	const size_t ZWINDOW = 32768; //how far back a match can reach
+	const size_t ZCHUNK = 131072; //output inflated between hand-offs to the sink, on top of the window
+
+	const uint16_t lengthBase[31] = { 3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,195,227,258,0,0 };
+	const uint8_t lengthExtra[31] = { 0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0,0,0 };
+	const uint16_t distBase[32] = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577,0,0 };
+	const uint8_t distExtra[32] = { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13,0,0 };
+	const uint8_t codeLengthOrder[19] = { 16,17,18,0,8,7,9,6,10,5,11,4,12,3,13,2,14,1,15 };
+
+	//canonical Huffman decoding table with a fast lookup for short codes
+	class ZHuffman
+	{
+	public:
+		uint16_t fast[1 << ZFAST_BITS]; //(code length << 9) | symbol, 0 if the code is longer than ZFAST_BITS
+		uint16_t firstCode[16];
+		int maxCode[17];
+		uint16_t firstSymbol[16];
+		uint8_t size[288];
+		uint16_t value[288];
+	};
+
+	int BitReverse16(int n)
+	{
+		n = ((n & 0xAAAA) >> 1) | ((n & 0x5555) << 1);
+		n = ((n & 0xCCCC) >> 2) | ((n & 0x3333) << 2);
+		n = ((n & 0xF0F0) >> 4) | ((n & 0x0F0F) << 4);
+		n = ((n & 0xFF00) >> 8) | ((n & 0x00FF) << 8);
+		return n;
+	}
+
+	int BitReverse(int v, int bits)
+	{
+		return BitReverse16(v) >> (16 - bits);
+	}
+
+	bool BuildHuffman(ZHuffman &z, const uint8_t *sizeList, int num)
+	{
+		int sizes[17];
+		int nextCode[16];
+		memset(sizes, 0, sizeof(sizes));
+		memset(z.fast, 0, sizeof(z.fast));
+
+		for(int i = 0; i < num; ++i) sizes[sizeList[i]]++;
+		sizes[0] = 0;
+		for(int i = 1; i < 16; ++i)
+			if(sizes[i] > (1 << i)) return false;
+
+		int code = 0;
+		int k = 0;
+		for(int i = 1; i < 16; ++i)
+		{
+			nextCode[i] = code;
+			z.firstCode[i] = (uint16_t)code;
+			z.firstSymbol[i] = (uint16_t)k;
+			code += sizes[i];
+			if(sizes[i] && code - 1 >= (1 << i)) return false; //over-subscribed
+			z.maxCode[i] = code << (16 - i); //pre-shifted for the slow path compare
+			code <<= 1;
+			k += sizes[i];
+		}
+		z.maxCode[16] = 0x10000;
+
+		for(int i = 0; i < num; ++i)
+		{
+			int s = sizeList[i];
+			if(s == 0) continue;
+
+			int c = nextCode[s] - z.firstCode[s] + z.firstSymbol[s];
+			z.size[c] = (uint8_t)s;
+			z.value[c] = (uint16_t)i;
+			if(s <= ZFAST_BITS)
+			{
+				uint16_t fastValue = (uint16_t)((s << 9) | i);
+				for(int j = BitReverse(nextCode[s], s); j < (1 << ZFAST_BITS); j += (1 << s))
+					z.fast[j] = fastValue;
+			}
+			nextCode[s]++;
+		}
+
+		return true;
+	}
+
+	//a piece of the compressed stream, such as one IDAT chunk
+	class InputSpan
+	{
+	public:
+		const uint8_t *data;
+		size_t size;
+	};
+
+	class PNGRows;
+
+	//inflates into a window that only holds the last ZWINDOW bytes plus what hasn't been handed on yet, so the whole
+	//output never has to be in memory at once; finished scanlines go to rows, which unfilters them into the image
+	class Inflater
+	{
+	public:
+		const uint8_t *in;
+		const uint8_t *inEnd;
+		const InputSpan *nextSpan, *spansEnd;
+		uint32_t codeBuffer;
+		int numBits;
+		int overrun; //bytes read past the end of the input, as zeros
+
+		uint8_t *out; //start of the window
+		uint8_t *outPos;
+		uint8_t *outEnd; //end of the window, or of the output if that comes first
+		uint8_t *pending; //first byte not yet taken by rows
+		size_t windowSize;
+		size_t total; //output expected
+		size_t flushed; //output slid off the front of the window
+		PNGRows *rows;
+
+		ZHuffman lengths, distances;
+
+		//moves on to the next span once this one is used up, false at the end of the input
+		bool NextSpan()
+		{
+			while(in == inEnd && nextSpan < spansEnd)
+			{
+				in = nextSpan->data;
+				inEnd = in + nextSpan->size;
+				nextSpan++;
+			}
+			return in < inEnd;
+		}
+
+		bool MakeRoom(size_t need);
+
+		void Fill()
+		{
+			while(numBits <= 24)
+			{
+				uint32_t byte = 0;
+				if(in < inEnd || NextSpan()) byte = *in++;
+				else overrun++;
+				codeBuffer |= byte << numBits;
+				numBits += 8;
+			}
+		}
+
+		uint32_t Bits(int n)
+		{
+			if(numBits < n) Fill();
+			uint32_t v = codeBuffer & ((1u << n) - 1);
+			codeBuffer >>= n;
+			numBits -= n;
+			return v;
+		}
+
+		int Decode(const ZHuffman &z)
+		{
+			if(numBits < 16) Fill();
+
+			int b = z.fast[codeBuffer & ZFAST_MASK];
+			if(b)
+			{
+				int s = b >> 9;
+				codeBuffer >>= s;
+				numBits -= s;
+				return b & 511;
+			}
+
+			//slow path, codes are stored MSB first so reverse the next 16 bits
+			int k = BitReverse16(codeBuffer & 0xFFFF);
+			int s;
+			for(s = ZFAST_BITS + 1; ; ++s)
+				if(k < z.maxCode[s]) break;
+			if(s >= 16) return -1;
+
+			b = (k >> (16 - s)) - z.firstCode[s] + z.firstSymbol[s];
+			if(b >= 288 || z.size[b] != s) return -1;
+			codeBuffer >>= s;
+			numBits -= s;
+			return z.value[b];
+		}
+
+		bool HuffmanBlock()
+		{
+			for(;;)
+			{
+				int symbol = Decode(lengths);
+				if(symbol < 0) return false;
+
+				if(symbol < 256)
+				{
+					if(outPos >= outEnd && !MakeRoom(1)) return false;
+					*outPos++ = (uint8_t)symbol;
+					continue;
+				}
+
+				if(symbol == 256) return overrun <= 4;
+
+				symbol -= 257;
+				if(symbol >= 29) return false;
+				int length = lengthBase[symbol];
+				if(lengthExtra[symbol]) length += Bits(lengthExtra[symbol]);
+
+				symbol = Decode(distances);
+				if(symbol < 0 || symbol >= 30) return false;
+				int dist = distBase[symbol];
+				if(distExtra[symbol]) dist += Bits(distExtra[symbol]);
+
+				if(outEnd - outPos < length && !MakeRoom(length)) return false;
+				//the window always keeps ZWINDOW bytes, so anything as far back as the output goes is still in it
+				if((size_t)(outPos - out) + flushed < (size_t)dist) return false;
+
+				const uint8_t *src = outPos - dist;
+				if(dist == 1)
+				{
+					//run of one byte, very common in flat image areas
+					memset(outPos, *src, length);
+					outPos += length;
+				}
+				else
+				{
+					//byte by byte, the source may overlap what we are writing
+					while(length--) *outPos++ = *src++;
+				}
+			}
+		}
+
+		bool DynamicTables()
+		{
+			int hlit = Bits(5) + 257;
+			int hdist = Bits(5) + 1;
+			int hclen = Bits(4) + 4;
+
+			uint8_t codeLengthSizes[19];
+			memset(codeLengthSizes, 0, sizeof(codeLengthSizes));
+			for(int i = 0; i < hclen; ++i) codeLengthSizes[codeLengthOrder[i]] = (uint8_t)Bits(3);
+
+			ZHuffman codeLengths;
+			if(!BuildHuffman(codeLengths, codeLengthSizes, 19)) return false;
+
+			uint8_t sizes[286 + 32];
+			int n = 0;
+			while(n < hlit + hdist)
+			{
+				int c = Decode(codeLengths);
+				if(c < 0 || c >= 19) return false;
+
+				if(c < 16)
+				{
+					sizes[n++] = (uint8_t)c;
+					continue;
+				}
+
+				uint8_t fill = 0;
+				int repeat;
+				if(c == 16)
+				{
+					if(n == 0) return false;
+					repeat = Bits(2) + 3;
+					fill = sizes[n - 1];
+				}
+				else if(c == 17) repeat = Bits(3) + 3;
+				else repeat = Bits(7) + 11;
+
+				if(hlit + hdist - n < repeat) return false;
+				memset(sizes + n, fill, repeat);
+				n += repeat;
+			}
+
+			if(!BuildHuffman(lengths, sizes, hlit)) return false;
+			if(!BuildHuffman(distances, sizes + hlit, hdist)) return false;
+			return true;
+		}
+
+		bool FixedTables()
+		{
+			uint8_t sizes[288];
+			memset(sizes, 8, 144);
+			memset(sizes + 144, 9, 112);
+			memset(sizes + 256, 7, 24);
+			memset(sizes + 280, 8, 8);
+			if(!BuildHuffman(lengths, sizes, 288)) return false;
+
+			memset(sizes, 5, 32);
+			return BuildHuffman(distances, sizes, 32);
+		}
+
+		bool StoredBlock()
+		{
+			//skip to the byte boundary, then the length comes from whatever is left in the bit buffer first
+			Bits(numBits & 7);
+
+			uint8_t header[4];
+			int k = 0;
+			while(numBits > 0 && k < 4)
+			{
+				header[k++] = (uint8_t)(codeBuffer & 0xFF);
+				codeBuffer >>= 8;
+				numBits -= 8;
+			}
+			while(k < 4)
+			{
+				if(in >= inEnd && !NextSpan()) return false;
+				header[k++] = *in++;
+			}
+
+			int len = header[0] | (header[1] << 8);
+			int nlen = header[2] | (header[3] << 8);
+			if(nlen != (len ^ 0xFFFF)) return false;
+
+			//drain any whole bytes still sitting in the bit buffer
+			while(numBits > 0 && len > 0)
+			{
+				if(outPos >= outEnd && !MakeRoom(1)) return false;
+				*outPos++ = (uint8_t)(codeBuffer & 0xFF);
+				codeBuffer >>= 8;
+				numBits -= 8;
+				len--;
+			}
+			if(numBits < 0) return false; //read zeros past the end of the input
+
+			//the stored bytes may run over several spans, and past the window
+			while(len > 0)
+			{
+				if(in >= inEnd && !NextSpan()) return false;
+				if(outPos >= outEnd && !MakeRoom(1)) return false;
+
+				size_t n = len;
+				if(n > (size_t)(inEnd - in)) n = inEnd - in;
+				if(n > (size_t)(outEnd - outPos)) n = outEnd - outPos;
+				memcpy(outPos, in, n);
+				in += n;
+				outPos += n;
+				len -= (int)n;
+			}
+			return true;
+		}
+
+		//window must hold ZWINDOW + ZCHUNK + a scanline, or total bytes if that is less
+		bool Inflate(const std::vector<InputSpan> &spans, uint8_t *window, size_t size, size_t expected, PNGRows *sink)
+		{
+			in = inEnd = NULL;
+			nextSpan = spans.empty() ? NULL : &spans[0];
+			spansEnd = nextSpan + spans.size();
+			codeBuffer = 0;
+			numBits = 0;
+			overrun = 0;
+			out = outPos = pending = window;
+			windowSize = size;
+			total = expected;
+			flushed = 0;
+			outEnd = out + (total < windowSize ? total : windowSize);
+			rows = sink;
+
+			//zlib header: deflate, no preset dictionary, valid check bits
+			int cmf = Bits(8);
+			int flg = Bits(8);
+			if(overrun || (cmf & 15) != 8 || (flg & 32) || ((cmf << 8) + flg) % 31 != 0) return false;
+
+			int lastBlock;
+			do
+			{
+				lastBlock = Bits(1);
+				int type = Bits(2);
+
+				bool ok;
+				if(type == 0) ok = StoredBlock();
+				else if(type == 1) ok = FixedTables() && HuffmanBlock();
+				else if(type == 2) ok = DynamicTables() && HuffmanBlock();
+				else ok = false;
+
+				if(!ok) return false;
+			} while(!lastBlock);
+
+			//we know exactly how much data to expect, we don't bother checking the adler32
+			if(flushed + (outPos - out) != total) return false;
+			return MakeRoom(0);
+		}
+	};
+
+	//---------------------------------------------------------------------------------------
+	// PNG, 8 bits per channel RGBA, non-interlaced only
+	//---------------------------------------------------------------------------------------
+
+	const uint8_t pngSignature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+
+	bool ProbePNG(const uint8_t *data, size_t size, B3D::ImageInfo &info)
+	{
+		//signature + IHDR chunk (length, type, 13 bytes of data, crc)
+		if(size < 8 + 8 + 13 + 4) return false;
+		if(memcmp(data, pngSignature, 8) != 0) return false;
+		if(ReadBE32(data + 8) != 13 || memcmp(data + 12, "IHDR", 4) != 0) return false;
+
+		const uint8_t *ihdr = data + 16;
+		uint32_t width = ReadBE32(ihdr);
+		uint32_t height = ReadBE32(ihdr + 4);
+		uint8_t bitDepth = ihdr[8];
+		uint8_t colorType = ihdr[9];
+		uint8_t compression = ihdr[10];
+		uint8_t filter = ihdr[11];
+		uint8_t interlace = ihdr[12];
+
+		if(bitDepth != 8 || colorType != 6 || compression != 0 || filter != 0 || interlace != 0) return false;
+		if(width == 0 || height == 0 || (uint64_t)width * height > 400000000ULL) return false;
+
+		info.format = B3D::ImageFormat::PNG;
+		info.width = width;
+		info.height = height;
+		return true;
+	}
+
+	uint8_t Paeth(int a, int b, int c)
+	{
+		int p = a + b - c;
+		int pa = p > a ? p - a : a - p;
+		int pb = p > b ? p - b : b - p;
+		int pc = p > c ? p - c : c - p;
+		if(pa <= pb && pa <= pc) return (uint8_t)a;
+		if(pb <= pc) return (uint8_t)b;
+		return (uint8_t)c;
+	}
+
+#ifdef B3D_IMAGE_SSE2
+	inline __m128i Load32(const uint8_t *p)
+	{
+		int v;
+		memcpy(&v, p, 4);
+		return _mm_cvtsi32_si128(v);
+	}
+
+	inline void Store32(uint8_t *p, __m128i v)
+	{
+		int x = _mm_cvtsi128_si32(v);
+		memcpy(p, &x, 4);
+	}
+#endif
+
+	//4 bytes per pixel unfiltering, prior is the previous (already unfiltered) row
+	void UnfilterSub(const uint8_t *src, uint8_t *dst, size_t stride)
+	{
+		size_t i = 0;
+#ifdef B3D_IMAGE_SSE2
+		//prefix sum over 4 pixels at a time
+		__m128i carry = _mm_setzero_si128();
+		for(; i + 16 <= stride; i += 16)
+		{
+			__m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+			x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+			x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+			x = _mm_add_epi8(x, carry);
+			_mm_storeu_si128((__m128i *)(dst + i), x);
+			carry = _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 3, 3));
+		}
+#endif
+		for(; i < stride; ++i) dst[i] = (uint8_t)(src[i] + (i >= 4 ? dst[i - 4] : 0));
+	}
+
+	void UnfilterUp(const uint8_t *src, const uint8_t *prior, uint8_t *dst, size_t stride)
+	{
+		size_t i = 0;
+#ifdef B3D_IMAGE_SSE2
+		for(; i + 16 <= stride; i += 16)
+		{
+			__m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+			__m128i b = _mm_loadu_si128((const __m128i *)(prior + i));
+			_mm_storeu_si128((__m128i *)(dst + i), _mm_add_epi8(x, b));
+		}
+#endif
+		for(; i < stride; ++i) dst[i] = (uint8_t)(src[i] + prior[i]);
+	}
+
+	void UnfilterAverage(const uint8_t *src, const uint8_t *prior, uint8_t *dst, size_t stride)
+	{
+#ifdef B3D_IMAGE_SSE2
+		//one pixel per step, each depends on the one to its left
+		__m128i a = _mm_setzero_si128();
+		const __m128i one = _mm_set1_epi8(1);
+		for(size_t i = 0; i < stride; i += 4)
+		{
+			__m128i b = Load32(prior + i);
+			__m128i x = Load32(src + i);
+			//_mm_avg_epu8 rounds up, take off the carried low bit to get floor((a + b) / 2)
+			__m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+			a = _mm_add_epi8(x, avg);
+			Store32(dst + i, a);
+		}
+#else
+		for(size_t i = 0; i < stride; ++i)
+		{
+			int a = i >= 4 ? dst[i - 4] : 0;
+			dst[i] = (uint8_t)(src[i] + ((a + prior[i]) >> 1));
+		}
+#endif
+	}
+
+	void UnfilterPaeth(const uint8_t *src, const uint8_t *prior, uint8_t *dst, size_t stride)
+	{
+#ifdef B3D_IMAGE_SSE2
+		//one pixel per step, widened to 16 bits so the predictor maths can't overflow
+		const __m128i zero = _mm_setzero_si128();
+		__m128i a = zero; //left
+		__m128i c = zero; //upper left
+		for(size_t i = 0; i < stride; i += 4)
+		{
+			__m128i b = _mm_unpacklo_epi8(Load32(prior + i), zero); //up
+			__m128i x = _mm_unpacklo_epi8(Load32(src + i), zero);
+
+			__m128i pa = _mm_sub_epi16(b, c); //p - a
+			__m128i pb = _mm_sub_epi16(a, c); //p - b
+			__m128i pc = _mm_add_epi16(pa, pb); //p - c
+			pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+			pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+			pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+
+			__m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+			__m128i useA = _mm_cmpeq_epi16(smallest, pa);
+			__m128i useB = _mm_cmpeq_epi16(smallest, pb);
+			__m128i predicted = _mm_or_si128(_mm_and_si128(useB, b), _mm_andnot_si128(useB, c));
+			predicted = _mm_or_si128(_mm_and_si128(useA, a), _mm_andnot_si128(useA, predicted));
+
+			//add in 8 bits so it wraps, then widen again for the next pixel
+			__m128i result = _mm_add_epi8(_mm_packus_epi16(x, x), _mm_packus_epi16(predicted, predicted));
+			Store32(dst + i, result);
+
+			a = _mm_unpacklo_epi8(result, zero);
+			c = b;
+		}
+#else
+		for(size_t i = 0; i < stride; ++i)
+		{
+			int a = i >= 4 ? dst[i - 4] : 0;
+			int c = i >= 4 ? prior[i - 4] : 0;
+			dst[i] = (uint8_t)(src[i] + Paeth(a, prior[i], c));
+		}
+#endif
+	}
+
+	//unfilters scanlines straight from the inflater's window into the image, bottom-up
+	class PNGRows
+	{
+	public:
+		uint8_t *image;
+		size_t stride; //of the image; a scanline is a filter type byte and then this many bytes
+		uint32_t height;
+		uint32_t y; //next scanline, counted from the top
+		const uint8_t *prior; //the previous scanline, unfiltered; all zeros for the first
+		std::vector<uint8_t> zeroRow;
+
+		PNGRows(uint8_t *out, const B3D::ImageInfo &info) : image(out), stride((size_t)info.width * 4), height(info.height), y(0),
+			zeroRow(stride, 0)
+		{
+			prior = &zeroRow[0];
+		}
+
+		//takes every whole scanline from data, moving it past them; false on a bad filter type
+		bool Rows(const uint8_t *&data, const uint8_t *end)
+		{
+			while((size_t)(end - data) >= stride + 1 && y < height)
+			{
+				const uint8_t *src = data + 1;
+				uint8_t *dst = image + (size_t)(height - 1 - y) * stride;
+
+				switch(data[0])
+				{
+				case 0: memcpy(dst, src, stride); break;
+				case 1: UnfilterSub(src, dst, stride); break;
+				case 2: UnfilterUp(src, prior, dst, stride); break;
+				case 3: UnfilterAverage(src, prior, dst, stride); break;
+				case 4: UnfilterPaeth(src, prior, dst, stride); break;
+				default: return false;
+				}
+
+				prior = dst;
+				data += stride + 1;
+				y++;
+			}
+			return true;
+		}
+	};
+
+	//hands the finished scanlines on and slides the window down, keeping the last ZWINDOW bytes; false if there
+	//isn't room for need more bytes, because the output is all there or a scanline was bad
+	bool Inflater::MakeRoom(size_t need)
+	{
+		const uint8_t *taken = pending;
+		if(!rows->Rows(taken, outPos)) return false;
+		pending += taken - pending;
+
+		uint8_t *keep = (size_t)(outPos - out) > ZWINDOW ? outPos - ZWINDOW : out;
+		if(pending < keep) keep = pending;
+		size_t shift = keep - out;
+		if(shift)
+		{
+			memmove(out, keep, outPos - keep);
+			outPos -= shift;
+			pending -= shift;
+			flushed += shift;
+			outEnd = out + (total - flushed < windowSize ? total - flushed : windowSize);
+		}
+
+		return (size_t)(outEnd - outPos) >= need;
+	}
+
+	bool DecodePNG(const uint8_t *data, size_t size, const B3D::ImageInfo &info, uint8_t *out)
+	{
+		//find the IDAT chunks, they are usually split but must be consecutive; they are inflated where they are
+		std::vector<InputSpan> idats;
+
+		size_t pos = 8;
+		for(;;)
+		{
+			if(size - pos < 12) return false; //ran out without an IEND
+			uint32_t length = ReadBE32(data + pos);
+			const uint8_t *type = data + pos + 4;
+			if(length > size - pos - 12) return false;
+			const uint8_t *chunk = data + pos + 8;
+
+			if(memcmp(type, "IDAT", 4) == 0)
+			{
+				InputSpan span = { chunk, length };
+				idats.push_back(span);
+			}
+			else if(memcmp(type, "IEND", 4) == 0) break;
+			else if(memcmp(type, "PLTE", 4) == 0 || memcmp(type, "tRNS", 4) == 0) return false; //not for RGBA
+
+			pos += 12 + length;
+		}
+
+		if(idats.empty()) return false;
+
+		//the scanlines are unfiltered as they are inflated, so only a window of the filtered data is ever held
+		PNGRows rows(out, info);
+		size_t total = (rows.stride + 1) * info.height;
+		size_t windowSize = ZWINDOW + ZCHUNK + rows.stride + 1;
+		if(windowSize > total) windowSize = total;
+		std::vector<uint8_t> window(windowSize);
+
+		Inflater *inflater = new Inflater(); //the Huffman tables are a bit big for the stack
+		bool ok = inflater->Inflate(idats, &window[0], windowSize, total, &rows);
+		delete inflater;
+		return ok;
+	}
+}
+
+namespace B3D
+{
+	bool ProbeImage(const uint8_t *data, size_t size, ImageInfo &info)
+	{
+		info = ImageInfo();
+		if(data == NULL) return false;
+		return ProbeQOI(data, size, info) || ProbePNG(data, size, info);
+	}
+
+	bool DecodeImage(const uint8_t *data, size_t size, const ImageInfo &info, uint8_t *out)
+	{
+		switch(info.format)
+		{
+		case ImageFormat::QOI: return DecodeQOI(data, size, info, out);
+		case ImageFormat::PNG: return DecodePNG(data, size, info, out);
+		default: return false;
+		}
+	}
+}
@@ -0,0 +1,269 @@
+#include "Blit3D/JobSystem.h"
+#include "Blit3D/Logger.h"
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+extern logger oLog;
+
+JobSystem::JobSystem(int workerCount) : queued(0), nextWorker(0), quit(false)
+{
+	if(workerCount <= 0)
+	{
+		//hardware_concurrency() may not know, and answers 0
+		workerCount = (int)std::thread::hardware_concurrency() - 1;
+		if(workerCount < 1) workerCount = 1;
+	}
+
+	statsStart = glfwGetTime();
+
+	for(int i = 0; i < workerCount; ++i) workers.push_back(new Worker());
+
+	//no job can be queued until we return, so the workers see every id before they need one
+	for(int i = 0; i < workerCount; ++i)
+	{
+		workers[i]->thread = std::thread(&JobSystem::WorkerLoop, this, i);
+		workers[i]->id = workers[i]->thread.get_id();
+	}
+
+	oLog(Level::Info) << "JobSystem started " << workerCount << " workers";
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		quit = true;
+	}
+	sleepCondition.notify_all();
+
+	for(size_t i = 0; i < workers.size(); ++i)
+	{
+		workers[i]->thread.join();
+		delete workers[i];
+	}
+}
+
+int JobSystem::WorkerIndex(void)
+{
+	std::thread::id self = std::this_thread::get_id();
+	for(size_t i = 0; i < workers.size(); ++i)
+	{
+		if(workers[i]->id == self) return (int)i;
+	}
+	return -1;
+}
+
+void JobSystem::Push(const JobHandle &job)
+{
+	int index = WorkerIndex();
+	if(index < 0) index = (int)(nextWorker++ % workers.size());
+
+	{
+		std::lock_guard<std::mutex> lock(workers[index]->dequeMutex);
+		workers[index]->jobs.push_back(job);
+	}
+
+	//taking sleepMutex means a worker can't miss the wakeup between checking queued and going to sleep
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		queued++;
+	}
+	sleepCondition.notify_one();
+}
+
+bool JobSystem::Take(int index, JobHandle &job, bool &stolen)
+{
+	if(queued == 0) return false;
+
+	if(index >= 0)
+	{
+		Worker *own = workers[index];
+		std::lock_guard<std::mutex> lock(own->dequeMutex);
+		if(!own->jobs.empty())
+		{
+			job = own->jobs.back();
+			own->jobs.pop_back();
+			queued--;
+			stolen = false;
+			return true;
+		}
+	}
+
+	//steal the oldest job, which tends to be the biggest piece of work left, from the next worker that has one
+	size_t count = workers.size();
+	size_t start = index >= 0 ? (size_t)index + 1 : 0;
+	for(size_t i = 0; i < count; ++i)
+	{
+		Worker *victim = workers[(start + i) % count];
+		if(victim == (index >= 0 ? workers[index] : NULL)) continue;
+
+		std::lock_guard<std::mutex> lock(victim->dequeMutex);
+		if(!victim->jobs.empty())
+		{
+			job = victim->jobs.front();
+			victim->jobs.pop_front();
+			queued--;
+			stolen = true;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void JobSystem::Execute(const JobHandle &job)
+{
+	job->work();
+	job->work = nullptr; //let go of whatever it captured
+
+	std::vector<JobHandle> released;
+	{
+		std::lock_guard<std::mutex> lock(job->dependentsMutex);
+		job->finished = true;
+		released.swap(job->dependents);
+	}
+
+	for(size_t i = 0; i < released.size(); ++i) Release(released[i]);
+}
+
+void JobSystem::Release(const JobHandle &job)
+{
+	if(--job->waitingOn == 0) Push(job);
+}
+
+void JobSystem::WorkerLoop(int index)
+{
+	Worker *self = workers[index];
+
+	for(;;)
+	{
+		JobHandle job;
+		bool stolen = false;
+		if(Take(index, job, stolen))
+		{
+			double start = glfwGetTime();
+			Execute(job);
+			self->busyMicroseconds += (uint64_t)((glfwGetTime() - start) * 1000000.0);
+			self->jobsRun++;
+			if(stolen) self->jobsStolen++;
+			continue;
+		}
+
+		//nothing to do: sleep until a job is queued, or we're told to stop once the deques are empty
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		if(quit && queued == 0) return;
+		sleepCondition.wait(lock, [this]() { return quit || queued > 0; });
+	}
+}
+
+JobHandle JobSystem::Create(std::function<void(void)> work)
+{
+	return std::make_shared<Job>(work);
+}
+
+void JobSystem::DependsOn(const JobHandle &job, const JobHandle &before)
+{
+	std::lock_guard<std::mutex> lock(before->dependentsMutex);
+	if(before->finished) return; //nothing to wait for
+
+	job->waitingOn++;
+	before->dependents.push_back(job);
+}
+
+void JobSystem::Submit(const JobHandle &job)
+{
+	//drop the hold Create() put on it
+	Release(job);
+}
+
+JobHandle JobSystem::Run(std::function<void(void)> work)
+{
+	JobHandle job = Create(work);
+	Submit(job);
+	return job;
+}
+
+JobHandle JobSystem::Run(std::function<void(void)> work, const std::vector<JobHandle> &dependencies)
+{
+	JobHandle job = Create(work);
+	for(size_t i = 0; i < dependencies.size(); ++i) DependsOn(job, dependencies[i]);
+	Submit(job);
+	return job;
+}
+
+void JobSystem::Wait(const JobHandle &job)
+{
+	int index = WorkerIndex();
+
+	while(!job->finished)
+	{
+		//help out rather than block, so waiting inside a job can't starve the pool
+		JobHandle other;
+		bool stolen = false;
+		if(Take(index, other, stolen)) Execute(other);
+		else std::this_thread::yield();
+	}
+}
+
+void JobSystem::Wait(const std::vector<JobHandle> &jobs)
+{
+	for(size_t i = 0; i < jobs.size(); ++i) Wait(jobs[i]);
+}
+
+void JobSystem::ParallelFor(size_t count, std::function<void(size_t, size_t)> body, size_t grain)
+{
+	if(count == 0) return;
+
+	if(grain == 0)
+	{
+		//a few ranges per thread, so a thread that finishes early can steal from one that doesn't
+		size_t ranges = (workers.size() + 1) * 4;
+		grain = (count + ranges - 1) / ranges;
+	}
+
+	if(count <= grain)
+	{
+		body(0, count);
+		return;
+	}
+
+	std::vector<JobHandle> jobs;
+	jobs.reserve((count + grain - 1) / grain);
+	for(size_t begin = grain; begin < count; begin += grain)
+	{
+		size_t end = begin + grain < count ? begin + grain : count;
+		jobs.push_back(Run([=]() { body(begin, end); }));
+	}
+
+	//the first range is ours
+	body(0, grain);
+	Wait(jobs);
+}
+
+void JobSystem::GetStats(std::vector<JobWorkerStats> &stats)
+{
+	double elapsed = glfwGetTime() - statsStart;
+
+	stats.resize(workers.size());
+	for(size_t i = 0; i < workers.size(); ++i)
+	{
+		stats[i].jobsRun = workers[i]->jobsRun;
+		stats[i].jobsStolen = workers[i]->jobsStolen;
+		stats[i].busySeconds = workers[i]->busyMicroseconds / 1000000.0;
+		stats[i].utilization = elapsed > 0 ? stats[i].busySeconds / elapsed : 0;
+		if(stats[i].utilization > 1) stats[i].utilization = 1;
+	}
+}
+
+void JobSystem::ResetStats(void)
+{
+	for(size_t i = 0; i < workers.size(); ++i)
+	{
+		workers[i]->jobsRun = 0;
+		workers[i]->jobsStolen = 0;
+		workers[i]->busyMicroseconds = 0;
+	}
+	statsStart = glfwGetTime();
+}
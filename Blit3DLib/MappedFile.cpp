@@ -0,0 +1,120 @@
+#include "Blit3D/MappedFile.h"
+#include "Blit3D/Logger.h"
+
+#ifdef _WIN32
+	#define WIN32_EXTRA_LEAN
+	#include <Windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+extern logger oLog;
+
+namespace B3D
+{
+	MappedFile::MappedFile() : data(NULL), size(0)
+	{
+#ifdef _WIN32
+		fileHandle = mappingHandle = NULL;
+#endif
+	}
+
+	MappedFile::~MappedFile()
+	{
+		Close();
+	}
+
+#ifdef _WIN32
+	bool MappedFile::Open(const std::string &filename)
+	{
+		Close();
+
+		HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if(file == INVALID_HANDLE_VALUE)
+		{
+			oLog(Level::Severe) << "Couldn't open " << filename << " to map it";
+			return false;
+		}
+
+		LARGE_INTEGER fileSize;
+		if(!GetFileSizeEx(file, &fileSize) || (uint64_t)fileSize.QuadPart > (uint64_t)SIZE_MAX)
+		{
+			oLog(Level::Severe) << "Couldn't get the size of " << filename;
+			CloseHandle(file);
+			return false;
+		}
+
+		fileHandle = file;
+		size = (size_t)fileSize.QuadPart;
+		if(size == 0) return true; //can't map nothing
+
+		mappingHandle = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if(mappingHandle != NULL) data = (const uint8_t *)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+		if(data == NULL)
+		{
+			oLog(Level::Severe) << "Couldn't map " << filename << ", error " << (int)GetLastError();
+			Close();
+			return false;
+		}
+
+		return true;
+	}
+
+	void MappedFile::Close(void)
+	{
+		if(data) UnmapViewOfFile(data);
+		if(mappingHandle) CloseHandle(mappingHandle);
+		if(fileHandle) CloseHandle(fileHandle);
+		data = NULL;
+		size = 0;
+		fileHandle = mappingHandle = NULL;
+	}
+#else
+	bool MappedFile::Open(const std::string &filename)
+	{
+		Close();
+
+		int fd = open(filename.c_str(), O_RDONLY);
+		if(fd < 0)
+		{
+			oLog(Level::Severe) << "Couldn't open " << filename << " to map it";
+			return false;
+		}
+
+		struct stat info;
+		if(fstat(fd, &info) != 0)
+		{
+			oLog(Level::Severe) << "Couldn't get the size of " << filename;
+			close(fd);
+			return false;
+		}
+
+		size = (size_t)info.st_size;
+		if(size > 0)
+		{
+			void *view = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if(view == MAP_FAILED)
+			{
+				oLog(Level::Severe) << "Couldn't map " << filename;
+				size = 0;
+				close(fd);
+				return false;
+			}
+			data = (const uint8_t *)view;
+		}
+
+		close(fd); //the mapping keeps the file alive
+		return true;
+	}
+
+	void MappedFile::Close(void)
+	{
+		if(data) munmap((void *)data, size);
+		data = NULL;
+		size = 0;
+	}
+#endif
+}
@@ -0,0 +1,189 @@
+#include "Blit3D/PixelHash.h"
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+	#define B3D_HASH_SSE41
+	#include <smmintrin.h>
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+		#define B3D_TARGET_SSE41
+	#else
+		#include <cpuid.h>
+		#define B3D_TARGET_SSE41 __attribute__((target("sse4.1")))
+	#endif
+#endif
+
+namespace
+{
+	const uint32_t PRIME1 = 2654435761U;
+	const uint32_t PRIME2 = 2246822519U;
+	const uint32_t PRIME3 = 3266489917U;
+	const uint32_t PRIME4 = 668265263U;
+	const uint32_t PRIME5 = 374761393U;
+
+	//the second stream's seed, anything that isn't 0 will do
+	const uint32_t SECOND_SEED = 0x9E3779B9U;
+
+	inline uint32_t Rotl(uint32_t x, int r)
+	{
+		return (x << r) | (x >> (32 - r));
+	}
+
+	inline uint32_t Read32(const uint8_t *p)
+	{
+		uint32_t v;
+		memcpy(&v, p, 4);
+		return v;
+	}
+
+	inline uint32_t Round(uint32_t acc, uint32_t input)
+	{
+		acc += input * PRIME2;
+		acc = Rotl(acc, 13);
+		return acc * PRIME1;
+	}
+
+	//everything after the 16 byte stripes: the leftover bytes and the final avalanche
+	uint32_t Finish(uint32_t h, const uint8_t *p, size_t remaining, size_t size)
+	{
+		h += (uint32_t)size;
+
+		while(remaining >= 4)
+		{
+			h += Read32(p) * PRIME3;
+			h = Rotl(h, 17) * PRIME4;
+			p += 4;
+			remaining -= 4;
+		}
+
+		while(remaining > 0)
+		{
+			h += (*p) * PRIME5;
+			h = Rotl(h, 11) * PRIME1;
+			p++;
+			remaining--;
+		}
+
+		h ^= h >> 15;
+		h *= PRIME2;
+		h ^= h >> 13;
+		h *= PRIME3;
+		h ^= h >> 16;
+		return h;
+	}
+
+	uint32_t Merge(const uint32_t v[4])
+	{
+		return Rotl(v[0], 1) + Rotl(v[1], 7) + Rotl(v[2], 12) + Rotl(v[3], 18);
+	}
+
+	void InitLanes(uint32_t v[4], uint32_t seed)
+	{
+		v[0] = seed + PRIME1 + PRIME2;
+		v[1] = seed + PRIME2;
+		v[2] = seed;
+		v[3] = seed - PRIME1;
+	}
+
+	//both streams over the 16 byte stripes, returns how many bytes were consumed
+	size_t StripesScalar(const uint8_t *p, size_t size, uint32_t a[4], uint32_t b[4])
+	{
+		size_t done = 0;
+		for(; done + 16 <= size; done += 16)
+		{
+			for(int lane = 0; lane < 4; ++lane)
+			{
+				uint32_t input = Read32(p + done + lane * 4);
+				a[lane] = Round(a[lane], input);
+				b[lane] = Round(b[lane], input);
+			}
+		}
+		return done;
+	}
+
+#ifdef B3D_HASH_SSE41
+	bool DetectSSE41(void)
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 1);
+		return (info[2] & (1 << 19)) != 0;
+#else
+		unsigned int eax, ebx, ecx, edx;
+		if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return false;
+		return (ecx & bit_SSE4_1) != 0;
+#endif
+	}
+
+	//checked once at startup
+	const bool hasSSE41 = DetectSSE41();
+
+	B3D_TARGET_SSE41 inline __m128i RoundSSE(__m128i acc, __m128i input, __m128i prime1, __m128i prime2)
+	{
+		acc = _mm_add_epi32(acc, _mm_mullo_epi32(input, prime2));
+		acc = _mm_or_si128(_mm_slli_epi32(acc, 13), _mm_srli_epi32(acc, 19));
+		return _mm_mullo_epi32(acc, prime1);
+	}
+
+	//the four xxHash lanes map straight onto one SSE register, per stream
+	B3D_TARGET_SSE41 size_t StripesSSE41(const uint8_t *p, size_t size, uint32_t a[4], uint32_t b[4])
+	{
+		const __m128i prime1 = _mm_set1_epi32((int)PRIME1);
+		const __m128i prime2 = _mm_set1_epi32((int)PRIME2);
+		__m128i accA = _mm_loadu_si128((const __m128i *)a);
+		__m128i accB = _mm_loadu_si128((const __m128i *)b);
+
+		size_t done = 0;
+		for(; done + 16 <= size; done += 16)
+		{
+			__m128i input = _mm_loadu_si128((const __m128i *)(p + done));
+			accA = RoundSSE(accA, input, prime1, prime2);
+			accB = RoundSSE(accB, input, prime1, prime2);
+		}
+
+		_mm_storeu_si128((__m128i *)a, accA);
+		_mm_storeu_si128((__m128i *)b, accB);
+		return done;
+	}
+#endif
+}
+
+namespace B3D
+{
+	uint64_t HashPixels(const void *data, size_t size)
+	{
+		const uint8_t *p = (const uint8_t *)data;
+		uint32_t a[4], b[4];
+		InitLanes(a, 0);
+		InitLanes(b, SECOND_SEED);
+
+		size_t done = 0;
+		if(size >= 16)
+		{
+#ifdef B3D_HASH_SSE41
+			if(hasSSE41) done = StripesSSE41(p, size, a, b);
+			else
+#endif
+			done = StripesScalar(p, size, a, b);
+		}
+
+		uint32_t h1 = done ? Merge(a) : PRIME5;
+		uint32_t h2 = done ? Merge(b) : SECOND_SEED + PRIME5;
+		h1 = Finish(h1, p + done, size - done, size);
+		h2 = Finish(h2, p + done, size - done, size);
+
+		return ((uint64_t)h2 << 32) | h1;
+	}
+
+	uint32_t XXHash32(const void *data, size_t size, uint32_t seed)
+	{
+		const uint8_t *p = (const uint8_t *)data;
+		uint32_t v[4], unused[4];
+		InitLanes(v, seed);
+		InitLanes(unused, seed);
+
+		size_t done = StripesScalar(p, size, v, unused);
+		uint32_t h = done ? Merge(v) : seed + PRIME5;
+		return Finish(h, p + done, size - done, size);
+	}
+}
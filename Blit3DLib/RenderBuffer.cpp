@@ -25,7 +25,7 @@ RenderBuffer::RenderBuffer(int width, int height, TextureManager *TexManager, st
 		GL_TEXTURE_2D, color_tex, 0);
 
 	//ad the texture to the TM
-	texManager->AddLoadedTexture(name, color_tex);
+	texHandle = texManager->AddLoadedTexture(name, color_tex, width, height);
 
 	// create a render buffer as our depth buffer and attach it
 	glBindRenderbuffer(GL_RENDERBUFFER, depth_rb);
@@ -46,12 +46,21 @@ RenderBuffer::RenderBuffer(int width, int height, TextureManager *TexManager, st
 
 RenderBuffer::~RenderBuffer()
 {
-	glDeleteFramebuffers(1, &fb);
-	glDeleteRenderbuffers(1, &depth_rb);
+	if(b3d->glWork)
+	{
+		//batched with the rest of the frame's deletes
+		b3d->glWork->DeleteFramebuffer(fb);
+		b3d->glWork->DeleteRenderbuffer(depth_rb);
+	}
+	else
+	{
+		glDeleteFramebuffers(1, &fb);
+		glDeleteRenderbuffers(1, &depth_rb);
+	}
 	//the next line will bomb if the TM has already been freed,
 	//so be sure to delete all RenderBuffers *before* deleting
 	//the TM, just like Sprites
-	texManager->FreeTexture(texname);
+	texManager->FreeTexture(texHandle);
 }
 
 void RenderBuffer::RenderToMe(GLSLProgram *shader)
@@ -4,6 +4,11 @@
 
 logger sLog("ShaderManager.log", false);
 
+ShaderManager::ShaderManager(GLWorkQueue *workQueue)
+{
+	glWork = workQueue;
+}
+
 ShaderManager::~ShaderManager()
 {
 	for (auto item : ShaderMap)
@@ -12,24 +17,46 @@ ShaderManager::~ShaderManager()
 	}
 }
 
-GLSLProgram* ShaderManager::Load(const char* vertName, const char*fragName)
+bool ShaderManager::OnGLThread(void)
 {
-	GLSLProgram* prog = new GLSLProgram();
-	
-	if (!prog->compileShaderFromFile(vertName, GLSLShader::VERTEX))
+	return glWork == NULL || glWork->OnGLThread();
+}
+
+void ShaderManager::AddEmbeddedShader(const B3D::EmbeddedShader &shader)
+{
+	std::lock_guard<std::mutex> lock(embeddedMutex);
+	embeddedShaders[shader.name] = shader.source;
+}
+
+bool ShaderManager::CompileStage(GLSLProgram* prog, const char* name, GLSLShader::GLSLShaderType type)
+{
+	const char *source = NULL;
+	{
+		std::lock_guard<std::mutex> lock(embeddedMutex);
+		std::unordered_map<std::string, const char *>::iterator itor = embeddedShaders.find(name);
+		if(itor != embeddedShaders.end()) source = itor->second;
+	}
+
+	if(source != NULL) return prog->compileShaderFromString(source, type);
+	return prog->compileShaderFromFile(name, type);
+}
+
+bool ShaderManager::Load(GLSLProgram* prog, const char* vertName, const char*fragName)
+{
+	if (!CompileStage(prog, vertName, GLSLShader::VERTEX))
 	{
 		printf("Vertex shader failed to compile!\n%s", prog->log().c_str());
 		sLog(Level::Severe) << "Vertex shader <" << vertName << "> failed to compile." << prog->log();
 		assert(false && "Vertex shader failed to compile");
-		return NULL;
+		return false;
 	}
 
-	if (!prog->compileShaderFromFile(fragName, GLSLShader::FRAGMENT))
+	if (!CompileStage(prog, fragName, GLSLShader::FRAGMENT))
 	{
 		printf("Fragment shader failed to compile!\n%s", prog->log().c_str());
 		sLog(Level::Severe) << "Fragment shader <" << fragName << "> failed to compile." << prog->log();
 		assert(false && "Fragment shader failed to compile");
-		return NULL;
+		return false;
 	}
 
 	if (!prog->link())
@@ -37,23 +64,20 @@ GLSLProgram* ShaderManager::Load(const char* vertName, const char*fragName)
 		printf("Shader program failed to link!\n%s", prog->log().c_str());
 		sLog(Level::Severe) << "Shader program failed to link." << prog->log();
 		assert(false && "Shader program failed to link.");
-		return NULL;
+		return false;
 	}
 
-	assert(prog != NULL);
-	return prog;
+	return true;
 }
 
-GLSLProgram* ShaderManager::LoadFromStrings(const char* vertName, const char*fragName, std::string vertString, std::string fragString)
+bool ShaderManager::LoadFromStrings(GLSLProgram* prog, const char* vertName, const char*fragName, const std::string &vertString, const std::string &fragString)
 {
-	GLSLProgram* prog = new GLSLProgram();
-
 	if(!prog->compileShaderFromString(vertString, GLSLShader::VERTEX))
 	{
 		printf("Vertex shader failed to compile from string!\n%s", prog->log().c_str());
 		sLog(Level::Severe) << "Vertex shader <" << vertName << "> failed to compile from string." << prog->log();
 		assert(false && "Vertex shader failed to compile from string");
-		return NULL;
+		return false;
 	}
 
 	if(!prog->compileShaderFromString(fragString, GLSLShader::FRAGMENT))
@@ -61,7 +85,7 @@ GLSLProgram* ShaderManager::LoadFromStrings(const char* vertName, const char*fra
 		printf("Fragment shader failed to compile from string!\n%s", prog->log().c_str());
 		sLog(Level::Severe) << "Fragment shader <" << fragName << "> failed to compile from string." << prog->log();
 		assert(false && "Fragment shader failed to compile from string");
-		return NULL;
+		return false;
 	}
 
 	if(!prog->link())
@@ -69,11 +93,10 @@ GLSLProgram* ShaderManager::LoadFromStrings(const char* vertName, const char*fra
 		printf("Shader program failed to link!\n%s", prog->log().c_str());
 		sLog(Level::Severe) << "Shader program failed to link." << prog->log();
 		assert(false && "Shader program failed to link.");
-		return NULL;
+		return false;
 	}
 
-	assert(prog != NULL);
-	return prog;
+	return true;
 }
 
 GLSLProgram* ShaderManager::GetShader(const char* vertName, const char* fragName)
@@ -81,25 +104,38 @@ GLSLProgram* ShaderManager::GetShader(const char* vertName, const char* fragName
 	std::string key = vertName;
 	key += fragName;
 
+	std::lock_guard<std::mutex> lock(shaderMutex);
 
-	shaderIter = ShaderMap.find(key);
+	std::map<std::string, GLSLProgram*>::iterator shaderIter = ShaderMap.find(key);
 	if (shaderIter != ShaderMap.end())
 	{
 		return (shaderIter->second);
 	}
-	else
+
+	GLSLProgram* prog = new GLSLProgram();
+
+	if(!OnGLThread())
 	{
-		GLSLProgram* prog = Load(vertName, fragName);
-		if (prog != NULL)
+		//hand out the program now, it becomes usable once the GL thread has linked it
+		ShaderMap[key] = prog;
+		std::string vert = vertName;
+		std::string frag = fragName;
+		glWork->Submit([=]()
 		{
-			// successful loaded and linked shader program, added to map and return the result
-			ShaderMap[key] = prog;
-			return prog;
-		}
-		assert(prog != NULL);
+			Load(prog, vert.c_str(), frag.c_str());
+		});
+		return prog;
+	}
+
+	if (Load(prog, vertName, fragName))
+	{
+		// successful loaded and linked shader program, added to map and return the result
+		ShaderMap[key] = prog;
+		return prog;
 	}
 
 	// ERROR
+	delete prog;
 	return NULL;
 }
 
@@ -108,33 +144,51 @@ GLSLProgram* ShaderManager::GetShader(const char* vertName, const char* fragName
 	std::string key = vertName;
 	key += fragName;
 
+	std::lock_guard<std::mutex> lock(shaderMutex);
 
-	shaderIter = ShaderMap.find(key);
+	std::map<std::string, GLSLProgram*>::iterator shaderIter = ShaderMap.find(key);
 	if(shaderIter != ShaderMap.end())
 	{
 		return (shaderIter->second);
 	}
-	else
+
+	GLSLProgram* prog = new GLSLProgram();
+
+	if(!OnGLThread())
 	{
-		GLSLProgram* prog = LoadFromStrings(vertName, fragName, vertString, fragString);
-		if(prog != NULL)
+		//hand out the program now, it becomes usable once the GL thread has linked it
+		ShaderMap[key] = prog;
+		std::string vert = vertName;
+		std::string frag = fragName;
+		glWork->Submit([=]()
 		{
-			// successful loaded and linked shader program, added to map and return the result
-			ShaderMap[key] = prog;
-			return prog;
-		}
-		assert(prog != NULL);
+			LoadFromStrings(prog, vert.c_str(), frag.c_str(), vertString, fragString);
+		});
+		return prog;
+	}
+
+	if(LoadFromStrings(prog, vertName, fragName, vertString, fragString))
+	{
+		// successful loaded and linked shader program, added to map and return the result
+		ShaderMap[key] = prog;
+		return prog;
 	}
 
 	// ERROR
+	delete prog;
 	return NULL;
 }
 
+GLSLProgram* ShaderManager::GetShader(const B3D::EmbeddedShader &vert, const B3D::EmbeddedShader &frag)
+{
+	return GetShader(vert.name, frag.name, vert.source, frag.source);
+}
+
 GLSLProgram* ShaderManager::UseShader(const char* vertName, const char* fragName)
 {
 	GLSLProgram* prog = GetShader(vertName, fragName);
 	assert(prog != NULL);
-	prog->use();
+	if(OnGLThread()) prog->use();
 	return prog;
 }
 
@@ -142,6 +196,6 @@ GLSLProgram* ShaderManager::UseShader(const char* vertName, const char* fragName
 {
 	GLSLProgram* prog = GetShader(vertName, fragName,vertString, fragString);
 	assert(prog != NULL);
-	prog->use();
+	if(OnGLThread()) prog->use();
 	return prog;
-}
\ No newline at end of file
+}
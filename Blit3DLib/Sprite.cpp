@@ -4,128 +4,102 @@ extern logger oLog;
 
 //textured Sprite class --------------------------------------------------------------
 Sprite::Sprite(GLfloat startX, GLfloat startY, GLfloat width, GLfloat height,
-	std::string TextureFileName, TextureManager *TexManager, GLSLProgram *shader)
+	std::string TextureFileName, TextureManager *TexManager, GLSLProgram *shader, GLWorkQueue *workQueue)
 {
+	vaoId = vboId = 0;
+	sampler = 0;
+	glWork = workQueue;
 	dest_x = 0.f;
 	dest_y = 0.f;
 	angle = 0.f;
 	alpha = 1.f;
 	scale_x = scale_y = 1.f;
 
-	GLfloat halfSizeX, halfSizeY;//x,y half-dimensions of the quad
-
+	//x,y half-dimensions of the quad
 	halfSizeX = width / 2.f;
 	halfSizeY = height / 2.f;
 
 	prog = shader;
 
 	GLfloat imagewidth, imageheight;
-	textureName = TextureFileName;
 	texManager = TexManager;
 
 	//load the texture via the texture manager
-	texId = texManager->LoadTexture(TextureFileName);
-	if(texId == 0)
+	texHandle = texManager->LoadTextureHandle(TextureFileName);
+	//the texture id may still be 0 if we are off the GL thread and it hasn't been uploaded yet,
+	//so we only check that the image loaded
+	if(texHandle.IsNull())
 	{
 		oLog(Level::Severe) << "Free Image loading error while loading image file: " << TextureFileName << "for Sprite";
-		assert(texId != 0);
+		assert(!texHandle.IsNull());
 	}
 
-	texManager->FetchDimensions(TextureFileName, imagewidth, imageheight);
-
-	GLfloat u1 = startX / imagewidth;
-	GLfloat u2 = (startX + width) / imagewidth;
-
-	GLfloat v1 = 1.f - (startY / imageheight);
-	GLfloat v2 = 1.f - ((startY + height) / imageheight);
-
-
-	verts = new B3D::TVertex[4]; //make an array of Textured Vertices
-
-	// generate a new VAO and get the associated ID
-	glGenVertexArrays(1, &vaoId); // Create our Vertex Array Object  
-	glBindVertexArray(vaoId); // Bind our Vertex Array Object so we can use it  
-
-	// generate a new VBO and get the associated ID
-	glGenBuffers(1, &vboId);
-
-	// bind VBO in order to use
-	glBindBuffer(GL_ARRAY_BUFFER, vboId);
-
-	//set the vertex array points...we need 4 vertices, one for each corner of our sprite, 
-
-	/*
-
-	0-------3
-	|       |
-	|       |
-	|       |
-	1-------2
-	*/
-
-	//front side, counterclockwise
-	//point 0
-	verts[0].x = -halfSizeX;				verts[0].y = halfSizeY;			verts[0].z = 0.f;
-	verts[0].u = u1;	verts[0].v = v1;
-	//point 1
-	verts[1].x = -halfSizeX;				verts[1].y = -halfSizeY;		verts[1].z = 0.f;
-	verts[1].u = u1;	verts[1].v = v2;
-	//point 2
-	verts[2].x = halfSizeX;					verts[2].y = -halfSizeY;		verts[2].z = 0.f;
-	verts[2].u = u2;	verts[2].v = v2;
-	//point 3
-	verts[3].x = halfSizeX;					verts[3].y = halfSizeY;			verts[3].z = 0.f;
-	verts[3].u = u2;	verts[3].v = v1;
-
-	// upload data to VBO
-	glBufferData(GL_ARRAY_BUFFER, sizeof(B3D::TVertex) * 4, verts, GL_STATIC_DRAW);
-
-	// Set up our vertex attributes pointers
-	///we don't really need normals for 2D, except maybe for special effects.
-	//We send them anyway, as we don't have special shaders for 2d mode (YET!)
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(B3D::TVertex), BUFFER_OFFSET(0)); //3 values (x,y,z) per point, start at 0 offset 	
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(B3D::TVertex), BUFFER_OFFSET(sizeof(GLfloat)* 3)); //Start after x,y,z data 
-
+	texManager->FetchDimensions(texHandle, imagewidth, imageheight);
 
-	// activate attribute array
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glDisableVertexAttribArray(2); //don't use channel 2
-	glDisableVertexAttribArray(3); //don't use Color channel, we are textured
+	u1 = startX / imagewidth;
+	u2 = (startX + width) / imagewidth;
 
+	v1 = 1.f - (startY / imageheight);
+	v2 = 1.f - ((startY + height) / imageheight);
 
-	glBindVertexArray(0); // Disable our Vertex Array Object? 
-	glBindBuffer(GL_ARRAY_BUFFER, 0);// Disable our Vertex Buffer Object
 
-	//free the memory once it's been uploaded
-	delete[] verts;
+	if(glWork == NULL || glWork->OnGLThread())
+	{
+		MakeQuad(halfSizeX, halfSizeY, u1, u2, v1, v2);
+	}
+	else
+	{
+		//we aren't on the GL thread, so the VBO gets made there before the next Draw()...until then Blit() draws nothing
+		glWork->Submit([=]()
+		{
+			MakeQuad(halfSizeX, halfSizeY, u1, u2, v1, v2);
+		});
+	}
 }
 
-Sprite::Sprite(RenderBuffer * rb, TextureManager *TexManager, GLSLProgram *shader)
+Sprite::Sprite(RenderBuffer * rb, TextureManager *TexManager, GLSLProgram *shader, GLWorkQueue *workQueue)
 {
+	vaoId = vboId = 0;
+	sampler = 0;
+	glWork = workQueue;
+	prog = shader;
 	dest_x = 0.f;
 	dest_y = 0.f;
 	angle = 0.f;
 	alpha = 1.f;
 	scale_x = scale_y = 1.f;
 
-	GLfloat halfSizeX, halfSizeY;//x,y half-dimensions of the quad
-
+	//x,y half-dimensions of the quad
 	halfSizeX = rb->texwidth / 2.f;
 	halfSizeY = rb->texheight / 2.f;
 
-	GLfloat u1 = 0.f;
-	GLfloat u2 = 1.f;
+	u1 = 0.f;
+	u2 = 1.f;
 
-	GLfloat v1 = 1.f;
-	GLfloat v2 = 0.f;
+	v1 = 1.f;
+	v2 = 0.f;
 
-	textureName = rb->texname;
 	texManager = TexManager;
 
-	//load the texture via the texture manager
-	texId = rb->color_tex;
+	//take our own reference to the renderbuffer's texture, so it outlives whichever of us is deleted first
+	texHandle = texManager->LoadTextureHandle(rb->texname);
+
+	if(glWork == NULL || glWork->OnGLThread())
+	{
+		MakeQuad(halfSizeX, halfSizeY, u1, u2, v1, v2);
+	}
+	else
+	{
+		//we aren't on the GL thread, so the VBO gets made there before the next Draw()...until then Blit() draws nothing
+		glWork->Submit([=]()
+		{
+			MakeQuad(halfSizeX, halfSizeY, u1, u2, v1, v2);
+		});
+	}
+}
 
+void Sprite::MakeQuad(GLfloat halfSizeX, GLfloat halfSizeY, GLfloat u1, GLfloat u2, GLfloat v1, GLfloat v2)
+{
 	verts = new B3D::TVertex[4]; //make an array of Textured Vertices
 
 	// generate a new VAO and get the associated ID
@@ -179,6 +153,7 @@ Sprite::Sprite(RenderBuffer * rb, TextureManager *TexManager, GLSLProgram *shade
 	glDisableVertexAttribArray(2); //don't use channel 2
 	glDisableVertexAttribArray(3); //don't use Color channel, we are textured
 
+
 	glBindVertexArray(0); // Disable our Vertex Array Object? 
 	glBindBuffer(GL_ARRAY_BUFFER, 0);// Disable our Vertex Buffer Object
 
@@ -189,19 +164,31 @@ Sprite::Sprite(RenderBuffer * rb, TextureManager *TexManager, GLSLProgram *shade
 Sprite::~Sprite()
 {
 	// free texture
-	texManager->FreeTexture(textureName);
+	texManager->FreeTexture(texHandle);
 
 	// delete VBO when object destroyed
-	glDeleteBuffers(1, &vboId);
-	glDeleteVertexArrays(1, &vaoId);
+	if(glWork)
+	{
+		//batched with the rest of the frame's deletes
+		glWork->DeleteBuffer(vboId);
+		glWork->DeleteVertexArray(vaoId);
+	}
+	else
+	{
+		glDeleteBuffers(1, &vboId);
+		glDeleteVertexArrays(1, &vaoId);
+	}
 }
 
 void Sprite::Blit(void)
 {
+	if(vaoId == 0) return; //made off the GL thread and not set up yet
+
 	glBindVertexArray(vaoId); // Bind our Vertex Array Object 
 
-	//bind our texture
-	texManager->BindTexture(texId);
+	//bind our texture, with the sampler it was loaded with unless we have our own
+	if(sampler != 0) texManager->BindTexture(texHandle, GL_TEXTURE0, sampler);
+	else texManager->BindTexture(texHandle);
 
 	// set the rotation/translation matrix
 	/*OpenGL has a special rule to draw fragments at the center of pixel screens,
@@ -264,4 +251,36 @@ void Sprite::Blit(float x, float y, float scale_val_x, float scale_val_y, float
 	dest_y = y;
 
 	Blit();
-}
\ No newline at end of file
+}
+
+void Sprite::BlitInterpolated(const SpriteTransform &t, float blend, float alpha_val)
+{
+	//turn through the smaller angle between the two
+	float turn = fmodf(t.angle - t.prevAngle, 2.f * (float)M_PI);
+	if(turn > (float)M_PI) turn -= 2.f * (float)M_PI;
+	else if(turn < -(float)M_PI) turn += 2.f * (float)M_PI;
+
+	dest_x = t.prevX + (t.x - t.prevX) * blend;
+	dest_y = t.prevY + (t.y - t.prevY) * blend;
+	angle = t.prevAngle + turn * blend;
+	scale_x = t.prevScaleX + (t.scaleX - t.prevScaleX) * blend;
+	scale_y = t.prevScaleY + (t.scaleY - t.prevScaleY) * blend;
+	alpha = alpha_val;
+
+	Blit();
+}
+
+void Sprite::BlitInterpolated(float blend, float alpha_val)
+{
+	BlitInterpolated(transform, blend, alpha_val);
+}
+
+void Sprite::BlitTransform(const SpriteTransform &t, float alpha_val)
+{
+	BlitInterpolated(t, (float)B3D::DrawInterpolation(t.tickTime), alpha_val);
+}
+
+void Sprite::BlitTransform(float alpha_val)
+{
+	BlitTransform(transform, alpha_val);
+}
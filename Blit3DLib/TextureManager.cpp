@@ -1,13 +1,35 @@
 #include "Blit3D/TextureManager.h"
 #include <iostream>
+#include <fstream>
+#include <chrono>
 #include "Blit3D/Logger.h"
+#include "Blit3D/DynamicTexture.h"
 
 logger tLog("TextureManager.log", false);
 
-TextureManager::TextureManager(void)
+TextureManager::TextureManager(GLWorkQueue *workQueue, JobSystem *jobSystem)
 {
-	
-	for (int i = 0; i < TEXTURE_MANAGER_MAX_TEXTURES; ++i) currentId[i] = -1;
+	glWork = workQueue;
+	jobs = jobSystem;
+
+	deduplicate = false;
+	dedupBytesSaved = 0;
+	dedupHits = 0;
+	bindingsChanged = false;
+
+	for (int i = 0; i < TEXTURE_MANAGER_MAX_TEXTURES; ++i)
+	{
+		currentId[i] = -1;
+		currentSampler[i] = -1;
+	}
+
+	//the device limit for anisotropic filtering doesn't change, so only ask once
+	maxAnisotropy = 1.f;
+	if(GLEW_EXT_texture_filter_anisotropic)
+	{
+		glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxAnisotropy);
+		tLog(Level::Info) << "Maximum anisotropy: " << maxAnisotropy;
+	}
 
 	texturePath = "";
 
@@ -24,14 +46,34 @@ TextureManager::TextureManager(void)
 
 TextureManager::~TextureManager(void)
 {
-	//free all our textures
-	for(itor = textures.begin(); itor != textures.end(); itor++)
-	{		
-		glDeleteTextures( 1, &(*itor->second).texId); //free the texture memory used by OpenGL
-		delete (itor)->second; //free the instance of a tex struct
+	//free all our textures, shared ones are freed once below
+	for(size_t i = 0; i < texArray.size(); ++i)
+	{
+		if(texArray[i].texId != 0 && texArray[i].contentKey == 0) glDeleteTextures( 1, &texArray[i].texId); //free the texture memory used by OpenGL
 	}
 
+	for(std::unordered_map<uint64_t, sharedTex>::iterator itor = contents.begin(); itor != contents.end(); ++itor)
+	{
+		if(itor->second.texId != 0) glDeleteTextures(1, &itor->second.texId);
+	}
+	contents.clear();
+
+	if(dedupHits > 0)
+	{
+		tLog(Level::Info) << "Deduplication: " << dedupHits << " loads shared an identical texture, saving "
+			<< dedupBytesSaved / (1024.0 * 1024.0) << " MB of VRAM";
+	}
+
+	//free the sampler objects
+	for(std::unordered_map<uint32_t, GLuint>::iterator itor = samplers.begin(); itor != samplers.end(); ++itor)
+	{
+		glDeleteSamplers(1, &itor->second);
+	}
+	samplers.clear();
+
 	textures.clear(); //free the map
+	texArray.clear(); //free the texture records
+	freeSlots.clear();
 
 	// call this ONLY when linking with FreeImage as a static library
 #ifdef FREEIMAGE_LIB
@@ -43,42 +85,249 @@ TextureManager::~TextureManager(void)
 
 void TextureManager::SetTexturePath(std::string path)
 {
+	std::lock_guard<std::mutex> lock(texMutex);
 	texturePath = path;
 	tLog(Level::Info) << "Texture Path set to: " << path;
 }
 
-GLuint TextureManager::LoadTexture(std::string filename, bool useMipMaps, GLuint texture_unit, GLuint wrapflag, bool pixelate)
+bool TextureManager::OnGLThread(void)
+{
+	return glWork == NULL || glWork->OnGLThread();
+}
+
+tex *TextureManager::Lookup(TextureHandle handle)
+{
+	if(handle.index >= texArray.size()) return NULL;
+
+	tex *t = &texArray[handle.index];
+	if(t->generation != handle.generation) return NULL;
+
+	return t;
+}
+
+TextureHandle TextureManager::AllocateSlot(const std::string &name)
 {
-	itor = textures.find(filename); //lookup this texture in our std::map
+	uint32_t index;
 
-	if(itor == textures.end())
+	if(!freeSlots.empty())
+	{
+		//reuse a freed record, it keeps the generation it was bumped to when freed
+		index = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else
 	{
-		//we didn't find that texture name, so it is a new texture
-		tex *newtex = new tex;
+		index = (uint32_t)texArray.size();
+		texArray.push_back(tex());
+		texArray[index].generation = 0;
+	}
 
-		newtex->refcount = 1;
-		newtex->unload = true; //currently setting all textures to unload when refcount = 0;
+	tex &t = texArray[index];
+	t.texId = 0;
+	t.refcount = 1;
+	t.unload = true; //currently setting all textures to unload when refcount = 0;
+	t.width = 0;
+	t.height = 0;
+	t.sampler = 0;
+	t.contentKey = 0;
+	t.name = name;
 
-		//add the path to the file
-		std::string fullpath;
-		fullpath = texturePath;
-		fullpath.append(filename);
+	textures[name] = index;
+	BindingChanged(index);
 
-		
+	return TextureHandle(index, t.generation);
+}
 
-		//image format
-		FREE_IMAGE_FORMAT fif = FIF_UNKNOWN;
-		//pointer to the image, once loaded
-		FIBITMAP *dib(0);
-		//pointer to the image data
-		BYTE* bits(0);
-		//image width and height
-		unsigned int width(0), height(0);
-		//OpenGL's image ID to map to
-		GLuint gl_texID;
+void TextureManager::ReleaseSlot(uint32_t index)
+{
+	tex &t = texArray[index];
+
+	//only unmap the name if it still refers to this record
+	std::unordered_map<std::string, uint32_t>::iterator itor = textures.find(t.name);
+	if(itor != textures.end() && itor->second == index) textures.erase(itor);
+
+	t.refcount = 0;
+	t.texId = 0;
+	t.contentKey = 0;
+	t.name.clear();
+	t.generation++; //any handles still pointing here are now stale
+	freeSlots.push_back(index);
+	BindingChanged(index);
+}
+
+void TextureManager::BindingChanged(uint32_t index)
+{
+	changedBindings.push_back(index);
+	bindingsChanged.store(true, std::memory_order_release);
+}
+
+const texBinding *TextureManager::LookupBinding(TextureHandle handle)
+{
+	//catch up with records changed since the last bind; a change made after this check is as if it came after the bind
+	if(bindingsChanged.load(std::memory_order_acquire))
+	{
+		std::lock_guard<std::mutex> lock(texMutex);
+		bindingsChanged.store(false, std::memory_order_relaxed);
+		if(glBindings.size() < texArray.size()) glBindings.resize(texArray.size());
+		for(size_t i = 0; i < changedBindings.size(); ++i)
+		{
+			const tex &t = texArray[changedBindings[i]];
+			texBinding &b = glBindings[changedBindings[i]];
+			b.generation = t.generation;
+			b.texId = t.texId;
+			b.sampler = t.sampler;
+		}
+		changedBindings.clear();
+	}
+
+	if(handle.index >= glBindings.size()) return NULL;
+
+	const texBinding *b = &glBindings[handle.index];
+	if(b->generation != handle.generation) return NULL;
+
+	return b;
+}
+
+GLuint TextureManager::ReleaseContent(uint64_t contentKey)
+{
+	std::unordered_map<uint64_t, sharedTex>::iterator itor = contents.find(contentKey);
+	if(itor == contents.end()) return 0;
+
+	itor->second.users--;
+	if(itor->second.users > 0) return 0;
+
+	//that was the last user, the texture can go (it is 0 if the upload hasn't run yet)
+	GLuint texId = itor->second.texId;
+	contents.erase(itor);
+	return texId;
+}
+
+uint64_t TextureManager::ContentKey(const DecodedImage &image, bool useMipMaps)
+{
+	uint64_t key = B3D::HashPixels(image.pixels, (size_t)image.width * image.height * 4);
+
+	//the same pixels only make the same GL texture with the same size, channel order and mipmaps
+	key ^= (((uint64_t)image.width << 32) | (uint32_t)image.height) * 0x9E3779B97F4A7C15ULL;
+	key ^= (image.bgra ? 1 : 0) | (useMipMaps ? 2 : 0);
+
+	return key != 0 ? key : 1; //0 means not deduplicated
+}
+
+bool TextureManager::IsValid(TextureHandle handle)
+{
+	std::lock_guard<std::mutex> lock(texMutex);
+	return Lookup(handle) != NULL;
+}
+
+GLuint TextureManager::GetTextureId(TextureHandle handle)
+{
+	std::lock_guard<std::mutex> lock(texMutex);
+	tex *t = Lookup(handle);
+	if(t) return t->texId;
+	return 0;
+}
+
+TextureHandle TextureManager::FindTexture(const std::string &name)
+{
+	std::lock_guard<std::mutex> lock(texMutex);
+	std::unordered_map<std::string, uint32_t>::iterator itor = textures.find(name);
+	if(itor == textures.end()) return TextureHandle();
+
+	return TextureHandle(itor->second, texArray[itor->second].generation);
+}
+
+GLuint TextureManager::LoadTexture(const std::string &filename, bool useMipMaps, GLuint texture_unit, GLuint wrapflag, bool pixelate)
+{
+	return GetTextureId(LoadTextureHandle(filename, useMipMaps, texture_unit, wrapflag, pixelate));
+}
+
+void TextureManager::AddEmbeddedImage(const B3D::EmbeddedImage &image)
+{
+	std::lock_guard<std::mutex> lock(texMutex);
+	embeddedImages[image.name] = &image;
+}
+
+const B3D::EmbeddedImage *TextureManager::FindEmbeddedImage(const std::string &filename)
+{
+	std::lock_guard<std::mutex> lock(texMutex);
+	if(embeddedImages.empty()) return NULL;
+
+	std::unordered_map<std::string, const B3D::EmbeddedImage *>::iterator itor = embeddedImages.find(filename);
+	if(itor != embeddedImages.end()) return itor->second;
+
+	//loads pass us the name with texturePath in front
+	if(!texturePath.empty() && filename.compare(0, texturePath.size(), texturePath) == 0)
+	{
+		itor = embeddedImages.find(filename.substr(texturePath.size()));
+		if(itor != embeddedImages.end()) return itor->second;
+	}
+
+	return NULL;
+}
+
+bool TextureManager::DecodeImage(const std::string &filename, DecodedImage &image)
+{
+	//embedded images are decoded already
+	const B3D::EmbeddedImage *embedded = FindEmbeddedImage(filename);
+	if(embedded != NULL)
+	{
+		image.pixels = (uint8_t *)embedded->pixels;
+		image.width = (int)embedded->width;
+		image.height = (int)embedded->height;
+		image.bgra = false;
+		image.embedded = true;
+		return true;
+	}
+
+	std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+
+	//read the whole file once, both our own decoders and FreeImage work from memory
+	std::ifstream file(filename.c_str(), std::ios::binary | std::ios::ate);
+	if(!file.is_open())
+	{
+		tLog(Level::Severe) << "Can't open file: " << filename;
+		return false;
+	}
+	std::streamsize fileSize = file.tellg();
+	if(fileSize <= 0)
+	{
+		tLog(Level::Severe) << "File is empty: " << filename;
+		return false;
+	}
+	std::vector<uint8_t> fileData((size_t)fileSize);
+	file.seekg(0, std::ios::beg);
+	file.read((char *)&fileData[0], fileSize);
+	file.close();
+
+	const char *decoder = "FreeImage";
+
+	//fast path: QOI and 8-bit RGBA PNG decode straight into our own buffer
+	B3D::ImageInfo info;
+	if(B3D::ProbeImage(&fileData[0], fileData.size(), info))
+	{
+		image.pixels = new uint8_t[(size_t)info.width * info.height * 4];
+		if(B3D::DecodeImage(&fileData[0], fileData.size(), info, image.pixels))
+		{
+			image.width = info.width;
+			image.height = info.height;
+			image.bgra = false;
+			decoder = info.format == B3D::ImageFormat::QOI ? "QOI" : "PNG";
+		}
+		else
+		{
+			//let FreeImage have a go, it may cope with it or at least tell us what is wrong
+			tLog(Level::Warning) << "Fast path decode failed, falling back on FreeImage: " << filename;
+			delete[] image.pixels;
+			image.pixels = NULL;
+		}
+	}
+
+	if(image.pixels == NULL)
+	{
+		FIMEMORY *stream = FreeImage_OpenMemory((BYTE *)&fileData[0], (DWORD)fileData.size());
 
 		//check the file signature and deduce its format
-		fif = FreeImage_GetFileType(filename.c_str(), 0);
+		FREE_IMAGE_FORMAT fif = FreeImage_GetFileTypeFromMemory(stream, 0);
 		//if still unknown, try to guess the file format from the file extension
 		if (fif == FIF_UNKNOWN)
 			fif = FreeImage_GetFIFFromFilename(filename.c_str());
@@ -86,175 +335,543 @@ GLuint TextureManager::LoadTexture(std::string filename, bool useMipMaps, GLuint
 		if(fif == FIF_UNKNOWN)
 		{
 			tLog(Level::Severe) << "File type unknown";
-			goto ERROR_HANDLER;
+			FreeImage_CloseMemory(stream);
+			return false;
 		}
 
 		//check that the plugin has reading capabilities and load the file
+		FIBITMAP *dib = NULL;
 		if (FreeImage_FIFSupportsReading(fif))
-			dib = FreeImage_Load(fif, filename.c_str());
+			dib = FreeImage_LoadFromMemory(fif, stream);
+		FreeImage_CloseMemory(stream);
+
 		//if the image failed to load, return failure
 		if(!dib)
 		{
 			tLog(Level::Severe) << "Image failed to load dib";
-			goto ERROR_HANDLER;
+			return false;
 		}
 
-		//maybe???
-		if (FreeImage_GetBPP(dib) != 32)  dib = FreeImage_ConvertTo32Bits(dib);
+		if (FreeImage_GetBPP(dib) != 32)
+		{
+			//the conversion makes a new image, free the original
+			FIBITMAP *converted = FreeImage_ConvertTo32Bits(dib);
+			FreeImage_Unload(dib);
+			dib = converted;
+			if(!dib)
+			{
+				tLog(Level::Severe) << "Image failed to convert to 32 bits";
+				return false;
+			}
+		}
 
-		//retrieve the image data
-		bits = FreeImage_GetBits(dib);
-		//get the image width and height
-		width = FreeImage_GetWidth(dib);
-		height = FreeImage_GetHeight(dib);
 		//if this somehow one of these failed (they shouldn't), return failure
-		if((bits == 0) || (width == 0) || (height == 0))
+		if((FreeImage_GetBits(dib) == 0) || (FreeImage_GetWidth(dib) == 0) || (FreeImage_GetHeight(dib) == 0))
+		{
+			if(FreeImage_GetBits(dib) == 0) tLog(Level::Severe) << "bits = 0";
+			if(FreeImage_GetWidth(dib) == 0) tLog(Level::Severe) << "width = 0";
+			if(FreeImage_GetHeight(dib) == 0) tLog(Level::Severe) << "height = 0";
+			FreeImage_Unload(dib);
+			return false;
+		}
+
+		image.dib = dib;
+		image.pixels = FreeImage_GetBits(dib);
+		image.width = FreeImage_GetWidth(dib);
+		image.height = FreeImage_GetHeight(dib);
+		image.bgra = true;
+	}
+
+	//decode throughput, so the fast path can be compared against FreeImage on real assets
+	double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+	double megabytes = (double)image.width * image.height * 4 / (1024.0 * 1024.0);
+	tLog(Level::Info) << "Decoded " << filename << " (" << image.width << "x" << image.height << ") with " << decoder
+		<< " in " << seconds * 1000.0 << " ms, " << (seconds > 0 ? megabytes / seconds : 0) << " MB/s";
+
+	return true;
+}
+
+void TextureManager::ReleaseImage(DecodedImage &image)
+{
+	if(image.dib != NULL) FreeImage_Unload(image.dib);
+	else if(!image.embedded) delete[] image.pixels;
+
+	image.dib = NULL;
+	image.pixels = NULL;
+}
+
+void TextureManager::UploadTexture(TextureHandle handle, DecodedImage image, bool useMipMaps, GLuint texture_unit, GLuint wrapflag, bool pixelate, uint64_t contentKey)
+{
+	{
+		//the texture may have been freed before the GL thread got to it...shared content is still
+		//needed as long as anything that matched it is loaded
+		std::lock_guard<std::mutex> lock(texMutex);
+		bool needed = contentKey != 0 ? contents.count(contentKey) != 0 : Lookup(handle) != NULL;
+		if(!needed)
 		{
-			if(bits == 0) tLog(Level::Severe) << "bits = 0";
-			if(width == 0) tLog(Level::Severe) << "width = 0";
-			if(height == 0) tLog(Level::Severe) << "height = 0";
-			goto ERROR_HANDLER;
+			ReleaseImage(image);
+			return;
 		}
+	}
 
-		
-		//generate an OpenGL texture ID for this texture
-		glGenTextures(1, &gl_texID);
-		//store the texture ID mapping
-		newtex->texId = gl_texID;
-		
-		glActiveTexture(texture_unit); //needed for programmable shaders?
-		//bind to the new texture ID
-		glBindTexture(GL_TEXTURE_2D, gl_texID);
-
-		//set up some vars for OpenGL texturizing
-		GLenum image_format = GL_RGBA;
-		GLint internal_format = GL_RGBA;
-		GLint level = 0;
-		//store the texture data for OpenGL use
-		glTexImage2D(GL_TEXTURE_2D, level, internal_format, width, height,
-			0, image_format, GL_UNSIGNED_BYTE, bits);
-
-		//swizzle colors
+	//OpenGL's image ID to map to
+	GLuint gl_texID;
+
+	//generate an OpenGL texture ID for this texture
+	glGenTextures(1, &gl_texID);
+
+	glActiveTexture(texture_unit); //needed for programmable shaders?
+	//bind to the new texture ID
+	glBindTexture(GL_TEXTURE_2D, gl_texID);
+
+	//set up some vars for OpenGL texturizing
+	GLenum image_format = GL_RGBA;
+	GLint internal_format = GL_RGBA;
+	GLint level = 0;
+	//store the texture data for OpenGL use
+	glTexImage2D(GL_TEXTURE_2D, level, internal_format, image.width, image.height,
+		0, image_format, GL_UNSIGNED_BYTE, image.pixels);
+
+	//swizzle colors, FreeImage hands us BGRA
+	if(image.bgra)
+	{
 		GLint swizzleMask[] = { GL_BLUE, GL_GREEN, GL_RED, GL_ALPHA };
 		glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzleMask);
+	}
+
+	if (useMipMaps)
+	{
+		glGenerateMipmap(GL_TEXTURE_2D);
+	}
+	else
+	{
+		//only level 0 exists, so the texture is complete whatever sampler it is drawn with
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	}
+
+	//Free the decoded copy of the data
+	ReleaseImage(image);
+
+	currentId[texture_unit - GL_TEXTURE0] = gl_texID;
+
+	//filtering, anisotropy and wrapping come from a shared sampler object, rather than being set on each texture
+	GLuint sampler = GetSampler(useMipMaps, pixelate, wrapflag);
+	glBindSampler(texture_unit - GL_TEXTURE0, sampler);
+	currentSampler[texture_unit - GL_TEXTURE0] = sampler;
+
+	//publish the texture object, from here on binding the handle binds the texture
+	std::lock_guard<std::mutex> lock(texMutex);
+	if(contentKey != 0)
+	{
+		std::unordered_map<uint64_t, sharedTex>::iterator itor = contents.find(contentKey);
+		if(itor == contents.end())
+		{
+			glDeleteTextures(1, &gl_texID); //everything using it was freed while we were uploading
+			return;
+		}
+		itor->second.texId = gl_texID;
+
+		//this load, and any identical loads that came in while it was waiting to be uploaded
+		for(size_t i = 0; i < texArray.size(); ++i)
+		{
+			if(texArray[i].contentKey == contentKey)
+			{
+				texArray[i].texId = gl_texID;
+				BindingChanged((uint32_t)i);
+			}
+		}
+
+		tex *t = Lookup(handle);
+		if(t != NULL)
+		{
+			t->sampler = sampler;
+			BindingChanged(handle.index);
+		}
+		return;
+	}
+
+	tex *t = Lookup(handle);
+	if(t != NULL)
+	{
+		t->texId = gl_texID;
+		t->sampler = sampler;
+		BindingChanged(handle.index);
+	}
+	else glDeleteTextures(1, &gl_texID); //freed while we were uploading
+}
+
+TextureHandle TextureManager::LoadTextureHandle(const std::string &filename, bool useMipMaps, GLuint texture_unit, GLuint wrapflag, bool pixelate)
+{
+	std::string fullpath;
 
-		if (useMipMaps)
+	{
+		std::lock_guard<std::mutex> lock(texMutex);
+		TextureHandle found = AddReference(filename);
+		if(!found.IsNull())
 		{
-			glGenerateMipmap(GL_TEXTURE_2D);
+			//we already had that texture loaded by some other object, so bind it to the texture unit
+			if(OnGLThread()) BindTextureAndSampler(texArray[found.index].texId, texArray[found.index].sampler, texture_unit);
+			return found;
 		}
 
-		//Free FreeImage's copy of the data
-		FreeImage_Unload(dib);
+		//add the path to the file
+		fullpath = texturePath;
+		fullpath.append(filename);
+	}
 
-		newtex->width = width;
-		newtex->height = height;
-		
-		//add the new texture to the map
-		textures[filename] = newtex;		
+	//we didn't find that texture name, so it is a new texture.
+	//Decode it on this thread without holding the lock, decoding is the slow part.
+	DecodedImage image;
+	if(!DecodeImage(fullpath, image))
+	{
+		tLog(Level::Severe) << "ERROR loading file: " << filename;
+		assert(false && "ERROR loading file");
+		return TextureHandle();
+	}
+
+	//hash the pixels here too, before taking the lock
+	uint64_t contentKey = deduplicate ? ContentKey(image, useMipMaps) : 0;
+
+	return FinishLoad(filename, image, contentKey, useMipMaps, texture_unit, wrapflag, pixelate);
+}
+
+void TextureManager::LoadTextureHandles(const std::vector<std::string> &filenames, std::vector<TextureHandle> &handles,
+	bool useMipMaps, GLuint texture_unit, GLuint wrapflag, bool pixelate)
+{
+	handles.assign(filenames.size(), TextureHandle());
+
+	//the ones we don't have yet
+	std::vector<size_t> toLoad;
+	std::vector<std::string> fullpaths;
+	{
+		std::lock_guard<std::mutex> lock(texMutex);
+		for(size_t i = 0; i < filenames.size(); ++i)
+		{
+			handles[i] = AddReference(filenames[i]);
+			if(!handles[i].IsNull()) continue;
 
-		currentId[texture_unit - GL_TEXTURE0] = newtex->texId;
+			toLoad.push_back(i);
+			fullpaths.push_back(texturePath + filenames[i]);
+		}
+	}
 
-		//setup texture filtering for when we are close/far away
-		if (useMipMaps)
+	//decoding and hashing are the slow parts, and need no lock, so they are done in parallel
+	std::vector<DecodedImage> images(toLoad.size());
+	std::vector<uint64_t> contentKeys(toLoad.size(), 0);
+	std::vector<char> decoded(toLoad.size(), 0);
+	std::function<void(size_t, size_t)> decode = [&](size_t begin, size_t end)
+	{
+		for(size_t i = begin; i < end; ++i)
 		{
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR); //for when we are close
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);//when we are far away
+			decoded[i] = DecodeImage(fullpaths[i], images[i]);
+			if(decoded[i] && deduplicate) contentKeys[i] = ContentKey(images[i], useMipMaps);
 		}
-		else if(pixelate)
+	};
+	if(jobs != NULL) jobs->ParallelFor(toLoad.size(), decode, 1);
+	else decode(0, toLoad.size());
+
+	//then registered and uploaded in order, as LoadTextureHandle() would
+	for(size_t i = 0; i < toLoad.size(); ++i)
+	{
+		const std::string &filename = filenames[toLoad[i]];
+		if(!decoded[i])
 		{
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST); //for when we are close
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);//when we are far away
+			tLog(Level::Severe) << "ERROR loading file: " << filename;
+			assert(false && "ERROR loading file");
+			continue;
 		}
-		else
+
+		handles[toLoad[i]] = FinishLoad(filename, images[i], contentKeys[i], useMipMaps, texture_unit, wrapflag, pixelate);
+	}
+}
+
+TextureHandle TextureManager::FinishLoad(const std::string &filename, DecodedImage &image, uint64_t contentKey,
+	bool useMipMaps, GLuint texture_unit, GLuint wrapflag, bool pixelate)
+{
+	bool shared = false;
+
+	TextureHandle handle;
+	{
+		std::lock_guard<std::mutex> lock(texMutex);
+
+		//another thread may have loaded the same file while we were decoding
+		TextureHandle found = AddReference(filename);
+		if(!found.IsNull())
 		{
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR); //for when we are close
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);//when we are far away
+			ReleaseImage(image);
+			if(OnGLThread()) BindTextureAndSampler(texArray[found.index].texId, texArray[found.index].sampler, texture_unit);
+			return found;
 		}
 
+		//add the new texture to the array and the name map; the dimensions are known right away,
+		//the texture object shows up once the GL thread has uploaded it
+		handle = AllocateSlot(filename);
+		tex &t = texArray[handle.index];
+		t.width = image.width;
+		t.height = image.height;
 
-		//the following turns on a special, high-quality filtering mode called "ANISOTROPY"
-		if(GL_EXT_texture_filter_anisotropic)
+		if(contentKey != 0)
 		{
-			GLfloat largest_supported_anisotropy;
-			glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &largest_supported_anisotropy);
-			glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, largest_supported_anisotropy);
+			t.contentKey = contentKey;
+			uint64_t bytes = (uint64_t)image.width * image.height * 4;
+			if(useMipMaps) bytes = bytes * 4 / 3;
+
+			std::unordered_map<uint64_t, sharedTex>::iterator itor = contents.find(contentKey);
+			if(itor != contents.end())
+			{
+				//identical to a texture we already have, so share its texture object instead of uploading a copy
+				t.texId = itor->second.texId; //may still be 0, UploadTexture() fills it in
+				itor->second.users++;
+				dedupBytesSaved += itor->second.bytes;
+				dedupHits++;
+				shared = true;
+			}
+			else
+			{
+				sharedTex content;
+				content.texId = 0;
+				content.users = 1;
+				content.bytes = bytes;
+				contents[contentKey] = content;
+			}
 		}
+	}
 
-		// the texture stops at the edges with GL_CLAMP_TO_EDGE
-		//...experiment with GL_CLAMP and GL_REPEAT as well
-		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapflag );
-		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapflag );
-		
-		//return the loaded texture object
-		return newtex->texId;
-	}
-	
-	//if we get here in the code, we already had that texture loaded by some other object
-	(*itor->second).refcount++; //update the reference counter
-	//bind it to the texture unit
-	BindTexture((*itor->second).texId, texture_unit);
-	return (*itor->second).texId;//and return the OpenGL texture object ID associated with that texture
-
-ERROR_HANDLER:
-	tLog(Level::Severe) << "ERROR loading file: " << filename;
-	assert(false && "ERROR loading file");
-	return 0;
+	if(shared)
+	{
+		tLog(Level::Info) << filename << " is identical to a texture already loaded, sharing it";
+		ReleaseImage(image);
+
+		//it keeps its own sampler settings
+		if(OnGLThread())
+		{
+			GLuint sampler = GetSampler(useMipMaps, pixelate, wrapflag);
+			std::lock_guard<std::mutex> lock(texMutex);
+			tex *t = Lookup(handle);
+			if(t != NULL)
+			{
+				t->sampler = sampler;
+				BindingChanged(handle.index);
+				BindTextureAndSampler(t->texId, sampler, texture_unit);
+			}
+		}
+		else
+		{
+			glWork->Submit([=]()
+			{
+				GLuint sampler = GetSampler(useMipMaps, pixelate, wrapflag);
+				std::lock_guard<std::mutex> lock(texMutex);
+				tex *t = Lookup(handle);
+				if(t != NULL)
+				{
+					t->sampler = sampler;
+					BindingChanged(handle.index);
+				}
+			});
+		}
+
+		return handle;
+	}
+
+	if(OnGLThread())
+	{
+		UploadTexture(handle, image, useMipMaps, texture_unit, wrapflag, pixelate, contentKey);
+	}
+	else
+	{
+		glWork->Submit([=]()
+		{
+			UploadTexture(handle, image, useMipMaps, texture_unit, wrapflag, pixelate, contentKey);
+		});
+	}
+
+	//return the handle to the loaded texture
+	return handle;
 }
 
-void TextureManager::FreeTexture(std::string filename)
+TextureHandle TextureManager::AddReference(const std::string &filename)
 {
-	itor = textures.find(filename); //lookup this texture in our std::map
+	std::unordered_map<std::string, uint32_t>::iterator itor = textures.find(filename); //lookup this texture in our std::map
+	if(itor == textures.end()) return TextureHandle();
 
-	if(itor != textures.end())
+	tex &found = texArray[itor->second];
+	found.refcount++; //update the reference counter
+	return TextureHandle(itor->second, found.generation);
+}
+
+void TextureManager::FreeTexture(const std::string &filename)
+{
+	TextureHandle handle = FindTexture(filename);
+
+	if(!handle.IsNull())
 	{
-		(*itor->second).refcount--; //update the refcount
-		if((*itor->second).refcount <= 0 && (*itor->second).unload)
+		FreeTexture(handle);
+	}
+	else tLog(Level::Warning) << "Tried to free texture " << filename << " but it isn't loaded currently";
+}
+
+void TextureManager::FreeTexture(TextureHandle handle)
+{
+	GLuint deleteId = 0;
+
+	{
+		std::lock_guard<std::mutex> lock(texMutex);
+		tex *t = Lookup(handle);
+
+		if(t == NULL)
 		{
-			//we have freed the last refernce, so we can delete this texture from memory
-			glDeleteTextures(1, &(*itor->second).texId);
+			tLog(Level::Warning) << "Tried to free a texture through a stale handle (slot " << handle.index << ")";
+			return;
+		}
 
-			//if this was the currently bound texture, set currentId to a bad ID value
-			//that won't be matched by the next call to BindTexture()
-			for (int i = 0; i < TEXTURE_MANAGER_MAX_TEXTURES; ++i)
-				if (currentId[i] == (*itor->second).texId) currentId[i] = -1;
+		t->refcount--; //update the refcount
+		if(t->refcount <= 0 && t->unload)
+		{
+			//we have freed the last refernce, so we can delete this texture from memory...
+			//unless other textures share it
+			if(t->contentKey != 0) deleteId = ReleaseContent(t->contentKey);
+			else deleteId = t->texId;
 
-			delete (itor)->second; //free the instance of a tex struct
-			//clear the texture from the std::unordered_map
-			textures.erase(itor);
+			//return the record to the free list, invalidating any handles to it
+			ReleaseSlot(handle.index);
 		}
 	}
-	else tLog(Level::Warning) << "Tried to free texture " << filename << " but it isn't loaded currently";
+
+	//deleteId is 0 if the texture was still waiting to be uploaded, UploadTexture() notices that it was freed
+	if(deleteId == 0) return;
+
+	if(OnGLThread()) DeleteTextureObject(deleteId);
+	else glWork->Submit([=]() { DeleteTextureObject(deleteId); });
+}
+
+void TextureManager::DeleteTextureObject(GLuint texId)
+{
+	//batch the delete with the rest of the frame's, if we have a work queue
+	if(glWork) glWork->DeleteTexture(texId);
+	else glDeleteTextures(1, &texId);
+
+	//if this was the currently bound texture, set currentId to a bad ID value
+	//that won't be matched by the next call to BindTexture()
+	for (int i = 0; i < TEXTURE_MANAGER_MAX_TEXTURES; ++i)
+		if (currentId[i] == texId) currentId[i] = -1;
 }
 
 void TextureManager::BindTexture(GLuint bindId, GLuint texture_unit)
 {
 	//We only call glBindTexture if the texture is NOT the last one bound.
-	//On some driver implementations, calling glBindTexture() with the 
+	//On some driver implementations, calling glBindTexture() with the
 	//currently bound texture object will be a performance hit, like
-	//ACTUALLY changing textures is a performance hit. 
+	//ACTUALLY changing textures is a performance hit.
+
+	//a texture bound by id uses its own parameters, so make sure no sampler overrides them
+	BindTextureAndSampler(bindId, 0, texture_unit);
+}
 
+void TextureManager::BindTextureAndSampler(GLuint bindId, GLuint sampler, GLuint texture_unit)
+{
 	if (currentId[texture_unit - GL_TEXTURE0] != bindId)
 	{
 		glActiveTexture(texture_unit); //needed for programmable shaders
 		glBindTexture(GL_TEXTURE_2D, bindId);
-		
+
 		currentId[texture_unit - GL_TEXTURE0] = bindId;
 	}
+
+	BindSampler(sampler, texture_unit);
+}
+
+void TextureManager::BindSampler(GLuint sampler, GLuint texture_unit)
+{
+	//same idea as for textures, only rebind when it changes
+	if (currentSampler[texture_unit - GL_TEXTURE0] != sampler)
+	{
+		glBindSampler(texture_unit - GL_TEXTURE0, sampler);
+		currentSampler[texture_unit - GL_TEXTURE0] = sampler;
+	}
+}
+
+GLuint TextureManager::GetSampler(bool useMipMaps, bool pixelate, GLuint wrapflag, bool anisotropic)
+{
+	//pack the settings into the lookup key
+	uint32_t key = (useMipMaps ? 1 : 0) | (pixelate ? 2 : 0) | (anisotropic ? 4 : 0) | ((uint32_t)(wrapflag & 0xFFFF) << 8);
+
+	std::unordered_map<uint32_t, GLuint>::iterator itor = samplers.find(key);
+	if(itor != samplers.end()) return itor->second;
+
+	GLuint sampler;
+	glGenSamplers(1, &sampler);
+
+	//setup texture filtering for when we are close/far away
+	if (useMipMaps)
+	{
+		glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR); //for when we are close
+		glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);//when we are far away
+	}
+	else if(pixelate)
+	{
+		glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, GL_NEAREST); //for when we are close
+		glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);//when we are far away
+	}
+	else
+	{
+		glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR); //for when we are close
+		glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);//when we are far away
+	}
+
+	//the following turns on a special, high-quality filtering mode called "ANISOTROPY"
+	if(anisotropic && maxAnisotropy > 1.f)
+	{
+		glSamplerParameterf(sampler, GL_TEXTURE_MAX_ANISOTROPY_EXT, maxAnisotropy);
+	}
+
+	// the texture stops at the edges with GL_CLAMP_TO_EDGE
+	//...experiment with GL_CLAMP and GL_REPEAT as well
+	glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, wrapflag);
+	glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, wrapflag);
+
+	samplers[key] = sampler;
+	return sampler;
+}
+
+void TextureManager::BindTexture(TextureHandle handle, GLuint texture_unit)
+{
+	//binding only happens on the GL thread, so this reads its own copy of the record without locking
+	const texBinding *b = LookupBinding(handle);
+	if(b == NULL)
+	{
+		tLog(Level::Warning) << "Tried to bind a texture through a stale handle (slot " << handle.index << ")";
+		return;
+	}
+
+	//texId is 0 while the texture is still waiting to be uploaded, so we draw untextured until then
+	BindTextureAndSampler(b->texId, b->sampler, texture_unit);
+}
+
+void TextureManager::BindTexture(TextureHandle handle, GLuint texture_unit, GLuint sampler)
+{
+	const texBinding *b = LookupBinding(handle);
+	if(b == NULL)
+	{
+		tLog(Level::Warning) << "Tried to bind a texture through a stale handle (slot " << handle.index << ")";
+		return;
+	}
+
+	BindTextureAndSampler(b->texId, sampler, texture_unit);
 }
 
-void TextureManager::BindTexture(std::string filename, GLuint texture_unit)
+void TextureManager::BindTexture(const std::string &filename, GLuint texture_unit)
 {
-	itor = textures.find(filename); //lookup this texture in our std::unordered_map
+	TextureHandle handle = FindTexture(filename); //lookup this texture in our std::unordered_map
 
-	if (itor != textures.end())
+	if (!handle.IsNull())
 	{
-		BindTexture((*itor->second).texId, texture_unit);
+		BindTexture(handle, texture_unit);
 		return;
 	}
 
 	//didn't find it in the list of loaded textures, so load it.
 	//LoadTexture() binds it when it loads.
-	LoadTexture(filename, true, GL_CLAMP_TO_EDGE, texture_unit);
+	LoadTexture(filename, true, texture_unit, GL_CLAMP_TO_EDGE);
 }
 
 void TextureManager::InitShaderVar(GLSLProgram *the_shader, const char *samplerName, int shaderVar)
@@ -262,32 +879,100 @@ void TextureManager::InitShaderVar(GLSLProgram *the_shader, const char *samplerN
 	the_shader->setUniform(samplerName, shaderVar);
 }
 
-void TextureManager::AddLoadedTexture(std::string name, GLuint bindId)
+TextureHandle TextureManager::AddLoadedTexture(const std::string &name, GLuint bindId, int width, int height)
 {
-	//add the new texture to the map...this is doing NO collision
-	//checking on the map entries or IDs, atm,
-	//so be careful when using it!
-	tex *newtex = new tex;
+	//add the new texture to the map, collisions are allowed but almost certainly a mistake, so warn about them
+	std::lock_guard<std::mutex> lock(texMutex);
+
+	if(textures.find(name) != textures.end())
+	{
+		tLog(Level::Warning) << "AddLoadedTexture(): a texture named " << name << " is already loaded, the name now refers to the new one";
+	}
+
+	if(bindId != 0)
+	{
+		for(size_t i = 0; i < texArray.size(); ++i)
+		{
+			if(texArray[i].texId == bindId)
+			{
+				tLog(Level::Warning) << "AddLoadedTexture(): texture object " << bindId << " (" << name << ") is already registered as " << texArray[i].name;
+				break;
+			}
+		}
+	}
+
+	TextureHandle handle = AllocateSlot(name);
+	tex &newtex = texArray[handle.index];
 
-	newtex->refcount = 1;
-	newtex->unload = true; //currently setting all textures to unload when refcount = 0;
+	newtex.texId = bindId;
+	newtex.width = width;
+	newtex.height = height;
 
-	newtex->texId = bindId;
-	textures[name] = newtex;
+	return handle;
 }
 
-bool TextureManager::FetchDimensions(std::string name, GLfloat &width, GLfloat &height)
+bool TextureManager::SetTextureId(TextureHandle handle, GLuint bindId)
 {
-	itor = textures.find(name); //lookup this texture in our std::map
+	std::lock_guard<std::mutex> lock(texMutex);
+	tex *t = Lookup(handle);
+	if(t == NULL) return false;
 
-	if(itor != textures.end())
+	t->texId = bindId;
+	BindingChanged(handle.index);
+	return true;
+}
+
+void TextureManager::AddDynamicTexture(DynamicTexture *texture)
+{
+	std::lock_guard<std::mutex> lock(texMutex);
+	dynamicTextures.push_back(texture);
+}
+
+void TextureManager::RemoveDynamicTexture(DynamicTexture *texture)
+{
+	std::lock_guard<std::mutex> lock(texMutex);
+	std::vector<DynamicTexture *>::iterator itor = std::find(dynamicTextures.begin(), dynamicTextures.end(), texture);
+	if(itor != dynamicTextures.end()) dynamicTextures.erase(itor);
+}
+
+void TextureManager::UploadDynamicTextures(void)
+{
+	//they are only destroyed on the GL thread, so they can't go away while we upload them
+	std::vector<DynamicTexture *> uploads;
 	{
-		width = static_cast<float>((*itor->second).width);
-		height = static_cast<float>((*itor->second).height);
-		return true;
+		std::lock_guard<std::mutex> lock(texMutex);
+		uploads = dynamicTextures;
+	}
+
+	for(size_t i = 0; i < uploads.size(); ++i) uploads[i]->Upload();
+}
+
+bool TextureManager::FetchDimensions(const std::string &name, GLfloat &width, GLfloat &height)
+{
+	TextureHandle handle = FindTexture(name); //lookup this texture in our std::map
+
+	if(!handle.IsNull())
+	{
+		return FetchDimensions(handle, width, height);
 	}
 
 	//didn't find it in the list of loaded textures
 	tLog(Level::Warning) << "File: " << name << "is not loaded, so cannot fetch dimensions";
 	return false;
-}
\ No newline at end of file
+}
+
+bool TextureManager::FetchDimensions(TextureHandle handle, GLfloat &width, GLfloat &height)
+{
+	std::lock_guard<std::mutex> lock(texMutex);
+	tex *t = Lookup(handle);
+
+	if(t != NULL)
+	{
+		width = static_cast<float>(t->width);
+		height = static_cast<float>(t->height);
+		return true;
+	}
+
+	tLog(Level::Warning) << "Texture handle (slot " << handle.index << ") is stale, so cannot fetch dimensions";
+	return false;
+}
@@ -0,0 +1,129 @@
+#include "Blit3D/TickScheduler.h"
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include <thread>
+#include <chrono>
+
+namespace B3D
+{
+	namespace
+	{
+		std::atomic<double> updateTickTime(0); //when the tick being run was due, written by the update thread
+		std::atomic<double> frameTime(0); //when the frame being drawn started, written by the GL thread
+		std::atomic<double> frameTickSeconds(0);
+	}
+
+	double UpdateTickTime(void)
+	{
+		return updateTickTime;
+	}
+
+	double DrawInterpolation(double tickTime)
+	{
+		double seconds = frameTickSeconds;
+		if(seconds <= 0) return 1;
+
+		double t = (frameTime - tickTime) / seconds;
+		if(t < 0) return 0;
+		if(t > 1) return 1;
+		return t;
+	}
+
+	TickScheduler::TickScheduler() : tickSeconds(0), maxCatchUp(5), nextTick(0), spinSeconds(0.002), runTick(0), lastTick(0),
+		ticks(0), overruns(0), droppedTicks(0)
+	{ }
+
+	void TickScheduler::SetRate(double hz, int maxCatchUpTicks)
+	{
+		tickSeconds = hz > 0 ? 1.0 / hz : 0;
+		maxCatchUp = maxCatchUpTicks < 1 ? 1 : maxCatchUpTicks;
+	}
+
+	void TickScheduler::Start(double now)
+	{
+		nextTick = now;
+		runTick = now;
+		lastTick = now;
+		updateTickTime = now;
+	}
+
+	int TickScheduler::DueTicks(double now)
+	{
+		int due = 0;
+		runTick = nextTick;
+		updateTickTime = runTick;
+		while(now >= nextTick && due < maxCatchUp)
+		{
+			nextTick += tickSeconds;
+			++due;
+		}
+
+		if(now >= nextTick)
+		{
+			//too far behind to catch up: skip the rest, keeping to the same beat
+			uint64_t skipped = (uint64_t)((now - nextTick) / tickSeconds) + 1;
+			nextTick += skipped * tickSeconds;
+			droppedTicks += skipped;
+			++overruns;
+		}
+
+		ticks += due;
+		return due;
+	}
+
+	void TickScheduler::TickRan(void)
+	{
+		lastTick = runTick;
+		runTick += tickSeconds;
+		updateTickTime = runTick;
+	}
+
+	void TickScheduler::BeginFrame(double now)
+	{
+		frameTime = now;
+		frameTickSeconds = tickSeconds;
+	}
+
+	double TickScheduler::Interpolation(double now) const
+	{
+		if(tickSeconds <= 0) return 1;
+
+		double t = (now - lastTick) / tickSeconds;
+		if(t < 0) return 0;
+		if(t > 1) return 1;
+		return t;
+	}
+
+	int TickScheduler::WaitForTicks(void)
+	{
+		WaitUntil(nextTick);
+		return DueTicks(glfwGetTime());
+	}
+
+	void TickScheduler::WaitUntil(double deadline)
+	{
+		for(;;)
+		{
+			double remaining = deadline - glfwGetTime();
+			if(remaining <= 0) return;
+
+			//sleeps can overshoot by a millisecond or so, so the last stretch is spun, giving the core up between checks
+			if(remaining > spinSeconds)
+				std::this_thread::sleep_for(std::chrono::microseconds((long long)((remaining - spinSeconds) * 1000000.0)));
+			else
+				std::this_thread::yield();
+		}
+	}
+
+	TickStats TickScheduler::Stats(void) const
+	{
+		TickStats stats;
+		stats.ticks = ticks;
+		stats.overruns = overruns;
+		stats.droppedTicks = droppedTicks;
+		return stats;
+	}
+}
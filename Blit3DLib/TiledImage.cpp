@@ -0,0 +1,587 @@
+#include "Blit3D/TiledImage.h"
+#include <math.h>
+
+extern logger oLog;
+
+//the overview image is shrunk by powers of 2 until it fits in this size
+#define TILEDIMAGE_OVERVIEW_SIZE 1024
+
+namespace
+{
+	//the tile cache file starts with this, then the overview pixels, then the tiles
+	struct TileCacheHeader
+	{
+		char magic[4]; //"B3DT"
+		uint32_t version;
+		uint32_t imageWidth, imageHeight;
+		uint32_t tileSize, columns, rows;
+		uint32_t overviewWidth, overviewHeight;
+		uint32_t unused;
+		uint64_t sourceSize; //size of the image file the cache was made from, so we notice when it changes
+	};
+
+	const uint32_t TILE_CACHE_VERSION = 1;
+
+	uint64_t FileSize(const std::string &filename)
+	{
+		std::ifstream file(filename.c_str(), std::ios::binary | std::ios::ate);
+		if(!file.is_open()) return 0;
+		return (uint64_t)file.tellg();
+	}
+}
+
+TiledImage::TiledImage(std::string imageFile, int size, int poolLayers, Blit3D *blit3d)
+{
+	b3d = blit3d;
+	glWork = b3d->glWork;
+	texManager = b3d->tManager;
+
+	dest_x = 0.f;
+	dest_y = 0.f;
+	alpha = 1.f;
+	scale_x = scale_y = 1.f;
+	prefetchMargin = 1;
+	uploadsPerFrame = 4;
+
+	tileSize = size;
+	interior = tileSize - 2;
+	columns = rows = 0;
+	imageWidth = imageHeight = 0;
+	overviewWidth = overviewHeight = 0;
+	tilesOffset = 0;
+
+	frame = 0;
+	arrayTexId = vboId = vaoId = 0;
+	verts = NULL;
+	maxQuads = 0;
+	overview = NULL;
+	quitStreaming = false;
+
+	assert(tileSize > 2 && "TiledImage tiles must be bigger than their border");
+
+	//the cache lives next to the image
+	std::string fullpath = texManager->texturePath;
+	fullpath.append(imageFile);
+	cacheName = fullpath + ".tiles";
+
+	//use the cache if it matches the image, otherwise (re)build it...this is slow, but only happens once
+	uint64_t sourceSize = FileSize(fullpath);
+	if(!ReadCache(sourceSize))
+	{
+		oLog(Level::Info) << "Building tile cache " << cacheName;
+		if(!BuildCache(fullpath) || !ReadCache(sourceSize))
+		{
+			oLog(Level::Severe) << "Could not make the tile cache for TiledImage: " << imageFile;
+			assert(false && "Could not make the tile cache for TiledImage");
+			return;
+		}
+	}
+
+	tileState.assign(columns * rows, TILE_NOT_RESIDENT);
+	tileLayer.assign(columns * rows, -1);
+
+	streamer = std::thread(&TiledImage::StreamTiles, this);
+
+	if(glWork->OnGLThread())
+	{
+		MakeGLObjects(poolLayers);
+	}
+	else
+	{
+		//Blit() draws nothing until the GL thread has made the pool
+		glWork->Submit([=]()
+		{
+			MakeGLObjects(poolLayers);
+		});
+	}
+}
+
+TiledImage::~TiledImage()
+{
+	if(streamer.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(streamMutex);
+			quitStreaming = true;
+		}
+		streamCondition.notify_all();
+		streamer.join();
+	}
+
+	if(overview != NULL) delete overview;
+	if(!overviewHandle.IsNull()) texManager->FreeTexture(overviewHandle);
+
+	glWork->DeleteTexture(arrayTexId);
+	glWork->DeleteBuffer(vboId);
+	glWork->DeleteVertexArray(vaoId);
+
+	if(verts != NULL) delete[] verts;
+}
+
+bool TiledImage::BuildCache(const std::string &imageFile)
+{
+	//the whole image has to be in memory once, to cut it up
+	DecodedImage image;
+	if(!texManager->DecodeImage(imageFile, image)) return false;
+
+	TileCacheHeader header;
+	memcpy(header.magic, "B3DT", 4);
+	header.version = TILE_CACHE_VERSION;
+	header.imageWidth = image.width;
+	header.imageHeight = image.height;
+	header.tileSize = tileSize;
+	header.columns = (image.width + interior - 1) / interior;
+	header.rows = (image.height + interior - 1) / interior;
+	header.unused = 0;
+	header.sourceSize = FileSize(imageFile);
+
+	//the overview is a box filtered copy, shrunk by a power of 2
+	int shrink = 1;
+	while(image.width / shrink > TILEDIMAGE_OVERVIEW_SIZE || image.height / shrink > TILEDIMAGE_OVERVIEW_SIZE) shrink *= 2;
+	header.overviewWidth = std::max(1, image.width / shrink);
+	header.overviewHeight = std::max(1, image.height / shrink);
+
+	std::ofstream file(cacheName.c_str(), std::ios::binary | std::ios::trunc);
+	if(!file.is_open())
+	{
+		oLog(Level::Severe) << "Can't write tile cache " << cacheName;
+		texManager->ReleaseImage(image);
+		return false;
+	}
+
+	file.write((const char *)&header, sizeof(header));
+
+	//our images are stored as RGBA, FreeImage's are BGRA
+	int red = image.bgra ? 2 : 0;
+	int blue = image.bgra ? 0 : 2;
+	size_t stride = (size_t)image.width * 4;
+
+	std::vector<uint8_t> row(header.overviewWidth * 4);
+	for(uint32_t oy = 0; oy < header.overviewHeight; ++oy)
+	{
+		for(uint32_t ox = 0; ox < header.overviewWidth; ++ox)
+		{
+			uint32_t sum[4] = { 0, 0, 0, 0 };
+			int count = 0;
+			for(int y = oy * shrink; y < (int)(oy + 1) * shrink && y < image.height; ++y)
+			{
+				const uint8_t *src = image.pixels + y * stride + ox * shrink * 4;
+				for(int x = ox * shrink; x < (int)(ox + 1) * shrink && x < image.width; ++x, src += 4)
+				{
+					sum[0] += src[red];
+					sum[1] += src[1];
+					sum[2] += src[blue];
+					sum[3] += src[3];
+					count++;
+				}
+			}
+
+			for(int c = 0; c < 4; ++c) row[ox * 4 + c] = (uint8_t)(sum[c] / count);
+		}
+		file.write((const char *)&row[0], row.size());
+	}
+
+	//each tile is its interior plus a 1 pixel border from its neighbours, clamped at the edges of the image
+	std::vector<uint8_t> tile((size_t)tileSize * tileSize * 4);
+	std::vector<int> sourceX(tileSize);
+	for(uint32_t r = 0; r < header.rows; ++r)
+	{
+		for(uint32_t c = 0; c < header.columns; ++c)
+		{
+			for(int x = 0; x < tileSize; ++x)
+				sourceX[x] = std::min(std::max((int)c * interior - 1 + x, 0), image.width - 1);
+
+			uint8_t *dst = &tile[0];
+			for(int y = 0; y < tileSize; ++y)
+			{
+				int sourceY = std::min(std::max((int)r * interior - 1 + y, 0), image.height - 1);
+				const uint8_t *src = image.pixels + sourceY * stride;
+				for(int x = 0; x < tileSize; ++x, dst += 4)
+				{
+					const uint8_t *p = src + sourceX[x] * 4;
+					dst[0] = p[red];
+					dst[1] = p[1];
+					dst[2] = p[blue];
+					dst[3] = p[3];
+				}
+			}
+
+			file.write((const char *)&tile[0], tile.size());
+		}
+	}
+
+	texManager->ReleaseImage(image);
+
+	if(!file.good())
+	{
+		oLog(Level::Severe) << "Error writing tile cache " << cacheName;
+		file.close();
+		remove(cacheName.c_str());
+		return false;
+	}
+
+	oLog(Level::Info) << "Tile cache " << cacheName << ": " << header.columns << "x" << header.rows << " tiles of " << tileSize << " pixels";
+	return true;
+}
+
+bool TiledImage::ReadCache(uint64_t sourceSize)
+{
+	std::ifstream file(cacheName.c_str(), std::ios::binary);
+	if(!file.is_open()) return false;
+
+	TileCacheHeader header;
+	file.read((char *)&header, sizeof(header));
+	if(!file.good() || memcmp(header.magic, "B3DT", 4) != 0 || header.version != TILE_CACHE_VERSION) return false;
+	if(header.tileSize != (uint32_t)tileSize) return false;
+	//a missing source image is fine, we may have shipped only the cache
+	if(sourceSize != 0 && header.sourceSize != sourceSize) return false;
+
+	imageWidth = header.imageWidth;
+	imageHeight = header.imageHeight;
+	columns = header.columns;
+	rows = header.rows;
+	overviewWidth = header.overviewWidth;
+	overviewHeight = header.overviewHeight;
+
+	overviewPixels.resize((size_t)overviewWidth * overviewHeight * 4);
+	file.read((char *)&overviewPixels[0], overviewPixels.size());
+	if(!file.good()) return false;
+
+	tilesOffset = sizeof(header) + overviewPixels.size();
+	return true;
+}
+
+void TiledImage::MakeGLObjects(int poolLayers)
+{
+	//enough layers to cover the screen, at any alignment, plus the prefetch margin
+	if(poolLayers <= 0)
+	{
+		int across = (int)ceilf(b3d->screenWidth / interior) + 1 + prefetchMargin * 2;
+		int down = (int)ceilf(b3d->screenHeight / interior) + 1 + prefetchMargin * 2;
+		poolLayers = across * down;
+	}
+	GLint maxLayers;
+	glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+	poolLayers = std::min(std::min(poolLayers, columns * rows), (int)maxLayers);
+
+	layerTile.assign(poolLayers, -1);
+	layerLastUsed.assign(poolLayers, 0);
+	maxQuads = poolLayers;
+	verts = new B3D::TLVertex[maxQuads * 4];
+
+	oLog(Level::Info) << "TiledImage " << cacheName << " keeps " << poolLayers << " tiles resident";
+
+	//the tile pool
+	glGenTextures(1, &arrayTexId);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, arrayTexId);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, tileSize, tileSize, poolLayers, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	//the batch of quads, refilled every Blit()
+	glGenVertexArrays(1, &vaoId);
+	glBindVertexArray(vaoId);
+	glGenBuffers(1, &vboId);
+	glBindBuffer(GL_ARRAY_BUFFER, vboId);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(B3D::TLVertex) * maxQuads * 4, NULL, GL_STREAM_DRAW);
+
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(B3D::TLVertex), BUFFER_OFFSET(0)); //x,y,z
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(B3D::TLVertex), BUFFER_OFFSET(sizeof(GLfloat) * 3)); //u,v,layer
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glDisableVertexAttribArray(2);
+	glDisableVertexAttribArray(3);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	//the overview is an ordinary texture, drawn with an ordinary sprite
+	GLuint overviewId;
+	glGenTextures(1, &overviewId);
+	texManager->BindTexture(overviewId); //through the TextureManager, so it knows what is bound
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, overviewWidth, overviewHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, &overviewPixels[0]);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	std::vector<uint8_t>().swap(overviewPixels);
+
+	std::string overviewName = cacheName + ".overview";
+	overviewHandle = texManager->AddLoadedTexture(overviewName, overviewId, overviewWidth, overviewHeight);
+	overview = new Sprite(0.f, 0.f, (GLfloat)overviewWidth, (GLfloat)overviewHeight, overviewName, texManager, b3d->shader2d, glWork);
+}
+
+void TiledImage::StreamTiles(void)
+{
+	std::ifstream file(cacheName.c_str(), std::ios::binary);
+	size_t tileBytes = (size_t)tileSize * tileSize * 4;
+
+	for(;;)
+	{
+		std::unique_lock<std::mutex> lock(streamMutex);
+		streamCondition.wait(lock, [this]() { return quitStreaming || !requests.empty(); });
+		if(quitStreaming) break;
+
+		LoadedTile loaded;
+		loaded.tile = requests.front();
+		requests.pop_front();
+		if(!spareBuffers.empty())
+		{
+			loaded.pixels.swap(spareBuffers.back());
+			spareBuffers.pop_back();
+		}
+		lock.unlock();
+
+		//read without the lock, so the GL thread never waits on the disk
+		loaded.pixels.resize(tileBytes);
+		file.seekg((std::streamoff)(tilesOffset + (uint64_t)loaded.tile * tileBytes));
+		file.read((char *)&loaded.pixels[0], tileBytes);
+		if(!file.good())
+		{
+			oLog(Level::Severe) << "Error reading tile " << loaded.tile << " from " << cacheName;
+			file.clear();
+			loaded.pixels.clear(); //tells the GL thread not to ask for it again
+		}
+
+		lock.lock();
+		ready.push_back(std::move(loaded));
+	}
+}
+
+void TiledImage::UploadReadyTiles(void)
+{
+	std::vector<LoadedTile> uploads;
+	{
+		std::lock_guard<std::mutex> lock(streamMutex);
+		int count = std::min((int)ready.size(), uploadsPerFrame);
+		for(int i = 0; i < count; ++i) uploads.push_back(std::move(ready[i]));
+		ready.erase(ready.begin(), ready.begin() + count);
+	}
+
+	if(uploads.empty()) return;
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, arrayTexId);
+
+	for(size_t i = 0; i < uploads.size(); ++i)
+	{
+		int tile = uploads[i].tile;
+		if(uploads[i].pixels.empty())
+		{
+			tileState[tile] = TILE_RESIDENT; //couldn't be read: leave the overview showing, rather than asking again
+			continue;
+		}
+
+		//a free layer, or else the least recently drawn one that isn't on screen this frame
+		int layer = -1;
+		for(int l = 0; l < (int)layerTile.size(); ++l)
+		{
+			if(layerTile[l] < 0)
+			{
+				layer = l;
+				break;
+			}
+			if(layerLastUsed[l] < frame && (layer < 0 || layerLastUsed[l] < layerLastUsed[layer])) layer = l;
+		}
+
+		if(layer < 0)
+		{
+			//the pool is smaller than what is on screen, the overview shows through
+			tileState[tile] = TILE_NOT_RESIDENT;
+			continue;
+		}
+
+		if(layerTile[layer] >= 0)
+		{
+			tileLayer[layerTile[layer]] = -1;
+			tileState[layerTile[layer]] = TILE_NOT_RESIDENT;
+		}
+
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, tileSize, tileSize, 1, GL_RGBA, GL_UNSIGNED_BYTE, &uploads[i].pixels[0]);
+
+		layerTile[layer] = tile;
+		layerLastUsed[layer] = frame;
+		tileLayer[tile] = layer;
+		tileState[tile] = TILE_RESIDENT;
+	}
+
+	//give the buffers back to the streaming thread
+	std::lock_guard<std::mutex> lock(streamMutex);
+	for(size_t i = 0; i < uploads.size(); ++i)
+		if(!uploads[i].pixels.empty()) spareBuffers.push_back(std::move(uploads[i].pixels));
+}
+
+void TiledImage::RequestTiles(int col1, int row1, int col2, int row2, std::deque<int> &wanted)
+{
+	col1 = std::max(col1, 0);
+	row1 = std::max(row1, 0);
+	col2 = std::min(col2, columns - 1);
+	row2 = std::min(row2, rows - 1);
+
+	for(int r = row1; r <= row2; ++r)
+	{
+		for(int c = col1; c <= col2; ++c)
+		{
+			int tile = r * columns + c;
+			if(tileState[tile] != TILE_NOT_RESIDENT) continue;
+			tileState[tile] = TILE_LOADING;
+			wanted.push_back(tile);
+		}
+	}
+}
+
+void TiledImage::Blit(void)
+{
+	if(vaoId == 0) return; //made off the GL thread and not set up yet
+
+	frame++;
+
+	//where the image is on screen, and which part of it the screen covers, in image pixels
+	float left = dest_x - imageWidth * scale_x / 2.f;
+	float bottom = dest_y - imageHeight * scale_y / 2.f;
+	float imageX1 = -left / scale_x;
+	float imageY1 = -bottom / scale_y;
+	float imageX2 = (b3d->screenWidth - left) / scale_x;
+	float imageY2 = (b3d->screenHeight - bottom) / scale_y;
+
+	int col1 = (int)floorf(imageX1 / interior);
+	int row1 = (int)floorf(imageY1 / interior);
+	int col2 = (int)floorf(imageX2 / interior);
+	int row2 = (int)floorf(imageY2 / interior);
+	bool onScreen = col2 >= 0 && row2 >= 0 && col1 < columns && row1 < rows;
+
+	int visibleCol1 = std::max(col1, 0);
+	int visibleRow1 = std::max(row1, 0);
+	int visibleCol2 = std::min(col2, columns - 1);
+	int visibleRow2 = std::min(row2, rows - 1);
+
+	//mark what is on screen as used first, so this frame's uploads don't evict it
+	if(onScreen)
+	{
+		for(int r = visibleRow1; r <= visibleRow2; ++r)
+			for(int c = visibleCol1; c <= visibleCol2; ++c)
+				if(tileLayer[r * columns + c] >= 0) layerLastUsed[tileLayer[r * columns + c]] = frame;
+	}
+
+	UploadReadyTiles();
+
+	//ask for what is missing, on screen first then the margin; anything asked for earlier that the
+	//streaming thread hasn't got to is dropped, so we never fall behind a moving camera
+	{
+		std::lock_guard<std::mutex> lock(streamMutex);
+		for(size_t i = 0; i < requests.size(); ++i) tileState[requests[i]] = TILE_NOT_RESIDENT;
+		requests.clear();
+
+		if(onScreen)
+		{
+			RequestTiles(col1, row1, col2, row2, requests);
+			RequestTiles(col1 - prefetchMargin, row1 - prefetchMargin, col2 + prefetchMargin, row2 + prefetchMargin, requests);
+		}
+	}
+	streamCondition.notify_one();
+
+	if(!onScreen) return;
+
+	//build the batch from the resident tiles; if any are missing, the overview goes underneath
+	int quads = 0;
+	bool missing = false;
+	float texel = 1.f / tileSize;
+	for(int r = visibleRow1; r <= visibleRow2; ++r)
+	{
+		for(int c = visibleCol1; c <= visibleCol2; ++c)
+		{
+			int layer = tileLayer[r * columns + c];
+			if(layer < 0 || quads == maxQuads)
+			{
+				missing = true;
+				continue;
+			}
+
+			//the tiles on the right and top edges may only be partly covered by the image
+			int width = std::min(interior, imageWidth - c * interior);
+			int height = std::min(interior, imageHeight - r * interior);
+
+			float x1 = left + c * interior * scale_x;
+			float y1 = bottom + r * interior * scale_y;
+			float x2 = x1 + width * scale_x;
+			float y2 = y1 + height * scale_y;
+
+			//skip the border pixels
+			float u1 = texel;
+			float v1 = texel;
+			float u2 = (1 + width) * texel;
+			float v2 = (1 + height) * texel;
+
+			/*
+			0-------3
+			|       |
+			1-------2
+			*/
+			B3D::TLVertex *v = verts + quads * 4;
+			v[0].x = x1; v[0].y = y2; v[0].z = 0.f; v[0].u = u1; v[0].v = v2; v[0].layer = (GLfloat)layer;
+			v[1].x = x1; v[1].y = y1; v[1].z = 0.f; v[1].u = u1; v[1].v = v1; v[1].layer = (GLfloat)layer;
+			v[2].x = x2; v[2].y = y1; v[2].z = 0.f; v[2].u = u2; v[2].v = v1; v[2].layer = (GLfloat)layer;
+			v[3].x = x2; v[3].y = y2; v[3].z = 0.f; v[3].u = u2; v[3].v = v2; v[3].layer = (GLfloat)layer;
+			quads++;
+		}
+	}
+
+	if(missing && overview != NULL)
+	{
+		overview->Blit(dest_x, dest_y, scale_x * imageWidth / overviewWidth, scale_y * imageHeight / overviewHeight, alpha);
+	}
+
+	if(quads > 0)
+	{
+		GLSLProgram *shader = b3d->shader2dArray;
+		shader->use();
+		shader->setUniform("projectionMatrix", b3d->projectionMatrix);
+		shader->setUniform("viewMatrix", b3d->viewMatrix);
+		shader->setUniform("modelMatrix", glm::mat4(1.f));
+		shader->setUniform("in_Alpha", alpha);
+
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, arrayTexId);
+		texManager->BindSampler(0); //the pool's own filtering, not whatever the last sprite left bound
+
+		//orphan last frame's data rather than wait for the GPU to finish with it
+		glBindVertexArray(vaoId);
+		glBindBuffer(GL_ARRAY_BUFFER, vboId);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(B3D::TLVertex) * maxQuads * 4, NULL, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(B3D::TLVertex) * quads * 4, verts);
+
+		glDrawArrays(GL_QUADS, 0, quads * 4);
+
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		//sprites expect the default 2D shader to be in use
+		b3d->shader2d->use();
+	}
+
+	//reset scaling and alpha
+	alpha = scale_x = scale_y = 1.f;
+}
+
+void TiledImage::Blit(float x, float y)
+{
+	dest_x = x;
+	dest_y = y;
+
+	Blit();
+}
+
+void TiledImage::Blit(float x, float y, float scale_val_x, float scale_val_y)
+{
+	scale_x = scale_val_x;
+	scale_y = scale_val_y;
+	dest_x = x;
+	dest_y = y;
+
+	Blit();
+}
@@ -0,0 +1,138 @@
+#include "Blit3D/UTF8.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+	#define B3D_UTF8_SSE2
+	#include <emmintrin.h>
+#endif
+
+namespace B3D
+{
+	int32_t NextUTF8(const char *&p, const char *end)
+	{
+		const unsigned char *s = (const unsigned char *)p;
+		unsigned char lead = s[0];
+
+		if(lead < 0x80)
+		{
+			p++;
+			return lead;
+		}
+
+		int length;
+		int32_t code, min;
+		if(lead >= 0xC2 && lead <= 0xDF) { length = 2; code = lead & 0x1F; min = 0x80; }
+		else if(lead >= 0xE0 && lead <= 0xEF) { length = 3; code = lead & 0x0F; min = 0x800; }
+		else if(lead >= 0xF0 && lead <= 0xF4) { length = 4; code = lead & 0x07; min = 0x10000; }
+		else
+		{
+			//continuation byte, or a lead byte that can only start an overlong or out of range sequence
+			p++;
+			return UTF8_REPLACEMENT;
+		}
+
+		if(end - p < length)
+		{
+			p++;
+			return UTF8_REPLACEMENT;
+		}
+
+		for(int i = 1; i < length; ++i)
+		{
+			if((s[i] & 0xC0) != 0x80)
+			{
+				p++;
+				return UTF8_REPLACEMENT;
+			}
+			code = (code << 6) | (s[i] & 0x3F);
+		}
+
+		if(code < min || code > 0x10FFFF || (code >= 0xD800 && code <= 0xDFFF))
+		{
+			p++;
+			return UTF8_REPLACEMENT;
+		}
+
+		p += length;
+		return code;
+	}
+
+	size_t DecodeUTF8(const char *text, size_t length, std::vector<int32_t> &codes, std::vector<uint32_t> *offsets)
+	{
+		//never more code points than bytes
+		codes.resize(length);
+		if(offsets) offsets->resize(length);
+		if(length == 0) return 0;
+
+		int32_t *out = &codes[0];
+		uint32_t *outOffsets = offsets ? &(*offsets)[0] : NULL;
+		size_t count = 0;
+		size_t i = 0;
+
+		while(i < length)
+		{
+			size_t slowUntil = 0; //decode code points one at a time until here
+#ifdef B3D_UTF8_SSE2
+			//widen whole blocks of 16 ASCII bytes straight to code points
+			const __m128i zero = _mm_setzero_si128();
+			while(i + 16 <= length)
+			{
+				__m128i block = _mm_loadu_si128((const __m128i *)(text + i));
+				int mask = _mm_movemask_epi8(block);
+				if(mask != 0)
+				{
+					//the rest of this block is decoded the slow way, rather than trying SIMD again after every code point
+					slowUntil = i + 16;
+
+					//copy the ASCII bytes in front of the first one that isn't
+					int ascii = 0;
+					while(!(mask & (1 << ascii))) ascii++;
+					for(int b = 0; b < ascii; ++b)
+					{
+						if(outOffsets) outOffsets[count] = (uint32_t)(i + b);
+						out[count++] = (unsigned char)text[i + b];
+					}
+					i += ascii;
+					break;
+				}
+
+				__m128i lo = _mm_unpacklo_epi8(block, zero);
+				__m128i hi = _mm_unpackhi_epi8(block, zero);
+				_mm_storeu_si128((__m128i *)(out + count), _mm_unpacklo_epi16(lo, zero));
+				_mm_storeu_si128((__m128i *)(out + count + 4), _mm_unpackhi_epi16(lo, zero));
+				_mm_storeu_si128((__m128i *)(out + count + 8), _mm_unpacklo_epi16(hi, zero));
+				_mm_storeu_si128((__m128i *)(out + count + 12), _mm_unpackhi_epi16(hi, zero));
+
+				if(outOffsets)
+				{
+					__m128i offset = _mm_add_epi32(_mm_set1_epi32((int)i), _mm_set_epi32(3, 2, 1, 0));
+					const __m128i four = _mm_set1_epi32(4);
+					for(int b = 0; b < 16; b += 4)
+					{
+						_mm_storeu_si128((__m128i *)(outOffsets + count + b), offset);
+						offset = _mm_add_epi32(offset, four);
+					}
+				}
+
+				count += 16;
+				i += 16;
+			}
+
+			if(i >= length) break;
+#endif
+			//the slow way, then back to looking for ASCII runs
+			if(slowUntil <= i) slowUntil = i + 1;
+			const char *p = text + i;
+			const char *end = text + length;
+			while(p < end && p < text + slowUntil)
+			{
+				if(outOffsets) outOffsets[count] = (uint32_t)(p - text);
+				out[count++] = NextUTF8(p, end);
+			}
+			i = p - text;
+		}
+
+		codes.resize(count);
+		if(offsets) offsets->resize(count);
+		return count;
+	}
+}
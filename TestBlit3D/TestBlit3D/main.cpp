@@ -11,16 +11,32 @@ Blit3D *blit3D = NULL;
 GLSLProgram *prog = NULL;
 
 glm::mat4 modelMatrix;
-std::atomic<float> angle = 0;
 
-///apha vars
-std::atomic<float> alpha = 1.f;
-std::atomic<float> alphaDir = -1.f;
+//everything Update() animates, handed to Draw() through a TripleBuffer so neither thread waits on the other
+class AnimationState
+{
+public:
+	float angle, prevAngle; //degrees, now and at the tick before, so Draw() can blend between them
+	float alpha;
+	float alphaDir;
+	SpriteTransform orbiter; //a sprite circling the middle of the screen
+	double tickTime; //when the tick that made this state was due
+
+	AnimationState() : angle(0), prevAngle(0), alpha(1.f), alphaDir(-1.f), tickTime(0)
+	{ }
+};
+
+AnimationState animation; //Update()'s own copy
+B3D::TripleBuffer<AnimationState> snapshots; //what Draw() reads
 const float alphaSpeed = 0.5f;
 
 GLuint vbo = 0;
 GLuint vao = 0;
 
+//texture handles, so Draw() doesn't look textures up by name every frame
+TextureHandle logoTexture;
+TextureHandle grassTexture;
+
 //sprite test
 Sprite *sprite = NULL;
 
@@ -47,9 +63,6 @@ float joystickTestPositionAxis4 = 0.f;
 float joystickTestPositionAxis5 = 0.f;
 bool foundJoystick = false;
 
-double elapsedTime = 0;
-float timeSlice = 1.f / 60.f;
-
 void Init()
 {
 	float halfWidth = blit3D->screenWidth * 0.5f;
@@ -96,8 +109,8 @@ void Init()
 	prog->bindAttribLocation(0, "in_Position");
 	prog->bindAttribLocation(1, "in_Texcoord");
 
-	blit3D->tManager->LoadTexture("Logo.png", false);
-	blit3D->tManager->LoadTexture("grassMid.png", true);
+	logoTexture = blit3D->tManager->LoadTextureHandle("Logo.png", false);
+	grassTexture = blit3D->tManager->LoadTextureHandle("grassMid.png", true);
 
 	prog->printActiveUniforms();
 	prog->printActiveAttribs();
@@ -112,6 +125,10 @@ void Init()
 	cx = blit3D->screenWidth / 2;
 	cy = blit3D->screenHeight / 2;
 
+	//start the orbiter in place, and give Draw() the starting state before Update() has run
+	animation.orbiter.Teleport(blit3D->screenWidth / 2 + 300.f, blit3D->screenHeight / 2);
+	snapshots.Publish(animation);
+
 
 	//NEVER call CheckJoystick()/ PollJoystick() from Update if not running Blit3DThreadModel::SINGLETHREADED, or any other thread you spawn.
 	//If you lose a joystick or just want to add another, call CheckJoystick()/ PollJoystick() from a callback
@@ -136,41 +153,60 @@ void Init()
 
 void DeInit(void)
 {
-	//free fonts
-	if(afont) delete afont;
+	//free fonts...the font is actually destroyed when blit3D flushes its deletes, on the GL thread
+	if(afont) blit3D->DeleteFont(afont);
 
 	//any sprites still allocated are freed automatcally by the Blit3D object when we destroy it
 	if(blit3D) delete blit3D;
 }
 
+//called 60 times a second (see SetUpdateRate() in main()), so seconds is always 1/60; Draw() smooths the steps over
 void Update(double seconds)
 {
-	elapsedTime += seconds;
-	if(elapsedTime >= timeSlice)
-	{
-		elapsedTime -= timeSlice;
+	float timeSlice = (float)seconds;
 
-		angle = angle + timeSlice * 60.f;
-		while(angle > 360.f) angle = angle - 360;
-		while(angle < 0.f) angle = angle + 360;
+	animation.prevAngle = animation.angle;
+	animation.orbiter.NewTick();
+	animation.tickTime = B3D::UpdateTickTime();
 
-		alpha = alpha + alphaDir * alphaSpeed * timeSlice;
-		if(alpha > 1.f)
-		{
-			alpha = 1.f;
-			alphaDir = -1;
-		}
-		else if(alpha < 0.f)
-		{
-			alpha = 0.f;
-			alphaDir = 1;
-		}
+	animation.angle += timeSlice * 60.f;
+	while(animation.angle > 360.f) animation.angle -= 360;
+	while(animation.angle < 0.f) animation.angle += 360;
+
+	animation.alpha += animation.alphaDir * alphaSpeed * timeSlice;
+	if(animation.alpha > 1.f)
+	{
+		animation.alpha = 1.f;
+		animation.alphaDir = -1;
+	}
+	else if(animation.alpha < 0.f)
+	{
+		animation.alpha = 0.f;
+		animation.alphaDir = 1;
 	}
+
+	float radians = animation.angle * (float)(M_PI / 180.f);
+	animation.orbiter.x = blit3D->screenWidth / 2 + 300.f * cosf(radians);
+	animation.orbiter.y = blit3D->screenHeight / 2 + 300.f * sinf(radians);
+	animation.orbiter.angle = -radians;
+
+	//hand Draw() a copy of the new state
+	snapshots.Publish(animation);
 }
 
 void Draw(void)
 {
-	float radians = angle * (M_PI / 180.f);
+	//the newest complete state Update() has published
+	const AnimationState &now = snapshots.Latest();
+
+	//runs from 0 to 1 between update ticks: blending from the previous tick's state to the latest by it keeps
+	//movement smooth at frame rates above the update rate. It comes from the snapshot's own tick, so a snapshot
+	//published while we draw is never blended by the tick before it.
+	double interpolation = B3D::DrawInterpolation(now.tickTime);
+
+	float turn = now.angle - now.prevAngle;
+	if(turn < -180.f) turn += 360.f; //wrapped past 360 this tick
+	float radians = (now.prevAngle + turn * (float)interpolation) * (M_PI / 180.f);
 	glClearColor(0.8f, 0.6f, 0.7f, 0.0f);	//clear colour: r,g,b,a 	
 	// wipe the drawing surface clear
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -188,7 +224,7 @@ void Draw(void)
 	glBindVertexArray(vao);
 	modelMatrix = glm::translate(glm::mat4(1.f), glm::vec3(blit3D->screenWidth * 0.5f, blit3D->screenHeight * 0.5f, 0.f));
 	prog->setUniform("modelMatrix", modelMatrix);
-	blit3D->tManager->BindTexture("Logo.png");
+	blit3D->tManager->BindTexture(logoTexture);
 
 	// draw points 0-4 from the currently bound VAO with current in-use shader
 	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
@@ -206,7 +242,7 @@ void Draw(void)
 	modelMatrix = glm::translate(glm::mat4(1.f), glm::vec3(-0.1f, 0.1f, -5000.f));
 	modelMatrix = glm::rotate(modelMatrix, radians, glm::vec3(0.f, 1.f, 0.f));
 	prog->setUniform("modelMatrix", modelMatrix);
-	blit3D->tManager->BindTexture("grassMid.png");
+	blit3D->tManager->BindTexture(grassTexture);
 
 	// draw points 0-4 from the currently bound VAO with current in-use shader
 	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
@@ -220,7 +256,7 @@ void Draw(void)
 	sprite->angle = radians;
 	sprite->Blit(cx, cy); //sprite on mouse
 	sprite->Blit(blit3D->screenWidth - 100.f, 100.f, 4.f, 4.f, 0.5f); //blit same sprite at set coords, 4 times larger and 50% alpha
-	sprite->Blit(100.f, 100.f, 4.f, 4.f, alpha); //blit same sprite at set coords, 4 times larger and varying alpha
+	sprite->Blit(100.f, 100.f, 4.f, 4.f, now.alpha); //blit same sprite at set coords, 4 times larger and varying alpha
 	sprite->Blit(100.f, blit3D->screenHeight - 100.f, spriteSize1, spriteSize2); //blit same sprite at set coords, size based on a varying scale
 	sprite->Blit(blit3D->screenWidth - 100.f, blit3D->screenHeight - 100.f, spriteSize2, spriteSize1); //blit same sprite at set coords, size based on a varying scale
 	sprite->Blit(blit3D->screenWidth / 3, blit3D->screenHeight / 2 + 20.f * spriteLocator); //blit same sprite at coords set by scrollwheel input
@@ -232,6 +268,8 @@ void Draw(void)
 		sprite->Blit(blit3D->screenWidth * 3.f / 4 + joystickTestPositionAxis5,
 			blit3D->screenHeight / 2 + joystickTestPositionAxis4); //blit same sprite at coords set by joystick input
 	joystickMutex.unlock();
+
+	sprite->BlitTransform(now.orbiter); //blit same sprite where Update() moved it, blended between ticks by its own tick; sets its angle too
 	//=================================
 
 	//while still in 2d mode, draw some text
@@ -378,6 +416,10 @@ int main(int argc, char *argv[])
 	blit3D->SetDoScrollwheel(DoScrollwheel);
 	blit3D->SetDoJoystick(DoJoystick);
 
-	//Run() blocks until the window is closed
+	//a steady 60 updates a second, rather than spinning the update thread
+	blit3D->SetUpdateRate(60);
+
+	//Run() blocks until the window is closed.
+	//Blit3DThreadModel::RENDERTHREAD would also move Draw() off the main thread, leaving it free to handle input as it arrives
 	blit3D->Run(Blit3DThreadModel::MULTITHREADED);
 }
\ No newline at end of file
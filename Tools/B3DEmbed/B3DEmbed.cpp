@@ -0,0 +1,368 @@
+/*
+	B3DEmbed: writes assets out as C++ tables for EmbeddedAssets.h, to be compiled into a game.
+
+	usage: B3DEmbed -o output.h [-n namespace, Assets by default] files...
+
+	.fnt files (binary Angelcode fonts) become EmbeddedFonts, and their page images are embedded with them.
+	.qoi and .png files (8-bit RGBA PNGs, as our tools export) become EmbeddedImages, decoded to RGBA.
+	Anything else is taken to be a shader source and becomes an EmbeddedShader.
+
+	Assets are named as they are given on the command line (font pages as the font names them), which is the
+	name the game has to load them by, so run it from the directory the game loads its files from.
+	The output is only rewritten when it changes, so it doesn't trigger rebuilds on its own.
+
+	Version 1.0
+*/
+
+#include "Blit3D/ImageDecoder.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <string>
+#include <vector>
+#include <set>
+#include <fstream>
+#include <sstream>
+#include <iterator>
+
+namespace
+{
+	bool ReadFile(const std::string &filename, std::vector<uint8_t> &data)
+	{
+		std::ifstream file(filename.c_str(), std::ios::binary | std::ios::ate);
+		if(!file.is_open())
+		{
+			fprintf(stderr, "B3DEmbed: can't open %s\n", filename.c_str());
+			return false;
+		}
+
+		std::streamsize size = file.tellg();
+		data.resize((size_t)size);
+		file.seekg(0, std::ios::beg);
+		if(size > 0) file.read((char *)&data[0], size);
+		return true;
+	}
+
+	bool EndsWith(const std::string &text, const char *ending)
+	{
+		size_t length = strlen(ending);
+		if(text.size() < length) return false;
+		for(size_t i = 0; i < length; ++i)
+			if(tolower((unsigned char)text[text.size() - length + i]) != ending[i]) return false;
+		return true;
+	}
+
+	std::string Directory(const std::string &filename)
+	{
+		size_t slash = filename.find_last_of("/\\");
+		return slash == std::string::npos ? std::string() : filename.substr(0, slash + 1);
+	}
+
+	//a C++ identifier made from a file name, unique within the output
+	std::string Identifier(const std::string &name, std::set<std::string> &used)
+	{
+		std::string id;
+		for(size_t i = 0; i < name.size(); ++i)
+		{
+			char c = name[i];
+			id += isalnum((unsigned char)c) ? c : '_';
+		}
+		if(id.empty() || isdigit((unsigned char)id[0])) id = "asset_" + id;
+
+		std::string unique = id;
+		for(int n = 2; used.count(unique); ++n)
+		{
+			std::ostringstream numbered;
+			numbered << id << "_" << n;
+			unique = numbered.str();
+		}
+		used.insert(unique);
+		return unique;
+	}
+
+	std::string Quote(const std::string &text)
+	{
+		std::string out = "\"";
+		for(size_t i = 0; i < text.size(); ++i)
+		{
+			unsigned char c = text[i];
+			if(c == '\\' || c == '"') { out += '\\'; out += c; }
+			else if(c == '\n') out += "\\n";
+			else if(c == '\t') out += "\\t";
+			else if(c == '\r') out += "\\r";
+			else if(c < 32 || c > 126)
+			{
+				//octal, which can't run on into the next character the way a hex escape can
+				out += '\\';
+				out += (char)('0' + (c >> 6));
+				out += (char)('0' + ((c >> 3) & 7));
+				out += (char)('0' + (c & 7));
+			}
+			else out += c;
+		}
+		return out + "\"";
+	}
+
+	void WriteBytes(std::ostream &out, const uint8_t *data, size_t size)
+	{
+		for(size_t i = 0; i < size; ++i)
+		{
+			if(i % 24 == 0) out << "\n\t\t";
+			out << (int)data[i] << ",";
+		}
+		out << "\n";
+	}
+
+	//Angelcode binary fonts are little-endian
+	uint16_t ReadU16(const uint8_t *p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+	uint32_t ReadU32(const uint8_t *p) { return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24); }
+
+	class Embedder
+	{
+	public:
+		std::ostringstream out;
+		std::set<std::string> identifiers;
+		std::set<std::string> embeddedNames; //so a page shared by two fonts goes in once
+		std::vector<std::string> images, shaders, fonts; //identifiers, for the bundle
+
+		bool AddImage(const std::string &filename, const std::string &name)
+		{
+			if(embeddedNames.count(name)) return true;
+
+			std::vector<uint8_t> data;
+			if(!ReadFile(filename, data)) return false;
+
+			B3D::ImageInfo info;
+			if(data.empty() || !B3D::ProbeImage(&data[0], data.size(), info))
+			{
+				fprintf(stderr, "B3DEmbed: %s isn't a QOI or 8-bit RGBA PNG file\n", filename.c_str());
+				return false;
+			}
+
+			std::vector<uint8_t> pixels((size_t)info.width * info.height * 4);
+			if(!B3D::DecodeImage(&data[0], data.size(), info, &pixels[0]))
+			{
+				fprintf(stderr, "B3DEmbed: %s is corrupt\n", filename.c_str());
+				return false;
+			}
+
+			std::string id = Identifier(name, identifiers);
+			out << "\t//" << name << ", " << info.width << "x" << info.height << " RGBA, rows bottom-up\n";
+			out << "\tstatic const uint8_t " << id << "_pixels[] =\n\t{";
+			WriteBytes(out, &pixels[0], pixels.size());
+			out << "\t};\n";
+			out << "\tstatic const B3D::EmbeddedImage " << id << " = { " << Quote(name) << ", " << info.width << ", "
+				<< info.height << ", " << id << "_pixels };\n\n";
+
+			embeddedNames.insert(name);
+			images.push_back(id);
+			return true;
+		}
+
+		bool AddShader(const std::string &filename)
+		{
+			std::vector<uint8_t> data;
+			if(!ReadFile(filename, data)) return false;
+			if(data.size() > 65535)
+			{
+				//the longest string literal the Visual C++ compiler accepts
+				fprintf(stderr, "B3DEmbed: %s is too big to embed as a string\n", filename.c_str());
+				return false;
+			}
+
+			std::string id = Identifier(filename, identifiers);
+			out << "\tstatic const char " << id << "_source[] =";
+
+			//a literal per line keeps each under the compiler's limit for one piece
+			std::string source(data.begin(), data.end());
+			size_t start = 0;
+			while(start < source.size())
+			{
+				size_t end = source.find('\n', start);
+				end = end == std::string::npos ? source.size() : end + 1;
+				out << "\n\t\t" << Quote(source.substr(start, end - start));
+				start = end;
+			}
+			if(source.empty()) out << " \"\"";
+			out << ";\n";
+			out << "\tstatic const B3D::EmbeddedShader " << id << " = { " << Quote(filename) << ", " << id << "_source };\n\n";
+
+			shaders.push_back(id);
+			return true;
+		}
+
+		bool AddFont(const std::string &filename)
+		{
+			std::vector<uint8_t> data;
+			if(!ReadFile(filename, data)) return false;
+
+			size_t size = data.size();
+			if(size < 4 || data[0] != 'B' || data[1] != 'M' || data[2] != 'F' || data[3] != 3)
+			{
+				fprintf(stderr, "B3DEmbed: %s isn't a version 3 binary Angelcode font\n", filename.c_str());
+				return false;
+			}
+
+			const uint8_t *common = NULL;
+			std::vector<std::string> pageNames;
+			std::ostringstream glyphs, kerning;
+			size_t glyphCount = 0, kerningCount = 0;
+
+			size_t offset = 4;
+			while(offset < size)
+			{
+				if(size - offset < 5 || ReadU32(&data[offset + 1]) > size - offset - 5)
+				{
+					fprintf(stderr, "B3DEmbed: %s is cut off\n", filename.c_str());
+					return false;
+				}
+
+				uint8_t type = data[offset];
+				uint32_t blockSize = ReadU32(&data[offset + 1]);
+				const uint8_t *block = &data[0] + offset + 5;
+				const uint8_t *blockEnd = block + blockSize;
+				offset += 5 + blockSize;
+
+				if((type == 2 && blockSize < 15) || (type == 4 && blockSize % 20 != 0) || (type == 5 && blockSize % 10 != 0))
+				{
+					fprintf(stderr, "B3DEmbed: %s has a block of the wrong size\n", filename.c_str());
+					return false;
+				}
+
+				if(type == 2) common = block;
+				else if(type == 3)
+				{
+					while(block < blockEnd)
+					{
+						const uint8_t *name = block;
+						while(block < blockEnd && *block != 0) block++;
+						if(block > name) pageNames.push_back(std::string((const char *)name, block - name));
+						block++;
+					}
+				}
+				else if(type == 4)
+				{
+					for(; block < blockEnd; block += 20, ++glyphCount)
+					{
+						glyphs << "\n\t\t{ " << (int32_t)ReadU32(block);
+						for(int field = 0; field < 4; ++field) glyphs << ", " << ReadU16(block + 4 + field * 2);
+						for(int field = 0; field < 3; ++field) glyphs << ", " << (int16_t)ReadU16(block + 12 + field * 2);
+						glyphs << ", " << (int)block[18] << " },";
+					}
+				}
+				else if(type == 5)
+				{
+					for(; block < blockEnd; block += 10, ++kerningCount)
+						kerning << "\n\t\t{ " << ReadU32(block) << "u, " << ReadU32(block + 4) << "u, " << (int16_t)ReadU16(block + 8) << " },";
+				}
+			}
+
+			if(common == NULL || ReadU16(common + 8) != pageNames.size())
+			{
+				fprintf(stderr, "B3DEmbed: %s is missing its common block or some page names\n", filename.c_str());
+				return false;
+			}
+
+			//the pages, named as the font names them, read from beside the font
+			for(size_t i = 0; i < pageNames.size(); ++i)
+				if(!AddImage(Directory(filename) + pageNames[i], pageNames[i])) return false;
+
+			std::string id = Identifier(filename, identifiers);
+			out << "\t//" << filename << "\n";
+			out << "\tstatic const char *const " << id << "_pages[] = {";
+			for(size_t i = 0; i < pageNames.size(); ++i) out << " " << Quote(pageNames[i]) << ",";
+			out << " };\n";
+			if(glyphCount > 0) out << "\tstatic const B3D::EmbeddedGlyph " << id << "_glyphs[] =\n\t{" << glyphs.str() << "\n\t};\n";
+			if(kerningCount > 0) out << "\tstatic const B3D::EmbeddedKerning " << id << "_kerning[] =\n\t{" << kerning.str() << "\n\t};\n";
+			out << "\tstatic const B3D::EmbeddedFont " << id << " = { " << Quote(filename) << ", "
+				<< ReadU16(common) << ", " << ReadU16(common + 2) << ", " << ReadU16(common + 4) << ", " << ReadU16(common + 6) << ", "
+				<< pageNames.size() << ", " << id << "_pages, "
+				<< (glyphCount > 0 ? id + "_glyphs" : "NULL") << ", " << glyphCount << ", "
+				<< (kerningCount > 0 ? id + "_kerning" : "NULL") << ", " << kerningCount << " };\n\n";
+
+			fonts.push_back(id);
+			return true;
+		}
+
+		void WriteList(const char *type, const char *listName, const std::vector<std::string> &ids)
+		{
+			if(ids.empty()) return;
+			out << "\tstatic const B3D::" << type << " *const " << listName << "[] =\n\t{\n";
+			for(size_t i = 0; i < ids.size(); ++i) out << "\t\t&" << ids[i] << ",\n";
+			out << "\t};\n";
+		}
+
+		void WriteBundle(void)
+		{
+			WriteList("EmbeddedImage", "images", images);
+			WriteList("EmbeddedShader", "shaders", shaders);
+			WriteList("EmbeddedFont", "fonts", fonts);
+			out << "\n\tstatic const B3D::EmbeddedAssets assets =\n\t{\n"
+				<< "\t\t" << (images.empty() ? "NULL" : "images") << ", " << images.size() << ",\n"
+				<< "\t\t" << (shaders.empty() ? "NULL" : "shaders") << ", " << shaders.size() << ",\n"
+				<< "\t\t" << (fonts.empty() ? "NULL" : "fonts") << ", " << fonts.size() << "\n"
+				<< "\t};\n";
+		}
+	};
+}
+
+int main(int argc, char *argv[])
+{
+	std::string outputName, nameSpace = "Assets";
+	std::vector<std::string> inputs;
+	for(int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if(arg == "-o" && i + 1 < argc) outputName = argv[++i];
+		else if(arg == "-n" && i + 1 < argc) nameSpace = argv[++i];
+		else inputs.push_back(arg);
+	}
+
+	if(outputName.empty() || inputs.empty())
+	{
+		fprintf(stderr, "usage: B3DEmbed -o output.h [-n namespace] files...\n");
+		return 1;
+	}
+
+	Embedder embedder;
+	for(size_t i = 0; i < inputs.size(); ++i)
+	{
+		bool added;
+		if(EndsWith(inputs[i], ".fnt")) added = embedder.AddFont(inputs[i]);
+		else if(EndsWith(inputs[i], ".png") || EndsWith(inputs[i], ".qoi")) added = embedder.AddImage(inputs[i], inputs[i]);
+		else added = embedder.AddShader(inputs[i]);
+		if(!added) return 1;
+	}
+	embedder.WriteBundle();
+
+	std::ostringstream header;
+	header << "//Generated by B3DEmbed, don't edit. Include this in one .cpp file only.\n\n"
+		<< "#pragma once\n\n"
+		<< "#include \"Blit3D/EmbeddedAssets.h\"\n\n"
+		<< "namespace " << nameSpace << "\n{\n"
+		<< embedder.out.str()
+		<< "}\n";
+
+	//leave the file alone if it wouldn't change
+	std::string text = header.str();
+	std::ifstream check(outputName.c_str(), std::ios::binary);
+	if(check.is_open())
+	{
+		std::string old((std::istreambuf_iterator<char>(check)), std::istreambuf_iterator<char>());
+		if(old == text) return 0;
+	}
+
+	std::ofstream file(outputName.c_str(), std::ios::binary);
+	file << text;
+	if(!file.good())
+	{
+		fprintf(stderr, "B3DEmbed: couldn't write %s\n", outputName.c_str());
+		return 1;
+	}
+
+	printf("B3DEmbed: wrote %s (%d images, %d shaders, %d fonts)\n", outputName.c_str(),
+		(int)embedder.images.size(), (int)embedder.shaders.size(), (int)embedder.fonts.size());
+	return 0;
+}
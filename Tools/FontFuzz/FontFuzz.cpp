@@ -0,0 +1,138 @@
+/*
+	FontFuzz: feeds bytes to the binary Angelcode font parser, AngelcodeFont::Parse() through
+	AngelcodeFont::Validate(), which checks every table the parse builds. Nothing is loaded, so no
+	window or GL context is needed.
+
+	As a libFuzzer target, with clang, linked against a Debug Blit3DLib so the table checks assert:
+
+		clang++ -g -O1 -fsanitize=fuzzer,address -DB3D_LIBFUZZER -IBlit3D/include Tools/FontFuzz/FontFuzz.cpp Blit3D.lib ...
+		FontFuzz corpus/ TestBlit3D/TestBlit3D/Computer50_bin.fnt
+
+	Built as it is in the solution, it is a plain program for machines without libFuzzer: it runs each
+	file given through the same entry point, then, with -m, that many seeded mutations of each.
+
+	usage: FontFuzz [-m mutations] [-s seed] files...
+
+	Version 1.0
+*/
+
+#include "Blit3D/Blit3D.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <random>
+
+namespace
+{
+	//parses from a buffer of exactly the input's size, so a read one byte past the end is caught by the sanitizer
+	bool ValidateExact(const uint8_t *data, size_t size)
+	{
+		uint8_t *copy = new uint8_t[size ? size : 1];
+		if(size) memcpy(copy, data, size);
+		bool parsed = AngelcodeFont::Validate(copy, size);
+		delete[] copy;
+		return parsed;
+	}
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	ValidateExact(data, size);
+	return 0;
+}
+
+#ifndef B3D_LIBFUZZER
+namespace
+{
+	bool ReadFile(const std::string &filename, std::vector<uint8_t> &data)
+	{
+		std::ifstream file(filename.c_str(), std::ios::binary | std::ios::ate);
+		if(!file.is_open())
+		{
+			fprintf(stderr, "FontFuzz: can't open %s\n", filename.c_str());
+			return false;
+		}
+
+		std::streamsize size = file.tellg();
+		data.resize((size_t)size);
+		file.seekg(0, std::ios::beg);
+		if(size > 0) file.read((char *)&data[0], size);
+		return true;
+	}
+
+	//a few of the damages a font file suffers: flipped bits, stray bytes, truncation and bad counts and sizes
+	void Mutate(std::vector<uint8_t> &data, std::mt19937 &rng)
+	{
+		int changes = 1 + rng() % 8;
+		for(int i = 0; i < changes; ++i)
+		{
+			size_t pos = data.empty() ? 0 : rng() % data.size();
+			switch(rng() % 4)
+			{
+			case 0:
+				if(!data.empty()) data[pos] ^= (uint8_t)(1 << (rng() % 8));
+				break;
+
+			case 1:
+				if(!data.empty()) data[pos] = (uint8_t)rng();
+				break;
+
+			case 2:
+				data.resize(rng() % (data.size() + 1));
+				break;
+
+			case 3: //a little-endian value, mostly small enough to look like a real count
+				if(data.size() >= 4)
+				{
+					pos = rng() % (data.size() - 3);
+					uint32_t value = rng() % 64 == 0 ? (uint32_t)rng() : rng() % 400;
+					for(int b = 0; b < 4; ++b) data[pos + b] = (uint8_t)(value >> (b * 8));
+				}
+				break;
+			}
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int mutations = 0;
+	unsigned seed = 1;
+	std::vector<std::string> inputs;
+	for(int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if(arg == "-m" && i + 1 < argc) mutations = atoi(argv[++i]);
+		else if(arg == "-s" && i + 1 < argc) seed = (unsigned)atoi(argv[++i]);
+		else inputs.push_back(arg);
+	}
+
+	if(inputs.empty())
+	{
+		fprintf(stderr, "usage: FontFuzz [-m mutations] [-s seed] files...\n");
+		return 1;
+	}
+
+	std::mt19937 rng(seed);
+	for(size_t i = 0; i < inputs.size(); ++i)
+	{
+		std::vector<uint8_t> original;
+		if(!ReadFile(inputs[i], original)) return 1;
+
+		int parsed = ValidateExact(original.empty() ? NULL : &original[0], original.size()) ? 1 : 0;
+		for(int m = 0; m < mutations; ++m)
+		{
+			std::vector<uint8_t> data = original;
+			Mutate(data, rng);
+			if(ValidateExact(data.empty() ? NULL : &data[0], data.size())) parsed++;
+		}
+		printf("%s: %d of %d inputs parsed\n", inputs[i].c_str(), parsed, mutations + 1);
+	}
+	return 0;
+}
+#endif